@@ -0,0 +1,92 @@
+// Сравнение счетчиков базы данных при одновременных изменениях из нескольких потоков.
+// Каждый поток выполняет обновления счетчиков, как при вставке одной записи в AddRecord_no_block
+// (размер базы данных, количество записей и счетчик изменений): сначала общими std::atomic,
+// как было до sharded_counter, затем счетчиками sharded_counter. Для каждого числа потоков выводятся
+// время и количество обновлений в секунду.
+// Затем в базу данных загружается файл csv (generate_file с фиксированным Seed) в 1, 2, 4 и 8 потоков.
+//
+// Запуск: counter_bench.out [количество обновлений на поток, млн] [количество записей файла, млн]
+// (из корня репозитория: используются списки имен *_male.csv и *_female.csv).
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+
+#include "../lib/timer.h"
+#include "../lib/join_threads.h"
+#include "../server/sharded_counter.h"
+#include "../server/data.h"
+#include "../server/record.h"
+
+typedef DataBase::data<std::string, DataBase::record> database;
+
+struct atomic_counters {
+	std::atomic<unsigned long long> bytes;
+	std::atomic<unsigned long> records;
+	std::atomic<unsigned long long> modifications;
+	atomic_counters() : bytes(0), records(0), modifications(0) {}
+};
+
+struct sharded_counters {
+	DataBase::sharded_counter<unsigned long long> bytes;
+	DataBase::sharded_counter<unsigned long> records;
+	DataBase::sharded_counter<unsigned long long> modifications;
+};
+
+// время count обновлений в каждом из num_threads потоков; checksum - итоговое количество записей
+template<typename Counters>
+double run(unsigned int num_threads, size_t count, unsigned long long& checksum)
+{
+	Counters counters;
+	Timer t;
+	{
+		std::vector<std::thread> threads(num_threads);
+		join_threads joiner(threads);
+		for (unsigned int i = 0; i < num_threads; ++i)
+			threads[i] = std::thread([&counters, count, i]() {
+				for (size_t j = 0; j < count; ++j) {
+					counters.bytes += 40 + (unsigned int)((j + i) & 15);
+					++counters.records;
+					++counters.modifications;
+				}
+			});
+	}
+	double time = t.elapsed();
+	checksum = counters.records.load();
+	return time;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t count = (size_t)((argc > 1) ? std::stod(argv[1]) : 10) * 1000000;
+	unsigned long long num_records = (unsigned long long)(((argc > 2) ? std::stod(argv[2]) : 2) * 1000000);
+
+	std::cout << "counters\tthreads\ttime, mc\tupdates/s\trecords" << std::endl;
+	for (unsigned int num_threads : { 1u, 2u, 4u, 8u }) {
+		unsigned long long checksum;
+		double time = run<atomic_counters>(num_threads, count, checksum);
+		std::cout << "std::atomic\t" << num_threads << "\t" << time << "\t" << num_threads * count / (time / 1000.0) << "\t" << checksum << std::endl;
+		time = run<sharded_counters>(num_threads, count, checksum);
+		std::cout << "sharded\t" << num_threads << "\t" << time << "\t" << num_threads * count / (time / 1000.0) << "\t" << checksum << std::endl;
+	}
+
+	const std::string file_name = "counter_bench.csv";
+	DataBase::name_lists names = DataBase::name_lists::load();
+	DataBase::generate_file(file_name, DataBase::generated_file_format::csv, num_records, 4, names, 1);
+
+	std::cout << std::endl << "load threads\ttime, mc\trecords/s\trecords" << std::endl;
+	for (unsigned int num_threads : { 1u, 2u, 4u, 8u }) {
+		database db(4, 6);
+		Timer t;
+		unsigned long loaded = db.Load(num_threads, file_name);
+		double time = t.elapsed();
+		std::cout << num_threads << "\t" << time << "\t" << loaded / (time / 1000.0) << "\t" << db.Get_number_of_records() << std::endl;
+	}
+
+	std::remove(file_name.c_str());
+	std::remove((file_name + ".manifest").c_str());
+	return 0;
+}
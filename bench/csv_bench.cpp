@@ -0,0 +1,91 @@
+// Сравнение скорости разбора файла базы данных в формате csv:
+// io::CSVReader<5> (lib/csv.h) и subscriber_csv_reader (server/csv_tokenizer.h) на одном и том же файле.
+// Файл заполняется строками в формате Save. Для каждого ридера выводятся время, строки/с и Мб/с;
+// ридеры только разбирают строки, записи в базу данных не добавляются.
+//
+// Запуск: csv_bench.out [размер файла, Мб] [файл]
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdio>
+
+#include "../lib/timer.h"
+#include "../lib/csv.h"
+#include "../server/csv_tokenizer.h"
+
+// запись файла размером не менее megabytes Мб; возвращает количество строк
+unsigned long make_file(const std::string& file_name, unsigned int megabytes)
+{
+	const char* last_names[]  = { "Иванов", "Смирнова", "Кузнецов", "Попова", "Васнева", "Букина" };
+	const char* first_names[] = { "Иван", "Анна", "Петр", "Жанара", "Сацита", "Михаил", "Александра" };
+	const char* patronymics[] = { "Иванович", "Петровна", "Васимовна", "Феоктистовна", "Александрович" };
+
+	std::ofstream out(file_name);
+	unsigned long long size = 0, target = (unsigned long long)megabytes << 20;
+	unsigned long lines = 0;
+	std::string line;
+	for (unsigned long i = 0; size < target; ++i) {
+		line = "8" + std::to_string(1000000000UL + i % 9000000000UL) + ", "
+			+ last_names[i % 6] + ", " + first_names[i % 7] + ", " + patronymics[i % 5] + ", " + ((i & 1) ? "1" : "0") + "\n";
+		out << line;
+		size += line.size();
+		++lines;
+	}
+	return lines;
+}
+
+void print(const std::string& reader, double time, unsigned long lines, unsigned long long bytes)
+{
+	std::cout << reader << "\t" << time << "\t" << lines / (time / 1000.0) << "\t" << bytes / 1048576.0 / (time / 1000.0) << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int megabytes = (argc > 1) ? std::stoi(argv[1]) : 1024;
+	std::string file_name = (argc > 2) ? argv[2] : "csv_bench.csv";
+
+	unsigned long lines = make_file(file_name, megabytes);
+	unsigned long long bytes;
+	{
+		std::ifstream in(file_name, std::ios::binary | std::ios::ate);
+		bytes = (unsigned long long)in.tellg();
+	}
+
+	std::cout << "reader\ttime, mc\trows/s\tMB/s" << std::endl;
+	Timer t;
+
+	// io::CSVReader: каждое поле копируется в std::string
+	{
+		t.reset();
+		io::CSVReader<5> in(file_name);
+		std::string number, last_name, first_name, patronymic;
+		int activity;
+		unsigned long rows = 0, active = 0;
+		while (in.read_row(number, last_name, first_name, patronymic, activity)) {
+			++rows;
+			active += activity;
+		}
+		print("io::CSVReader", t.elapsed(), rows, bytes);
+		if (rows != lines)
+			std::cout << "Error: " << rows << " rows instead of " << lines << std::endl;
+	}
+
+	// subscriber_csv_reader: поля - string_view на отображенный в память файл
+	{
+		t.reset();
+		DataBase::subscriber_csv_reader in(file_name);
+		DataBase::subscriber_row row;
+		unsigned long rows = 0, active = 0;
+		while (in.next(row)) {
+			++rows;
+			active += row.activity;
+		}
+		print(std::string("subscriber_csv_reader (") + DataBase::subscriber_csv_reader::implementation() + ")", t.elapsed(), rows, bytes);
+		if (rows != lines)
+			std::cout << "Error: " << rows << " rows instead of " << lines << std::endl;
+	}
+
+	std::remove(file_name.c_str());
+	return 0;
+}
@@ -0,0 +1,157 @@
+// Сравнение скорости преобразования номера телефона в индексы базы данных:
+// прежний способ (две подстроки и std::stoi), DefaultHash<std::string>::hash для std::string и string_view
+// и пакетный вариант DefaultHash::hash, а также обратного преобразования: прежний способ (std::to_string,
+// строки с нулями и конкатенация) и DefaultHash::unhash в буфер. Для каждого способа выводятся время и номеров/с.
+// Затем те же преобразования выполняются для номеров E.164 переменной длины (8-15 цифр, "+" и код страны),
+// которые распределяются по сегментам нумерационным планом, для сравнения с номерами фиксированной длины.
+//
+// Запуск: hash_bench.out [количество номеров, млн]
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+
+#include "../lib/timer.h"
+#include "../server/hash.h"
+
+// индексы номера способом, который использовался до DefaultHash::parse
+std::pair<int, int> substr_hash(const std::string& key, int first_digits, int second_digits)
+{
+	return std::make_pair(std::stoi(key.substr(1, first_digits)), std::stoi(key.substr(1 + first_digits, second_digits)));
+}
+
+// номер по индексам способом, который использовался до DefaultHash::unhash в буфер
+std::string concat_unhash(int first_number, int second_number, int first_digits, int second_digits)
+{
+	std::string first = std::to_string(first_number);
+	std::string second = std::to_string(second_number);
+	std::string add_first(first_digits - first.size(), '0');
+	std::string add_second(second_digits - second.size(), '0');
+	return "8" + add_first + first + add_second + second;
+}
+
+void print(const std::string& method, double time, size_t count, unsigned long long checksum)
+{
+	std::cout << method << "\t" << time << "\t" << count / (time / 1000.0) << "\t" << checksum << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t count = (size_t)((argc > 1) ? std::stoi(argv[1]) : 10) * 1000000;
+
+	// номера хранятся подряд в одной строке, как в отображенном в память файле
+	std::mt19937_64 generator(1);
+	std::string text;
+	std::vector<std::string> strings(count);
+	std::vector<boost::string_view> views(count);
+	text.reserve(count * 11);
+	for (size_t i = 0; i < count; ++i) {
+		strings[i] = "8" + std::to_string(1000000000ULL + generator() % 9000000000ULL);
+		text += strings[i];
+	}
+	for (size_t i = 0; i < count; ++i)
+		views[i] = boost::string_view(text.data() + i * 11, 11);
+
+	DataBase::DefaultHash<std::string> hasher(4, 6);
+	std::vector<DataBase::number_index> indices(count);
+	const size_t batch_size = 64;
+
+	std::cout << "method\ttime, mc\tnumbers/s\tchecksum" << std::endl;
+	Timer t;
+	unsigned long long checksum;
+
+	t.reset();
+	checksum = 0;
+	for (size_t i = 0; i < count; ++i) {
+		std::pair<int, int> p = substr_hash(strings[i], 4, 6);
+		checksum += p.first + p.second;
+	}
+	print("substr + stoi", t.elapsed(), count, checksum);
+
+	t.reset();
+	checksum = 0;
+	for (size_t i = 0; i < count; ++i) {
+		DataBase::number_index p = hasher.hash(strings[i]);
+		checksum += p.first + p.second;
+	}
+	print("hash(std::string)", t.elapsed(), count, checksum);
+
+	t.reset();
+	checksum = 0;
+	for (size_t i = 0; i < count; ++i) {
+		DataBase::number_index p = hasher.hash(views[i]);
+		checksum += p.first + p.second;
+	}
+	print("hash(string_view)", t.elapsed(), count, checksum);
+
+	t.reset();
+	checksum = 0;
+	for (size_t i = 0; i < count; i += batch_size) {
+		size_t n = std::min(batch_size, count - i);
+		if (hasher.hash(&views[i], n, &indices[i]) != n)
+			std::cout << "Error: invalid number in the batch " << i / batch_size << std::endl;
+		for (size_t j = i; j < i + n; ++j)
+			checksum += indices[j].first + indices[j].second;
+	}
+	print("hash(batch of 64)", t.elapsed(), count, checksum);
+
+	// обратное преобразование; номера дописываются в строку, как при выводе в файл
+	std::string output;
+	output.reserve(count * 11);
+
+	t.reset();
+	for (size_t i = 0; i < count; ++i)
+		output += concat_unhash(indices[i].first, indices[i].second, 4, 6);
+	print("to_string + concat", t.elapsed(), count, output == text);
+
+	output.clear();
+	t.reset();
+	char number[DataBase::DefaultHash<std::string>::max_number_length];
+	for (size_t i = 0; i < count; ++i)
+		output.append(number, hasher.unhash(indices[i].first, indices[i].second, number));
+	print("unhash(buffer)", t.elapsed(), count, output == text);
+
+	// номера E.164: код страны из таблицы плана по умолчанию и случайные цифры до общей длины 8-15
+	const char* country_codes[] = { "1", "7", "44", "49", "33", "86", "91", "81", "55", "234", "880", "61", "380" };
+	const size_t number_of_codes = sizeof(country_codes) / sizeof(country_codes[0]);
+	std::string international_text;
+	std::vector<size_t> offsets(count + 1, 0);
+	international_text.reserve(count * 14);
+	for (size_t i = 0; i < count; ++i) {
+		std::string code = country_codes[generator() % number_of_codes];
+		size_t length = 8 + generator() % 8;
+		std::string digits = std::to_string(generator());
+		international_text += "+" + code + digits.substr(0, length - code.size());
+		offsets[i + 1] = international_text.size();
+	}
+	for (size_t i = 0; i < count; ++i)
+		views[i] = boost::string_view(international_text.data() + offsets[i], offsets[i + 1] - offsets[i]);
+
+	t.reset();
+	checksum = 0;
+	for (size_t i = 0; i < count; ++i) {
+		DataBase::number_index p = hasher.hash(views[i]);
+		checksum += p.first + p.second;
+	}
+	print("E.164 hash(string_view)", t.elapsed(), count, checksum);
+
+	t.reset();
+	checksum = 0;
+	for (size_t i = 0; i < count; i += batch_size) {
+		size_t n = std::min(batch_size, count - i);
+		if (hasher.hash(&views[i], n, &indices[i]) != n)
+			std::cout << "Error: invalid number in the batch " << i / batch_size << std::endl;
+		for (size_t j = i; j < i + n; ++j)
+			checksum += indices[j].first + indices[j].second;
+	}
+	print("E.164 hash(batch of 64)", t.elapsed(), count, checksum);
+
+	output.clear();
+	t.reset();
+	for (size_t i = 0; i < count; ++i)
+		output.append(number, hasher.unhash(indices[i].first, indices[i].second, number));
+	print("E.164 unhash(buffer)", t.elapsed(), count, output == international_text);
+
+	return 0;
+}
@@ -0,0 +1,136 @@
+// Сравнение способов ввода-вывода файлов базы данных (--io=stream и --io=direct).
+// Файл в формате csv базы данных записывается через std::ofstream и через direct_output_buffer,
+// затем читается блоками по 1 Мб (fread и direct_byte_source) и с разбором строк через io::LineReader
+// со штатным источником (fread) и с direct_byte_source.
+// Время записи включает fsync, перед чтением страницы файла удаляются из кэша (posix_fadvise),
+// поэтому обе стороны измеряются при одинаковом (холодном) состоянии кэша.
+//
+// Запуск: io_bench.out [размер файла, Мб] [файл]
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdio>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../lib/timer.h"
+#include "../lib/csv.h"
+#include "../server/direct_io.h"
+#include "../server/file_utils.h"
+
+// удаление страниц файла из кэша операционной системы
+void drop_cache(const std::string& file_name)
+{
+	int fd = ::open(file_name.c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+	::fdatasync(fd);
+	::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	::close(fd);
+}
+
+// 1 Мб строк базы данных
+std::string make_block()
+{
+	std::string block;
+	for (unsigned long i = 0; block.size() < (1 << 20); ++i)
+		block += "8" + std::to_string(9990000000UL + i) + ",Иванов,Иван,Иванович,1\n";
+	return block;
+}
+
+void print(const std::string& operation, const std::string& backend, double time, unsigned long long bytes)
+{
+	std::cout << operation << "\t" << backend << "\t" << time << "\t" << bytes / 1048576.0 / (time / 1000.0) << std::endl;
+}
+
+unsigned long count_lines(io::LineReader& in)
+{
+	unsigned long lines = 0;
+	while (in.next_line())
+		++lines;
+	return lines;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int megabytes = (argc > 1) ? std::stoi(argv[1]) : 512;
+	std::string file_name = (argc > 2) ? argv[2] : "io_bench.csv";
+
+	std::string block = make_block();
+	unsigned long long bytes = (unsigned long long)block.size() * megabytes;
+	Timer t;
+
+	std::cout << "operation\tbackend\ttime, mc\tMB/s" << std::endl;
+
+	// запись
+	t.reset();
+	{
+		std::ofstream out(file_name);
+		for (unsigned int i = 0; i < megabytes; ++i)
+			out.write(block.data(), block.size());
+	}
+	DataBase::sync_file(file_name);
+	print("write", "stream", t.elapsed(), bytes);
+
+	t.reset();
+	bool direct;
+	{
+		DataBase::direct_output_buffer buffer(file_name);
+		direct = buffer.direct();
+		std::ostream out(&buffer);
+		for (unsigned int i = 0; i < megabytes; ++i)
+			out.write(block.data(), block.size());
+		buffer.close();
+	}
+	DataBase::sync_file(file_name);
+	print("write", direct ? "direct" : "direct (no O_DIRECT)", t.elapsed(), bytes);
+
+	// чтение блоками по 1 Мб без обработки данных
+	std::vector<char> chunk(1 << 20);
+	drop_cache(file_name);
+	t.reset();
+	{
+		FILE* in = std::fopen(file_name.c_str(), "rb");
+		while (std::fread(chunk.data(), 1, chunk.size(), in) > 0)
+			;
+		std::fclose(in);
+	}
+	print("read", "stream", t.elapsed(), bytes);
+
+	drop_cache(file_name);
+	t.reset();
+	{
+		DataBase::direct_byte_source in(file_name);
+		while (in.read(chunk.data(), (int)chunk.size()) > 0)
+			;
+	}
+	print("read", direct ? "direct" : "direct (no O_DIRECT)", t.elapsed(), bytes);
+
+	// чтение с разбором строк
+	drop_cache(file_name);
+	t.reset();
+	unsigned long lines;
+	{
+		io::LineReader in(file_name);
+		lines = count_lines(in);
+	}
+	print("parse", "stream", t.elapsed(), bytes);
+
+	drop_cache(file_name);
+	t.reset();
+	unsigned long direct_lines;
+	{
+		io::LineReader in(file_name, std::unique_ptr<io::ByteSourceBase>(new DataBase::direct_byte_source(file_name)));
+		direct_lines = count_lines(in);
+	}
+	print("parse", direct ? "direct" : "direct (no O_DIRECT)", t.elapsed(), bytes);
+
+	if (lines != direct_lines)
+		std::cout << "Error: line count mismatch " << lines << " != " << direct_lines << std::endl;
+
+	std::remove(file_name.c_str());
+	return 0;
+}
@@ -0,0 +1,70 @@
+// Сравнение форматов сохранения базы данных.
+// Генерируется база данных, затем она сохраняется, очищается и загружается в формате csv (Save/Load)
+// и в блочном формате без сжатия и со сжатием zlib (SaveSnapshot/LoadSnapshot).
+// Для каждого формата выводятся время сохранения, время загрузки и размер файлов на диске.
+//
+// Запуск из корня репозитория (нужны файлы имен *.csv):
+//   bench/snapshot_bench.out [число записей] [число потоков]
+
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <boost/filesystem.hpp>
+
+#include "../lib/timer.h"
+#include "../server/record.h"
+#include "../server/data.h"
+
+typedef DataBase::data<std::string, DataBase::record> database;
+
+unsigned long long file_size(const std::string& name)
+{
+	boost::system::error_code ec;
+	auto size = boost::filesystem::file_size(name, ec);
+	return ec ? 0 : size;
+}
+
+void print(const std::string& format, double save_time, double load_time, unsigned long count, unsigned long long size)
+{
+	std::cout << format << "\t" << save_time << "\t" << load_time << "\t" << count << "\t" << size << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	int num_records = (argc > 1) ? std::stoi(argv[1]) : 1000000;
+	unsigned int num_threads = (argc > 2) ? std::stoi(argv[2]) : 4;
+
+	database db(4, 6);
+	DataBase::name_lists names = DataBase::name_lists::load();
+	db.Generate(num_records, num_threads, names);
+
+	std::cout << "format\tsave, mc\tload, mc\trecords\tbytes" << std::endl;
+	Timer t;
+
+	// csv: num_threads файлов bench_data0.csv ... bench_data{n-1}.csv
+	t.reset();
+	db.Save(num_threads, "bench_data.csv");
+	double save_time = t.elapsed();
+	unsigned long long size = 0;
+	for (unsigned int i = 0; i < num_threads; ++i)
+		size += file_size("bench_data" + std::to_string(i) + ".csv");
+	db.Clear(num_threads);
+	t.reset();
+	unsigned long count = db.Load(num_threads, "bench_data.csv");
+	print("csv", save_time, t.elapsed(), count, size);
+	for (unsigned int i = 0; i < num_threads; ++i)
+		std::remove(("bench_data" + std::to_string(i) + ".csv").c_str());
+
+	for (auto compression : { DataBase::block_compression::none, DataBase::block_compression::zlib }) {
+		t.reset();
+		db.SaveSnapshot(num_threads, "bench_data.snap", compression);
+		save_time = t.elapsed();
+		size = file_size("bench_data.snap");
+		db.Clear(num_threads);
+		t.reset();
+		count = db.LoadSnapshot(num_threads, "bench_data.snap");
+		print(compression == DataBase::block_compression::zlib ? "zlib" : "none", save_time, t.elapsed(), count, size);
+		std::remove("bench_data.snap");
+	}
+	return 0;
+}
@@ -0,0 +1,78 @@
+// Нагрузочный тест журнала упреждающей записи.
+// Несколько потоков одновременно добавляют записи в журнал и ожидают их долговечности,
+// как это делают запросы /add. Для каждого режима журнала выводятся пропускная способность,
+// средняя и 99-процентильная задержка, добавляемая к запросу, и средний размер группы fsync.
+//
+// Запуск: wal_bench.out [число записей на поток] [файл журнала]
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <cstdio>
+
+#include "../lib/timer.h"
+#include "../lib/join_threads.h"
+#include "../server/wal.h"
+
+void run(DataBase::durability_mode mode, const std::string& mode_name, unsigned int num_threads,
+	unsigned int count, const std::string& file_name)
+{
+	std::remove(file_name.c_str());
+	DataBase::write_ahead_log wal(file_name, mode);
+
+	std::vector<std::vector<double> > latencies(num_threads);
+	Timer total;
+	{
+		std::vector<std::thread> threads(num_threads);
+		join_threads joiner(threads);
+		for (unsigned int i = 0; i < num_threads; ++i) {
+			threads[i] = std::thread([&, i] {
+				latencies[i].reserve(count);
+				Timer t;
+				for (unsigned int j = 0; j < count; ++j) {
+					std::string number = "8" + std::to_string(1000000000ULL + i * 10000000ULL + j);
+					t.reset();
+					unsigned long long lsn = wal.append_add(number, true, "Иванов", "Иван", "Иванович");
+					wal.wait(lsn);
+					latencies[i].push_back(t.elapsed());
+				}
+			});
+		}
+	}
+	double elapsed = total.elapsed();
+
+	std::vector<double> all;
+	for (auto& v : latencies)
+		all.insert(all.end(), v.begin(), v.end());
+	std::sort(all.begin(), all.end());
+	double sum = 0;
+	for (double l : all)
+		sum += l;
+
+	unsigned long long syncs = wal.Get_number_of_syncs();
+	std::cout << mode_name << "\t" << num_threads << "\t"
+		<< all.size() / (elapsed / 1000.0) << "\t"
+		<< sum / all.size() << "\t"
+		<< all[all.size() * 99 / 100] << "\t"
+		<< syncs << "\t"
+		<< (syncs ? double(all.size()) / syncs : 0.0) << std::endl;
+
+	std::remove(file_name.c_str());
+	std::remove((file_name + ".checkpoint").c_str());
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int count = (argc > 1) ? std::stoi(argv[1]) : 2000;
+	std::string file_name = (argc > 2) ? argv[2] : "wal_bench.log";
+
+	std::cout << "mode\tthreads\tops/s\tmean, mc\tp99, mc\tfsyncs\trecords/fsync" << std::endl;
+	for (unsigned int num_threads : { 1, 4, 16 }) {
+		run(DataBase::durability_mode::none,  "none",  num_threads, count, file_name);
+		run(DataBase::durability_mode::async, "async", num_threads, count, file_name);
+		run(DataBase::durability_mode::sync,  "sync",  num_threads, count, file_name);
+	}
+	return 0;
+}
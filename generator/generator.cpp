@@ -0,0 +1,75 @@
+// Генерация исходных данных (часть 1 задачи) непосредственно в файл без запуска сервера.
+// Записи не размещаются в памяти, поэтому размер файла может превышать объем оперативной памяти.
+//
+// Запуск: generator.out [--records=<N>] [--threads=<N>] [--file=<имя>] [--format=csv|snapshot] [--compression=zlib|none] [--seed=<N>]
+//                       [--active-ratio=<доля>] [--name-zipf=<s>] [--prefix-zipf=<s>] [--prefix-density=<файл>]
+//   --records     - количество записей (по умолчанию 18000000, около 1 Гб в формате csv);
+//   --threads     - количество потоков генерации (по умолчанию - количество ядер);
+//   --file        - имя файла (по умолчанию data.csv для csv и data.snap для snapshot);
+//   --format      - csv (как у /save, загружается /load) или snapshot (блочный снимок, /load с Mode=snapshot);
+//   --compression - сжатие блоков снимка (по умолчанию zlib);
+//   --seed        - начальное значение генерации (по умолчанию случайное); при одинаковом значении файл
+//                   совпадает побайтно при любом числе потоков;
+//   --active-ratio   - доля активных абонентов (по умолчанию 0.5);
+//   --name-zipf      - показатель закона Ципфа частот фамилий, имен и отчеств (по умолчанию 0 - равновероятно);
+//   --prefix-zipf    - показатель закона Ципфа заполненности сегментов (по умолчанию 0 - равномерно);
+//   --prefix-density - файл относительных плотностей префиксов номеров: строки "<префикс>,<плотность>".
+// Списки фамилий, имен и отчеств читаются из файлов *_male.csv и *_female.csv текущего каталога.
+
+#include <iostream>
+#include <string>
+#include <map>
+#include <thread>
+#include <stdexcept>
+#include <algorithm>
+
+#include "../lib/timer.h"
+#include "../server/generator.h"
+
+int main(int argc, char* argv[])
+{
+	std::map<std::string, std::string> options;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		std::string::size_type pos = arg.find('=');
+		if (arg.compare(0, 2, "--") != 0 || pos == std::string::npos) {
+			std::cout << "Unknown argument '" << arg << "'." << std::endl;
+			return 1;
+		}
+		options[arg.substr(2, pos - 2)] = arg.substr(pos + 1);
+	}
+	auto option = [&](const std::string& name, const std::string& default_value) {
+		auto it = options.find(name);
+		return (it == options.end()) ? default_value : it->second;
+	};
+
+	try {
+		DataBase::generated_file_format format = DataBase::parse_generated_file_format(option("format", "csv"));
+		std::string file_name = option("file", (format == DataBase::generated_file_format::csv) ? "data.csv" : "data.snap");
+		unsigned long long records = std::stoull(option("records", "18000000"));
+		unsigned int threads = std::stoul(option("threads", std::to_string(std::max(1u, std::thread::hardware_concurrency()))));
+		DataBase::block_compression compression = DataBase::parse_block_compression(option("compression", "zlib"));
+		uint64_t seed = options.count("seed") ? std::stoull(options["seed"]) : DataBase::random_seed();
+
+		DataBase::generation_profile profile;
+		profile.active_ratio = std::stod(option("active-ratio", "0.5"));
+		profile.name_zipf = std::stod(option("name-zipf", "0"));
+		profile.prefix_zipf = std::stod(option("prefix-zipf", "0"));
+		if (options.count("prefix-density"))
+			profile.prefix_densities = DataBase::generation_profile::load_prefix_densities(options["prefix-density"]);
+
+		Timer t;
+		DataBase::name_lists names = DataBase::name_lists::load();
+		DataBase::generated_file_stats stats = DataBase::generate_file(file_name, format, records, threads, names, seed, profile, compression);
+
+		double time = t.elapsed();
+		std::cout << "File " << file_name << " generated successfully. Count of records: " << stats.records
+			<< ". Count of bytes: " << stats.bytes << ". Seed: " << seed << ". Duration: " << time << " mc. Rate: "
+			<< (unsigned long long)(stats.bytes / (time / 1000.0) / (1 << 20)) << " MB/s." << std::endl;
+	}
+	catch (std::exception& e) {
+		std::cout << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,276 @@
+#include <stdexcept>
+#include <algorithm>
+#include <fstream>
+#include <set>
+
+#include <boost/filesystem.hpp>
+
+#include "checkpoint.h"
+#include "file_utils.h"
+#include "error.h"
+
+namespace DataBase {
+
+	namespace {
+		const char* const manifest_name = "MANIFEST";
+
+		std::string manifest_file_name(const std::string& dir_name)
+		{
+			return (boost::filesystem::path(dir_name) / manifest_name).string();
+		}
+	}
+
+	bool read_incremental_manifest(const std::string& dir_name, incremental_manifest& manifest)
+	{
+		std::string file_name = manifest_file_name(dir_name);
+		std::ifstream in(file_name);
+		if (!in)
+			return false;
+
+		manifest = incremental_manifest();
+		try {
+			std::string line;
+			while (std::getline(in, line)) {
+				if (line.empty())
+					continue;
+				std::string::size_type first = line.find(',');
+				if (first == std::string::npos)
+					throw FileReadError(file_name);
+
+				std::string key = line.substr(0, first);
+				if (key == "version")
+					manifest.version = std::stoul(line.substr(first + 1));
+				else if (key == "buckets")
+					manifest.number_of_buckets = std::stoul(line.substr(first + 1));
+				else {
+					std::string::size_type second = line.find(',', first + 1);
+					if (second == std::string::npos)
+						throw FileReadError(file_name);
+					incremental_manifest::bucket_entry entry;
+					entry.version = std::stoul(line.substr(first + 1, second - first - 1));
+					entry.records = std::stoul(line.substr(second + 1));
+					manifest.buckets[std::stoul(key)] = entry;
+				}
+			}
+		}
+		catch (std::logic_error&) { // ошибки преобразования std::stoul
+			throw FileReadError(file_name);
+		}
+		return true;
+	}
+
+	void write_incremental_manifest(const std::string& dir_name, const incremental_manifest& manifest)
+	{
+		std::string content = "version," + std::to_string(manifest.version) + "\n"
+			+ "buckets," + std::to_string(manifest.number_of_buckets) + "\n";
+		for (auto& bucket : manifest.buckets)
+			content += std::to_string(bucket.first) + "," + std::to_string(bucket.second.version) + ","
+				+ std::to_string(bucket.second.records) + "\n";
+
+		replace_file(manifest_file_name(dir_name), content);
+	}
+
+	std::string bucket_file_name(const std::string& dir_name, unsigned int bucket, unsigned long version)
+	{
+		return (boost::filesystem::path(dir_name) /
+			("bucket" + std::to_string(bucket) + "_v" + std::to_string(version) + ".csv")).string();
+	}
+
+	void remove_obsolete_bucket_files(const std::string& dir_name, const incremental_manifest& manifest)
+	{
+		std::set<std::string> actual;
+		for (auto& bucket : manifest.buckets)
+			actual.insert(boost::filesystem::path(bucket_file_name(dir_name, bucket.first, bucket.second.version)).filename().string());
+
+		boost::system::error_code ec;
+		for (boost::filesystem::directory_iterator it(dir_name, ec), end; !ec && it != end; it.increment(ec)) {
+			std::string name = it->path().filename().string();
+			if (name.compare(0, 6, "bucket") == 0 && actual.find(name) == actual.end())
+				boost::filesystem::remove(it->path(), ec);
+		}
+	}
+
+	std::string save_manifest_name(const std::string& file_name)
+	{
+		return file_name + ".manifest";
+	}
+
+	namespace {
+		// чтение файла манифеста name; возвращает false при отсутствии файла
+		bool read_save_manifest_file(const std::string& name, save_manifest& manifest)
+		{
+			std::ifstream in(name);
+			if (!in)
+				return false;
+
+			manifest = save_manifest();
+			try {
+				std::string line;
+				while (std::getline(in, line)) {
+					if (line.empty())
+						continue;
+					if (line.compare(0, 8, "buckets,") == 0) {
+						manifest.number_of_buckets = std::stoul(line.substr(8));
+						continue;
+					}
+
+					// числовые поля разбираются с конца строки, поэтому имя файла может содержать запятые
+					std::string::size_type pos[4];
+					std::string::size_type end = line.size();
+					for (int i = 3; i >= 0; --i) {
+						pos[i] = line.rfind(',', end - 1);
+						if (pos[i] == std::string::npos || pos[i] == 0)
+							throw FileReadError(name);
+						end = pos[i];
+					}
+					save_manifest::piece piece;
+					piece.file         = line.substr(0, pos[0]);
+					piece.bytes        = std::stoull(line.substr(pos[0] + 1, pos[1] - pos[0] - 1));
+					piece.records      = std::stoul(line.substr(pos[1] + 1, pos[2] - pos[1] - 1));
+					piece.first_bucket = std::stoul(line.substr(pos[2] + 1, pos[3] - pos[2] - 1));
+					piece.end_bucket   = std::stoul(line.substr(pos[3] + 1));
+					manifest.pieces.push_back(piece);
+				}
+			}
+			catch (std::logic_error&) { // ошибки преобразования std::stoul
+				throw FileReadError(name);
+			}
+			if (manifest.pieces.empty())
+				throw FileReadError(name);
+			return true;
+		}
+
+		// суффикс имен файлов поколения generation (0 - текущий снимок)
+		std::string generation_suffix(unsigned int generation)
+		{
+			return generation ? "." + std::to_string(generation) : std::string();
+		}
+
+		// файлы поколения generation снимка file_name: файлы частей, последним - манифест;
+		// пустой список, если манифеста поколения нет
+		std::vector<std::string> generation_files(const std::string& file_name, unsigned int generation)
+		{
+			std::string suffix = generation_suffix(generation);
+			std::string manifest_name = save_manifest_name(file_name) + suffix;
+			std::vector<std::string> files;
+			save_manifest manifest;
+			try {
+				if (!read_save_manifest_file(manifest_name, manifest))
+					return files;
+				boost::filesystem::path dir = boost::filesystem::path(file_name).parent_path();
+				for (auto& piece : manifest.pieces)
+					files.push_back((dir / piece.file).string() + suffix);
+			}
+			catch (FileReadError&) {
+				// поврежденный манифест: известен только он сам
+			}
+			files.push_back(manifest_name);
+			return files;
+		}
+
+		// сдвиг поколений прежних снимков и сохранение текущего снимка как поколения 1
+		void rotate_save_snapshots(const std::string& file_name, unsigned int retention)
+		{
+			boost::system::error_code ec;
+			for (auto& file : generation_files(file_name, retention))
+				boost::filesystem::remove(file, ec);
+
+			for (unsigned int generation = retention - 1; generation >= 1; --generation) {
+				std::string suffix = generation_suffix(generation);
+				for (auto& file : generation_files(file_name, generation)) {
+					std::string base = file.substr(0, file.size() - suffix.size());
+					boost::filesystem::rename(file, base + generation_suffix(generation + 1), ec);
+				}
+			}
+
+			// текущий снимок остается на месте до замены его файлов новыми, поэтому вместо копирования
+			// создаются жесткие ссылки; при их отсутствии в файловой системе файлы копируются.
+			// Файлы, удаленные после сохранения снимка, в поколение не попадают.
+			for (auto& file : generation_files(file_name, 0)) {
+				std::string link = file + generation_suffix(1);
+				boost::filesystem::remove(link, ec);
+				if (!boost::filesystem::exists(file, ec))
+					continue;
+				boost::filesystem::create_hard_link(file, link, ec);
+				if (ec) {
+					boost::filesystem::copy_file(file, link, ec);
+					if (ec)
+						throw FileWriteError(link);
+				}
+			}
+		}
+	}
+
+	bool read_save_manifest(const std::string& file_name, save_manifest& manifest, unsigned int generation)
+	{
+		return read_save_manifest_file(save_generation_name(save_manifest_name(file_name), generation), manifest);
+	}
+
+	std::string save_generation_name(const std::string& file, unsigned int generation)
+	{
+		return file + generation_suffix(generation);
+	}
+
+	void write_save_manifest(const std::string& file_name, const save_manifest& manifest)
+	{
+		std::string content = "buckets," + std::to_string(manifest.number_of_buckets) + "\n";
+		for (auto& piece : manifest.pieces)
+			content += piece.file + "," + std::to_string(piece.bytes) + "," + std::to_string(piece.records) + ","
+				+ std::to_string(piece.first_bucket) + "," + std::to_string(piece.end_bucket) + "\n";
+
+		replace_file(save_manifest_name(file_name), content);
+	}
+
+	std::string save_temporary_name(const std::string& piece_file)
+	{
+		return piece_file + ".tmp";
+	}
+
+	void commit_save_snapshot(const std::string& file_name, const save_manifest& manifest, unsigned int retention)
+	{
+		// прежний снимок сохраняется как поколение 1 и при retention == 0: до записи нового манифеста
+		// оно остается единственным целым снимком
+		// После прерванного сохранения (манифеста нет, поколение 1 есть) последним целым снимком остается
+		// поколение 1, поэтому оно не сдвигается
+		std::vector<std::string> previous = generation_files(file_name, 0);
+		boost::system::error_code exists_ec;
+		bool interrupted = !boost::filesystem::exists(save_manifest_name(file_name), exists_ec)
+			&& boost::filesystem::exists(save_generation_name(save_manifest_name(file_name), 1), exists_ec);
+		if (!interrupted)
+			rotate_save_snapshots(file_name, std::max(retention, 1u));
+
+		// Манифест прежнего снимка удаляется до замены его файлов: снимок без манифеста при наличии поколения 1
+		// означает прерванное сохранение, и загружается поколение 1, а не смесь файлов двух снимков
+		boost::filesystem::path dir = boost::filesystem::path(file_name).parent_path();
+		boost::system::error_code remove_ec;
+		boost::filesystem::remove(save_manifest_name(file_name), remove_ec);
+		if (remove_ec)
+			throw FileWriteError(save_manifest_name(file_name));
+		sync_directory(parent_directory(file_name));
+
+		// rename заменяет прежний файл атомарно; каталог фиксируется один раз при записи манифеста
+		std::set<std::string> actual;
+		for (auto& piece : manifest.pieces) {
+			std::string piece_file = (dir / piece.file).string();
+			boost::system::error_code ec;
+			boost::filesystem::rename(save_temporary_name(piece_file), piece_file, ec);
+			if (ec)
+				throw FileWriteError(piece_file);
+			actual.insert(piece_file);
+		}
+		write_save_manifest(file_name, manifest);
+
+		boost::system::error_code ec;
+		if (retention == 0)
+			for (auto& file : generation_files(file_name, 1))
+				boost::filesystem::remove(file, ec);
+
+		// файлы прежнего снимка, не вошедшие в новый (например, при уменьшении числа потоков)
+		if (!previous.empty())
+			previous.pop_back(); // манифест заменен
+		for (auto& file : previous)
+			if (actual.find(file) == actual.end())
+				boost::filesystem::remove(file, ec);
+	}
+
+} // namespace DataBase
@@ -0,0 +1,91 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+#include <map>
+#include <vector>
+
+namespace DataBase {
+
+	// Манифест каталога инкрементальных контрольных точек.
+	// Каждый непустой сегмент базы данных (индекс внешнего вектора) хранится в отдельном файле
+	// bucket<индекс>_v<версия>.csv; манифест указывает актуальную версию файла каждого сегмента.
+	// Формат манифеста (файл MANIFEST):
+	//   version,<номер контрольной точки>
+	//   buckets,<число сегментов базы данных>
+	//   <индекс сегмента>,<версия файла сегмента>,<количество записей>
+	// Манифест заменяется атомарно, поэтому каталог всегда соответствует одной завершенной контрольной точке.
+	struct incremental_manifest {
+		struct bucket_entry {
+			unsigned long version;
+			unsigned long records;
+		};
+
+		unsigned long version;
+		unsigned int  number_of_buckets;
+		std::map<unsigned int, bucket_entry> buckets; // только непустые сегменты
+
+		incremental_manifest() : version(0), number_of_buckets(0) {}
+	};
+
+	// чтение манифеста каталога dir_name; возвращает false при отсутствии манифеста
+	bool read_incremental_manifest(const std::string& dir_name, incremental_manifest& manifest);
+
+	// атомарная запись манифеста в каталог dir_name
+	void write_incremental_manifest(const std::string& dir_name, const incremental_manifest& manifest);
+
+	// имя файла сегмента bucket версии version
+	std::string bucket_file_name(const std::string& dir_name, unsigned int bucket, unsigned long version);
+
+	// удаление файлов сегментов, на которые не ссылается манифест (остатки прежних версий и прерванных сохранений)
+	void remove_obsolete_bucket_files(const std::string& dir_name, const incremental_manifest& manifest);
+
+	// Манифест снимка операции Save: файлы <имя>0.csv, <имя>1.csv, ... и диапазоны сегментов в каждом из них.
+	// Манифест позволяет загружать снимок в любом числе потоков независимо от числа потоков сохранения.
+	// Формат манифеста (файл <имя снимка>.manifest рядом с файлами снимка):
+	//   buckets,<число сегментов базы данных>
+	//   <имя файла>,<размер в байтах>,<количество записей>,<первый сегмент>,<сегмент за последним>
+	// Имена файлов указываются относительно каталога манифеста.
+	struct save_manifest {
+		struct piece {
+			std::string file;
+			unsigned long long bytes;
+			unsigned long records;
+			unsigned int first_bucket;
+			unsigned int end_bucket;
+		};
+
+		unsigned int number_of_buckets;
+		std::vector<piece> pieces;
+
+		save_manifest() : number_of_buckets(0) {}
+	};
+
+	// имя файла манифеста снимка file_name
+	std::string save_manifest_name(const std::string& file_name);
+
+	// чтение манифеста поколения generation снимка file_name (0 - текущий снимок); возвращает false
+	// при отсутствии манифеста (снимок прежнего формата или отсутствующее поколение)
+	bool read_save_manifest(const std::string& file_name, save_manifest& manifest, unsigned int generation = 0);
+
+	// имя файла поколения generation: file для текущего снимка, <file>.<generation> для прежних
+	std::string save_generation_name(const std::string& file, unsigned int generation);
+
+	// атомарная запись манифеста снимка file_name
+	void write_save_manifest(const std::string& file_name, const save_manifest& manifest);
+
+	// временный файл, в который записывается файл снимка piece_file до фиксации снимка
+	std::string save_temporary_name(const std::string& piece_file);
+
+	// Фиксация снимка file_name, файлы которого записаны во временные файлы и сброшены на диск.
+	// Прежний снимок сохраняется как поколение 1 (жесткие ссылки <файл>.1, <имя>.manifest.1), старые поколения
+	// сдвигаются, поколения старше retention удаляются. Затем удаляется манифест текущего снимка, временные файлы
+	// атомарно переименовываются, и записывается новый манифест - точка фиксации снимка. Сбой до записи манифеста
+	// оставляет снимок без манифеста при целом поколении 1, которое загружается вместо него (data::Load);
+	// при retention == 0 поколение 1 существует только до записи манифеста. Файлы прежнего снимка, отсутствующие
+	// в новом, удаляются.
+	void commit_save_snapshot(const std::string& file_name, const save_manifest& manifest, unsigned int retention);
+
+} // namespace DataBase
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,133 @@
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "columnar.h"
+#include "error.h"
+
+namespace DataBase {
+
+	namespace {
+		const char     column_magic[4] = { 'P', 'H', 'C', 'O' };
+		const uint32_t column_version  = 1;
+		const uint64_t column_alignment = 64;
+
+		uint64_t align_up(uint64_t size)
+		{
+			return (size + column_alignment - 1) / column_alignment * column_alignment;
+		}
+	}
+
+	uint32_t dictionary_code_width(size_t dictionary_size)
+	{
+		if (dictionary_size <= 0x100)
+			return 1;
+		if (dictionary_size <= 0x10000)
+			return 2;
+		return 4;
+	}
+
+	column_writer::column_writer(const std::string& dir_name, const std::string& name, column_type type,
+		uint32_t value_width, uint64_t rows, uint64_t dictionary_size) :
+		file_name(dir_name + "/" + name + ".col"), fd(-1)
+	{
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, column_magic, sizeof(header.magic));
+		header.version = column_version;
+		std::strncpy(header.name, name.c_str(), sizeof(header.name) - 1);
+		header.type = (uint32_t)type;
+		header.value_width = value_width;
+		header.rows = rows;
+		header.data_offset = align_up(sizeof(header));
+		header.data_size = (type == column_type::bitset) ? (rows + 63) / 64 * 8 : rows * value_width;
+		header.dictionary_offset = (type == column_type::dictionary) ? align_up(header.data_offset + header.data_size) : 0;
+		header.dictionary_size = dictionary_size;
+
+		fd = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			throw FileOpenError(file_name);
+		try {
+			write_at(0, &header, sizeof(header));
+		}
+		catch (...) {
+			::close(fd);
+			throw;
+		}
+	}
+
+	column_writer::~column_writer()
+	{
+		if (fd >= 0)
+			::close(fd);
+	}
+
+	void column_writer::write_at(uint64_t offset, const void* data, size_t size)
+	{
+		const char* p = static_cast<const char*>(data);
+		size_t done = 0;
+		while (done < size) {
+			ssize_t n = ::pwrite(fd, p + done, size - done, offset + done);
+			if (n <= 0)
+				throw FileWriteError(file_name);
+			done += n;
+		}
+	}
+
+	void column_writer::write_values(uint64_t first_row, const void* values, size_t count)
+	{
+		write_at(header.data_offset + first_row * header.value_width, values, count * header.value_width);
+	}
+
+	void column_writer::write_bitset(const std::vector<uint64_t>& words)
+	{
+		write_at(header.data_offset, words.data(), std::min<uint64_t>(words.size() * 8, header.data_size));
+	}
+
+	void column_writer::close(const std::vector<std::string>& dictionary)
+	{
+		uint64_t file_size = header.data_offset + header.data_size;
+
+		if (header.type == (uint32_t)column_type::dictionary) {
+			// смещения строк относительно начала словаря, затем байты строк
+			std::vector<uint32_t> offsets;
+			offsets.reserve(dictionary.size() + 1);
+			uint32_t offset = (uint32_t)((dictionary.size() + 1) * sizeof(uint32_t));
+			std::string bytes;
+			for (auto& s : dictionary) {
+				offsets.push_back(offset);
+				offset += (uint32_t)s.size();
+				bytes += s;
+			}
+			offsets.push_back(offset);
+
+			write_at(header.dictionary_offset, offsets.data(), offsets.size() * sizeof(uint32_t));
+			write_at(header.dictionary_offset + offsets.size() * sizeof(uint32_t), bytes.data(), bytes.size());
+			file_size = header.dictionary_offset + offset;
+		}
+
+		// строки, не записанные ни одним потоком (пустая база данных), и выравнивание заполняются нулями
+		if (::ftruncate(fd, file_size) != 0)
+			throw FileWriteError(file_name);
+
+		int result = ::close(fd);
+		fd = -1;
+		if (result != 0)
+			throw FileWriteError(file_name);
+	}
+
+	column_header read_column_header(const std::string& file_name)
+	{
+		std::ifstream in(file_name, std::ios::binary);
+		if (!in)
+			throw FileOpenError(file_name);
+
+		column_header header;
+		if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+			|| std::memcmp(header.magic, column_magic, sizeof(header.magic)) != 0 || header.version != column_version)
+			throw FileReadError(file_name);
+		return header;
+	}
+
+} // namespace DataBase
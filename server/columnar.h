@@ -0,0 +1,75 @@
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace DataBase {
+
+	// Колоночный формат выгрузки базы данных для аналитики.
+	// Выгрузка - каталог с отдельным файлом для каждой колонки:
+	//   number.col     - номера телефонов, uint64 (например, 89993332211; международный номер E.164 -
+	//                    значение его цифр с установленным старшим битом, например 2^63 + 442071234567);
+	//   activity.col   - признаки активности, битовый массив (бит i - строка i, младший бит первым);
+	//   last_name.col, first_name.col, patronymic.col - коды словаря (uint8, uint16 или uint32 в зависимости
+	//                    от размера словаря) и словарь.
+	// Строка i всех колонок описывает одного абонента. Каждый файл начинается с заголовка column_header,
+	// значения начинаются со смещения data_offset, кратного 64, поэтому файл колонки можно отобразить в память
+	// и читать значения как массив. Словарь колонки с кодами: uint32 смещения начала каждой строки
+	// (dictionary_size + 1 значений, от начала словаря), затем байты строк в UTF-8; строки словаря упорядочены.
+	// Все числа хранятся в порядке байтов little-endian.
+
+	enum class column_type : uint32_t { uint64 = 1, bitset = 2, dictionary = 3 };
+
+	struct column_header {
+		char     magic[4];              // "PHCO"
+		uint32_t version;               // версия формата
+		char     name[16];              // имя колонки, дополненное нулями
+		uint32_t type;                  // column_type
+		uint32_t value_width;           // байт на значение (0 для битового массива)
+		uint64_t rows;                  // количество строк
+		uint64_t data_offset;           // смещение значений
+		uint64_t data_size;             // размер значений в байтах
+		uint64_t dictionary_offset;     // смещение словаря (0 - словаря нет)
+		uint64_t dictionary_size;       // количество строк словаря
+	};
+
+	// Файл колонки: создается с заголовком, значения записываются по номеру строки из нескольких потоков.
+	class column_writer {
+	public:
+		// создание файла dir_name/<name>.col; value_width = 0 для битового массива
+		column_writer(const std::string& dir_name, const std::string& name, column_type type,
+			uint32_t value_width, uint64_t rows, uint64_t dictionary_size = 0);
+		~column_writer();
+
+		column_writer(const column_writer&) = delete;
+		column_writer& operator=(const column_writer&) = delete;
+
+		// запись count значений, начиная со строки first_row (values - count * value_width байт);
+		// безопасна при одновременном вызове для непересекающихся диапазонов строк
+		void write_values(uint64_t first_row, const void* values, size_t count);
+
+		// запись всего битового массива (data_size байт)
+		void write_bitset(const std::vector<uint64_t>& words);
+
+		// запись словаря после значений и закрытие файла
+		void close(const std::vector<std::string>& dictionary = std::vector<std::string>());
+
+	private:
+		std::string file_name;
+		column_header header;
+		int fd;
+
+		void write_at(uint64_t offset, const void* data, size_t size);
+	};
+
+	// ширина кода словаря из dictionary_size строк: 1, 2 или 4 байта
+	uint32_t dictionary_code_width(size_t dictionary_size);
+
+	// чтение заголовка файла колонки
+	column_header read_column_header(const std::string& file_name);
+
+} // namespace DataBase
+
+#endif // COLUMNAR_H
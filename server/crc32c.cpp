@@ -0,0 +1,98 @@
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define CRC32C_X86 1
+#endif
+
+#include "crc32c.h"
+
+namespace DataBase {
+
+	namespace {
+
+		// таблицы slicing-by-8 для отраженного полинома 0x82F63B78
+		struct crc32c_tables {
+			uint32_t table[8][256];
+
+			crc32c_tables()
+			{
+				for (uint32_t i = 0; i < 256; ++i) {
+					uint32_t crc = i;
+					for (int j = 0; j < 8; ++j)
+						crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+					table[0][i] = crc;
+				}
+				for (uint32_t i = 0; i < 256; ++i)
+					for (int k = 1; k < 8; ++k)
+						table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+			}
+		};
+
+		const crc32c_tables tables;
+
+		uint32_t crc32c_software(const unsigned char* p, size_t size, uint32_t crc)
+		{
+			const uint32_t (*t)[256] = tables.table;
+			while (size >= 8) {
+				uint32_t low, high;
+				std::memcpy(&low, p, 4);
+				std::memcpy(&high, p + 4, 4);
+				low ^= crc;
+				crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24]
+					^ t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+				p += 8;
+				size -= 8;
+			}
+			while (size--)
+				crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+			return crc;
+		}
+
+#ifdef CRC32C_X86
+		__attribute__((target("sse4.2")))
+		uint32_t crc32c_sse42(const unsigned char* p, size_t size, uint32_t crc)
+		{
+			uint64_t crc64 = crc;
+			while (size >= 8) {
+				uint64_t value;
+				std::memcpy(&value, p, 8);
+				crc64 = _mm_crc32_u64(crc64, value);
+				p += 8;
+				size -= 8;
+			}
+			crc = (uint32_t)crc64;
+			while (size--)
+				crc = _mm_crc32_u8(crc, *p++);
+			return crc;
+		}
+
+		bool detect_sse42()
+		{
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("sse4.2");
+		}
+#else
+		bool detect_sse42() { return false; }
+#endif
+
+		const bool hardware = detect_sse42();
+	}
+
+	bool crc32c_hardware()
+	{
+		return hardware;
+	}
+
+	uint32_t crc32c(const void* data, size_t size, uint32_t crc)
+	{
+		const unsigned char* p = static_cast<const unsigned char*>(data);
+		crc = ~crc;
+#ifdef CRC32C_X86
+		if (hardware)
+			return ~crc32c_sse42(p, size, crc);
+#endif
+		return ~crc32c_software(p, size, crc);
+	}
+
+} // namespace DataBase
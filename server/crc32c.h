@@ -0,0 +1,20 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace DataBase {
+
+	// Контрольная сумма CRC32C (полином Кастаньоли 0x1EDC6F41).
+	// Продолжает вычисление суммы crc предыдущих данных: crc32c(b, crc32c(a)) == crc32c(a + b).
+	// На процессорах x86-64 с поддержкой SSE4.2 используется инструкция crc32 (несколько Гб/с),
+	// иначе - табличный алгоритм (slicing-by-8). Реализация выбирается при запуске программы.
+	uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0);
+
+	// используется ли аппаратная реализация CRC32C
+	bool crc32c_hardware();
+
+} // namespace DataBase
+
+#endif // CRC32C_H
@@ -0,0 +1,230 @@
+#include <cstring>
+#include <algorithm>
+
+#include <boost/filesystem.hpp>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define CSV_TOKENIZER_X86 1
+#endif
+
+#include "csv_tokenizer.h"
+#include "error.h"
+
+namespace DataBase {
+
+	namespace {
+
+		// маска разделителей для неполного окна в конце файла
+		uint64_t scan_scalar(const char* p, size_t size)
+		{
+			uint64_t mask = 0;
+			for (size_t i = 0; i < size && i < 64; ++i)
+				if (p[i] == ',' || p[i] == '\n')
+					mask |= uint64_t(1) << i;
+			return mask;
+		}
+
+#ifndef CSV_TOKENIZER_X86
+		uint64_t scan_window_scalar(const char* p)
+		{
+			return scan_scalar(p, 64);
+		}
+#else
+		uint64_t scan_window_sse2(const char* p)
+		{
+			const __m128i comma = _mm_set1_epi8(',');
+			const __m128i newline = _mm_set1_epi8('\n');
+			uint64_t mask = 0;
+			for (int i = 0; i < 4; ++i) {
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+				__m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, comma), _mm_cmpeq_epi8(v, newline));
+				mask |= uint64_t((uint16_t)_mm_movemask_epi8(m)) << (16 * i);
+			}
+			return mask;
+		}
+
+		__attribute__((target("avx2")))
+		uint64_t scan_window_avx2(const char* p)
+		{
+			const __m256i comma = _mm256_set1_epi8(',');
+			const __m256i newline = _mm256_set1_epi8('\n');
+			__m256i low  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+			__m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+			uint32_t low_mask  = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(low, comma), _mm256_cmpeq_epi8(low, newline)));
+			uint32_t high_mask = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(high, comma), _mm256_cmpeq_epi8(high, newline)));
+			return uint64_t(low_mask) | (uint64_t(high_mask) << 32);
+		}
+#endif
+
+		typedef uint64_t (*scan_function)(const char*);
+
+		scan_function select_scan(const char*& name)
+		{
+#ifdef CSV_TOKENIZER_X86
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2")) {
+				name = "avx2";
+				return scan_window_avx2;
+			}
+			name = "sse2";
+			return scan_window_sse2;
+#else
+			name = "scalar";
+			return scan_window_scalar;
+#endif
+		}
+
+		const char* scan_name = "";
+		const scan_function scan_window = select_scan(scan_name);
+
+		inline unsigned int lowest_bit(uint64_t mask)
+		{
+			return (unsigned int)__builtin_ctzll(mask);
+		}
+
+		inline boost::string_view trim(const char* begin, const char* end)
+		{
+			while (begin < end && (*begin == ' ' || *begin == '\t'))
+				++begin;
+			while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+				--end;
+			return boost::string_view(begin, end - begin);
+		}
+	}
+
+	subscriber_csv_reader::subscriber_csv_reader(const std::string& name) : file_name(name), first_line(1)
+	{
+		size_t size = map_file();
+		file_begin = size ? static_cast<const char*>(region.get_address()) : nullptr;
+		start(file_begin, size);
+	}
+
+	subscriber_csv_reader::subscriber_csv_reader(const std::string& name, unsigned long long begin, unsigned long long end) :
+		file_name(name), first_line(1)
+	{
+		size_t size = map_file();
+		file_begin = size ? static_cast<const char*>(region.get_address()) : nullptr;
+
+		// начало первой строки, начинающейся не раньше позиции position
+		auto line_start = [&](unsigned long long position) -> size_t {
+			if (position == 0)
+				return 0;
+			if (position >= size)
+				return size;
+			const void* p = std::memchr(file_begin + position - 1, '\n', size - position + 1);
+			return p ? static_cast<const char*>(p) - file_begin + 1 : size;
+		};
+
+		size_t first = line_start(begin);
+		size_t last = std::max(first, line_start(end));
+		start(file_begin + first, last - first);
+	}
+
+	size_t subscriber_csv_reader::map_file()
+	{
+		boost::system::error_code ec;
+		auto size = boost::filesystem::file_size(file_name, ec);
+		if (ec)
+			throw FileOpenError(file_name);
+
+		// пустой файл не отображается в память
+		if (size == 0)
+			return 0;
+		try {
+			file = boost::interprocess::file_mapping(file_name.c_str(), boost::interprocess::read_only);
+			region = boost::interprocess::mapped_region(file, boost::interprocess::read_only);
+		}
+		catch (boost::interprocess::interprocess_exception&) {
+			throw FileOpenError(file_name);
+		}
+		region.advise(boost::interprocess::mapped_region::advice_sequential);
+		return region.get_size();
+	}
+
+	subscriber_csv_reader::subscriber_csv_reader(const char* data, size_t size, const std::string& name, unsigned long first) :
+		file_name(name), first_line(first)
+	{
+		file_begin = data;
+		start(data, size);
+	}
+
+	void subscriber_csv_reader::start(const char* data, size_t size)
+	{
+		end = data + size;
+		row_start = data;
+		window = data;
+		mask = size == 0 ? 0 : (size >= 64 ? scan_window(data) : scan_scalar(data, size));
+		line = 0;
+	}
+
+	const char* subscriber_csv_reader::implementation()
+	{
+		return scan_name;
+	}
+
+	const char* subscriber_csv_reader::next_delimiter()
+	{
+		while (mask == 0) {
+			window += 64;
+			if (window >= end)
+				return end;
+			mask = (end - window >= 64) ? scan_window(window) : scan_scalar(window, end - window);
+		}
+		const char* p = window + lowest_bit(mask);
+		mask &= mask - 1;
+		return p;
+	}
+
+	void subscriber_csv_reader::error(const std::string& reason) const
+	{
+		// номер строки от начала файла вычисляется только при ошибке
+		unsigned long preceding = (unsigned long)std::count(file_begin, row_start, '\n');
+		throw FileCorruptError(file_name, "строка " + std::to_string(preceding + first_line) + ", " + reason);
+	}
+
+	bool subscriber_csv_reader::next(subscriber_row& row)
+	{
+		boost::string_view* fields[4] = { &row.number, &row.last_name, &row.first_name, &row.patronymic };
+
+		while (row_start < end) {
+			++line;
+			const char* field = row_start;
+			const char* p = next_delimiter();
+
+			// пустая строка пропускается
+			if ((p == end || *p == '\n') && trim(field, p).empty()) {
+				row_start = (p == end) ? end : p + 1;
+				continue;
+			}
+
+			// четыре поля, завершающиеся запятой
+			for (int i = 0; i < 4; ++i) {
+				if (p == end || *p == '\n')
+					error("недостаточно полей");
+				*fields[i] = trim(field, p);
+				field = p + 1;
+				p = next_delimiter();
+			}
+
+			// признак активности завершается переводом строки или концом файла
+			if (p != end && *p != '\n')
+				error("лишние поля");
+			boost::string_view activity = trim(field, p);
+			if (activity.empty())
+				error("отсутствует признак активности");
+			bool value = false;
+			for (char c : activity) {
+				if (c < '0' || c > '9')
+					error("недопустимый признак активности");
+				value = value || (c != '0');
+			}
+			row.activity = value;
+
+			row_start = (p == end) ? end : p + 1;
+			return true;
+		}
+		return false;
+	}
+
+} // namespace DataBase
@@ -0,0 +1,80 @@
+#ifndef CSV_TOKENIZER_H
+#define CSV_TOKENIZER_H
+
+#include <string>
+#include <cstdint>
+
+#include <boost/utility/string_view.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace DataBase {
+
+	// строка файла базы данных: поля указывают на данные файла и действительны, пока существует ридер
+	struct subscriber_row {
+		boost::string_view number;
+		boost::string_view last_name;
+		boost::string_view first_name;
+		boost::string_view patronymic;
+		bool activity;
+	};
+
+	// Разбор файлов базы данных в формате csv, которые записывает Save:
+	//   89993332211, Фамилия, Имя, Отчество, 1
+	// Файл отображается в память. Положения запятых и переводов строк находятся сразу для 64 байт
+	// с помощью SSE2 или AVX2 (выбирается при запуске программы) и выбираются из битовой маски,
+	// поэтому каждый байт файла просматривается один раз. Поля возвращаются как string_view без копирования;
+	// пробелы и табуляции по краям поля отбрасываются, как в io::CSVReader. Кавычки не поддерживаются -
+	// Save их не записывает. Ошибки формата сообщаются исключением FileCorruptError с номером строки.
+	class subscriber_csv_reader {
+	public:
+		explicit subscriber_csv_reader(const std::string& file_name);
+
+		// Разбор части файла: строки, начинающиеся в диапазоне байтов [begin, end). Строка, пересекающая
+		// границу диапазона, относится к диапазону, в котором она начинается, поэтому соседние диапазоны
+		// разбирают каждую строку файла ровно один раз.
+		subscriber_csv_reader(const std::string& file_name, unsigned long long begin, unsigned long long end);
+
+		// разбор данных в памяти; file_name используется в сообщениях об ошибках,
+		// first_line - номер первой строки данных (для фрагмента большего потока данных)
+		subscriber_csv_reader(const char* data, size_t size, const std::string& file_name, unsigned long first_line = 1);
+
+		subscriber_csv_reader(const subscriber_csv_reader&) = delete;
+		subscriber_csv_reader& operator=(const subscriber_csv_reader&) = delete;
+
+		// чтение очередной строки; возвращает false по окончании файла
+		bool next(subscriber_row& row);
+
+		// номер последней прочитанной строки (от начала разбираемого диапазона)
+		unsigned long line_number() const { return line; }
+
+		// используемый набор инструкций: "avx2", "sse2" или "scalar"
+		static const char* implementation();
+
+	private:
+		std::string file_name;
+		boost::interprocess::file_mapping file;
+		boost::interprocess::mapped_region region;
+
+		const char* file_begin;  // начало файла (для номера строки в сообщении об ошибке)
+		unsigned long first_line;  // номер строки, начинающейся в file_begin
+		const char* end;
+		const char* row_start;   // начало следующей строки
+		const char* window;      // начало текущего 64-байтного окна
+		uint64_t mask;           // непросмотренные разделители текущего окна
+		unsigned long line;
+
+		// отображение файла в память; возвращает размер файла
+		size_t map_file();
+
+		void start(const char* data, size_t size);
+
+		// положение следующей запятой или перевода строки (end, если разделителей больше нет)
+		const char* next_delimiter();
+
+		[[noreturn]] void error(const std::string& reason) const;
+	};
+
+} // namespace DataBase
+
+#endif // CSV_TOKENIZER_H
@@ -1,21 +1,55 @@
 ﻿#ifndef data_H
 #define data_H
 
+#include <iostream>
 #include <vector>
 #include <set>
 #include <random>
+#include <thread>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <unordered_set>
+#include <unordered_map>
+#include <boost/filesystem.hpp>
 #include "record.h"
 #include "error.h"
 #include "thread_safe_map.h"
 #include "hash.h"
+#include "random.h"
+#include "sharded_counter.h"
+#include "name_index.h"
+#include "generator.h"
+#include "wal.h"
+#include "checkpoint.h"
+#include "file_utils.h"
+#include "snapshot.h"
+#include "direct_io.h"
+#include "csv_tokenizer.h"
+#include "columnar.h"
+#include "fork_save.h"
 #include "../lib/csv.h"
 
 
 namespace DataBase {
 
-	typedef std::vector<std::string> names_vector;
 	template<typename Key, typename T> class data_iterator;
 
+	// строка пакета импорта: поля строки (ссылаются на данные пакета) и индексы ее номера
+	struct import_row {
+		subscriber_row row;
+		number_index index;
+	};
+
+	// результат поиска номера в data::FindBatch
+	enum class find_status { found, not_found, invalid_number };
+
+	// отбор записей по признаку активности в data::FindRange
+	enum class activity_filter { all, active, inactive };
+
 	// база данных параметризуется типом ключа Key и типом хранящегося элемента T
 	template<typename Key, typename T>
 	class data {
@@ -26,7 +60,7 @@ namespace DataBase {
 		typedef std::pair<const Key, T> value_type;
 		typedef size_t size_type;
 		typedef DefaultHash<std::string> Hash;
-		typedef std::vector<thread_safe_map<int, T>>   data_vector;
+		typedef std::vector<thread_safe_map<number_key, T>>   data_vector;
 
 		// итератор контейнера.
 		typedef data_iterator<key_type, mapped_type> const_iterator;
@@ -38,47 +72,166 @@ namespace DataBase {
 		// членам класса data. 
 		friend class data_iterator<key_type, mapped_type>;
 				
-		// конструктор базы данных, int 2^number_of_first_digits - размер внешнего вектора; int 2^number_of_second_digits - размер (максимальный) внутреннего ассоциативного массива
-		explicit  data(int number_of_first_digits = 4, int number_of_second_digits = 6);
+		// конструктор базы данных, int 2^number_of_first_digits - размер внешнего вектора; int 2^number_of_second_digits - размер (максимальный) внутреннего ассоциативного массива;
+		// plan - нумерационный план международных номеров, сегменты которого следуют за сегментами номеров "8" + 10 цифр
+		explicit  data(int number_of_first_digits = 4, int number_of_second_digits = 6, const numbering_plan& plan = numbering_plan());
 
-		~data() { }
+		~data();
+
+		// генерация базы данных по распределениям profile из списков имен names (загруженных заранее,
+		// поэтому файлы имен не читаются под блокировкой базы данных); при одинаковом seed база данных не зависит от num_threads
+		std::pair<unsigned long, unsigned long long> Generate(int num_records, int num_threads, const name_lists& names,
+			int wait_time = 1000, uint64_t seed = random_seed(), const generation_profile& profile = generation_profile());
 
-		// генерация базы данных
-		std::pair<unsigned long, unsigned long long> Generate(int num_records = 10, int num_threads = 4, int wait_time = 1000,
-			const std::string& last_name_male_file    = "last_name_male.csv",
-			const std::string& last_name_female_file  = "last_name_female.csv",
-			const std::string& first_name_male_file   = "first_name_male.csv",
-			const std::string& first_name_female_file = "first_name_female.csv",
-			const std::string& patronymic_male_file   = "patronymic_male.csv",
-			const std::string& patronymic_female_file = "patronymic_female.csv"
-		);
 
 		// сохранение базы данных на диск
 		unsigned long Save(const unsigned int num_threads = 1, const std::string file_name = "data.csv", int wait_time = 1000);
 
-		// загрузка базы данных с диска в память
+		// Сохранение базы данных в файлах формата Save дочерним процессом, созданным fork() (fork_save.h).
+		// Операции записи приостанавливаются только на время fork(), дочерний процесс сохраняет копию базы данных
+		// на момент fork(). Возвращает количество записей, время fork() и сохранения и рост памяти сервера.
+		forked_save_stats SaveForked(const unsigned int num_threads = 1, const std::string file_name = "data.csv", int wait_time = 1000);
+
+		// загрузка базы данных с диска в память. Если снимок с манифестом не прошел сверку с манифестом или
+		// его сохранение было прервано (манифеста нет, а поколение 1 есть), загружается поколение 1 (Get_loaded_generation).
 		unsigned long Load(const unsigned int num_threads = 1, const std::string file_name = "data.csv", int wait_time = 1000);
 
+		// Сохранение базы данных в один файл блочного двоичного формата (snapshot.h). Блоки формируются
+		// и сжимаются в num_threads потоках независимо друг от друга и записываются в файл по порядку.
+		unsigned long SaveSnapshot(const unsigned int num_threads = 1, const std::string file_name = "data.snap",
+			block_compression compression = block_compression::zlib, int wait_time = 1000);
+
+		// Запись согласованного снимка базы данных в блочном формате в поток out. Синхронизация и формирование
+		// блоков аналогичны SaveSnapshot, контрольная точка не создается. Операции записи ожидают завершения записи
+		// в out, поэтому out не должен зависеть от внешнего клиента (/export пишет во временный файл).
+		unsigned long ExportSnapshot(std::ostream& out, const unsigned int num_threads = 1,
+			block_compression compression = block_compression::zlib, int wait_time = 1000);
+
+		// Имя файла последнего сохраненного или загруженного снимка блочного формата, если база данных не изменялась
+		// после его сохранения (загрузки) и файл не изменен; иначе пустая строка.
+		std::string RecentSnapshot() const;
+
+		// загрузка базы данных из файла блочного формата: блоки читаются и распаковываются в num_threads потоках
+		unsigned long LoadSnapshot(const unsigned int num_threads = 1, const std::string file_name = "data.snap", int wait_time = 1000);
+
+		// Ленивая загрузка базы данных из файла блочного формата. Файл отображается в память, все сегменты
+		// помечаются как незагруженные, и операция возвращает управление сразу после чтения положения блоков.
+		// Блок загружается при первом обращении к одному из его сегментов, остальные блоки по порядку
+		// загружает фоновый поток. Возвращает количество записей в снимке.
+		unsigned long LoadLazy(const std::string file_name = "data.snap", int wait_time = 1000);
+
+		// загрузка всех еще не загруженных блоков снимка; вызывается операциями, обходящими всю базу данных
+		void MaterializeAll();
+
+		// количество еще не загруженных блоков ленивой загрузки
+		size_t Get_number_of_lazy_blocks() const { return lazy_remaining.load(); }
+
+		// Инкрементальное сохранение базы данных в каталог dir_name: перезаписываются только сегменты,
+		// измененные после предыдущей контрольной точки в этом каталоге, после чего атомарно обновляется манифест.
+		// Возвращает количество перезаписанных сегментов и количество записей в них.
+		std::pair<unsigned long, unsigned long> SaveIncremental(const unsigned int num_threads = 1, const std::string dir_name = "snapshot", int wait_time = 1000);
+
+		// загрузка базы данных из каталога инкрементальных контрольных точек (актуальные версии всех сегментов)
+		unsigned long LoadIncremental(const unsigned int num_threads = 1, const std::string dir_name = "snapshot", int wait_time = 1000);
+
+		// Колоночная выгрузка базы данных в каталог dir_name (формат описан в columnar.h): номера, признаки
+		// активности и коды словарей имен записываются в отдельные файлы в num_threads потоках по диапазонам сегментов.
+		// Выгрузка предназначена для аналитики и не загружается обратно. Возвращает количество записей.
+		unsigned long SaveColumnar(const unsigned int num_threads = 1, const std::string dir_name = "columns", int wait_time = 1000);
+
 		// очистка базы данных
 		void Clear(unsigned  int num_threads = 1, int wait_time = 1000);
 
-		// добавление записи в базу данных
-		bool AddRecord(key_type& number, bool activity, mapped_type& rec, int wait_time = 1000);
+		// Добавление записи в базу данных. Номер передается как string_view: строка запроса не копируется,
+		// а номер преобразуется в индексы без выделения памяти.
+		bool AddRecord(boost::string_view number, bool activity, mapped_type& rec, int wait_time = 1000);
+
+		// Разбор строк формата csv [text, text + size) для импорта: номера преобразуются в индексы, и строки
+		// распределяются по parts.size() частям по сегменту номера (сегмент % количество частей), поэтому записи
+		// одного номера E.164 с '+' и без него попадают в одну часть. source и first_line используются
+		// в сообщениях об ошибках; строки, предшествующие ошибке формата, распределяются до ее исключения.
+		// Поля строк ссылаются на данные text.
+		void SplitImportRows(const char* text, size_t size, const std::string& source, unsigned long first_line,
+			std::vector<std::vector<import_row> >& parts) const;
+
+		// Добавление или замена разобранных записей (SplitImportRows) - пакетный вариант AddRecord: блокировка
+		// захватывается, а запись журнала ожидается один раз на пакет. Записи одной части добавляются одним
+		// потоком, поэтому записи одного номера добавляются в порядке строк. Возвращает количество новых и
+		// замененных записей.
+		std::pair<unsigned long, unsigned long> ImportRows(const std::vector<import_row>& rows, int wait_time = 1000);
 
 		// удаление записи из базы данных
-		bool DeleteRecord(key_type& number, int wait_time = 1000);
+		bool DeleteRecord(boost::string_view number, int wait_time = 1000);
 
 		// поиск записи в базе данных по номеру телефона
-		bool FindRecord(const key_type& number, bool& activity, mapped_type& rec, const unsigned int wait_time = 1000);
+		bool FindRecord(boost::string_view number, bool& activity, mapped_type& rec, const unsigned int wait_time = 1000);
+
+		// Поиск записей по номерам numbers[0..count) под одной блокировкой базы данных. Номера преобразуются в индексы
+		// пакетами и упорядочиваются по сегментам и вторым частям номера; блокировка каждого сегмента захватывается один раз.
+		// Для каждого номера в порядке обработки (а не в порядке numbers) вызывается visit(позиция номера в numbers,
+		// find_status, activity, const mapped_type* rec); запись rec действительна только внутри visit.
+		template<typename Visit>
+		void FindBatch(const boost::string_view* numbers, size_t count, Visit visit, const unsigned int wait_time = 1000);
+
+		// Обход записей с номерами "8" + 10 цифр из диапазона [from, to] по возрастанию номеров (from и to - индексы
+		// Hasher.hash номеров этого вида). Поиск начинается сразу с сегмента и ключа from, сегменты за to не просматриваются,
+		// поэтому время обхода пропорционально количеству записей диапазона, а не размеру базы данных.
+		// Для каждой записи, отобранной filter, вызывается visit(сегмент, ключ, activity, const mapped_type& rec);
+		// запись действительна только внутри visit. Если в диапазоне осталось больше max_records записей, обход
+		// прекращается, from устанавливается на следующую запись и возвращается false (следующий вызов продолжает обход
+		// без удержания блокировки между вызовами); при завершении диапазона возвращается true.
+		template<typename Visit>
+		bool FindRange(number_index& from, const number_index& to, activity_filter filter, size_t max_records,
+			Visit visit, const unsigned int wait_time = 1000);
+
+		// Поиск записей по имени с помощью индекса имен: по фамилии, по полному имени (фамилия, имя и отчество)
+		// или по фамилии и одной из частей имени (записи фамилии отбираются по заданной части). Для каждой найденной
+		// записи по возрастанию номеров вызывается visit(сегмент, ключ, activity, const mapped_type& rec); запись
+		// действительна только внутри visit. Возвращает количество найденных записей. Записи незагруженных блоков
+		// снимка ленивой загрузки отсутствуют в индексе, поэтому перед поиском загружаются все блоки (MaterializeAll).
+		template<typename Visit>
+		unsigned long FindByName(boost::string_view last_name, boost::string_view first_name, boost::string_view patronymic,
+			Visit visit, const unsigned int wait_time = 1000);
+
+		// Ведение индекса имен (по умолчанию не ведется). При включении индекс строится по записям базы данных
+		// в num_threads потоках, при выключении удаляется.
+		void SetNameIndex(bool enabled, unsigned int num_threads = 1);
+
+		// признак ведения индекса имен, количество фамилий и полных имен в индексе и размер его памяти в байтах
+		bool Get_name_index_enabled() const { return name_index_enabled; }
+		size_t Get_name_index_last_names() const { return names_index.number_of_last_names(); }
+		size_t Get_name_index_full_names() const { return names_index.number_of_full_names(); }
+		size_t Get_name_index_memory() const { return names_index.memory(); }
 
 		// чтение размера базы данных
 		unsigned long Get_number_of_records(void)  const;
 		unsigned long long Get_number_of_bytes(void) const;
 		int Get_first_length(void)  const;
 
+		// поколение снимка, загруженное последней операцией Load (0 - текущий снимок)
+		unsigned int Get_loaded_generation(void) const { return loaded_generation; }
+
+		// количество сегментов: сегменты номеров "8" + 10 цифр и сегменты нумерационного плана
+		unsigned int Get_number_of_buckets(void)  const;
+
 		// захват блокировки внешним кодом
 		boost::shared_lock<boost::shared_mutex> GetLock(void);
 
+		// подключение журнала упреждающей записи: операции AddRecord и DeleteRecord записываются в журнал,
+		// операции Save, Load и Clear создают в журнале контрольную точку
+		void AttachLog(write_ahead_log* wal);
+
+		// выбор способа ввода-вывода для операций Save и Load (по умолчанию io_backend::stream)
+		void SetIOBackend(io_backend backend) { io = backend; }
+
+		// количество хранимых прежних снимков операции Save (поколения <файл>.1, <файл>.2, ...); 0 - не хранить
+		void SetSaveRetention(unsigned int retention) { save_retention = retention; }
+
+		// восстановление базы данных при запуске: загрузка снимка последней контрольной точки,
+		// применение к нему записей журнала и подключение журнала. Возвращает количество примененных записей журнала.
+		// При lazy = true снимок блочного формата загружается лениво (LoadLazy).
+		unsigned long Recover(write_ahead_log& wal, bool lazy = false, int wait_time = 1000);
+
 		// отладочная функция: печать первых N записей базы данных активных и неактивных абонентов
 		int Print(int N, int wait_time = 1000);
 		
@@ -86,8 +239,10 @@ namespace DataBase {
 		// количество разрядов телефонного номера для внешнего вектора и внутреннего ассоциативного массива
 		int number_of_first_digits, number_of_second_digits;
 
-		std::atomic<unsigned long>      number_of_records; // количество записей в базе данных 
-		std::atomic<unsigned long long> number_of_bytes;   // количество байт в базе данных 
+		// Количество записей и байт в базе данных. Счетчики изменяются при каждой вставке и удалении записи
+		// из всех потоков загрузки, генерации и запросов, поэтому распределены по ячейкам потоков (sharded_counter.h).
+		sharded_counter<unsigned long>      number_of_records;
+		sharded_counter<unsigned long long> number_of_bytes;
 
 		// векторы activ_users и inactiv_users содержат ассоциативные массивы для активных и неактивных абонентов
 		data_vector activ_users;
@@ -104,9 +259,107 @@ namespace DataBase {
 		std::atomic<unsigned int> count_of_read_operations;
 		std::atomic<unsigned int> count_of_write_operations;
 
-		names_vector v_last_name;
-		names_vector v_name;
-		names_vector v_patronymic;
+		// Признаки изменения сегментов после последней инкрементальной контрольной точки.
+		// Устанавливаются в AddRecord_no_block и DeleteRecord_no_block, а также при генерации и очистке базы данных.
+		std::vector<std::atomic<bool> > dirty;
+
+		// Счетчик изменений базы данных; увеличивается вместе с установкой признаков изменения сегментов.
+		// Только увеличивается, поэтому сумма ячеек при сравнении с сохраненным значением не убывает.
+		sharded_counter<unsigned long long> modifications;
+
+		// Последний сохраненный или загруженный снимок блочного формата: имя, размер и время изменения файла
+		// и значение счетчика изменений, с которым он согласован (используется RecentSnapshot).
+		mutable std::mutex recent_snapshot_mutex;
+		std::string recent_snapshot;
+		uintmax_t recent_snapshot_size;
+		std::time_t recent_snapshot_time;
+		unsigned long long recent_snapshot_modifications;
+
+		// запоминание снимка file_name как согласованного с текущим состоянием базы данных
+		void SetRecentSnapshot(const std::string& file_name);
+
+		// формирование блоков снимка в num_threads потоках и запись их в writer
+		unsigned long WriteSnapshot(snapshot_writer& writer, const unsigned int num_threads, block_compression compression);
+
+		// каталог и номер инкрементальной контрольной точки, с которой согласованы признаки изменения сегментов
+		std::string checkpoint_dir;
+		unsigned long checkpoint_version;
+
+		// журнал упреждающей записи (nullptr - журнал не используется)
+		write_ahead_log* log;
+
+		// Блокировки сегментов журнала: применение операции к сегменту базы данных и ее запись в журнал
+		// выполняются под одной блокировкой, поэтому записи журнала для одного номера упорядочены так же, как в памяти.
+		std::vector<std::mutex> log_mutexes;
+
+		// способ ввода-вывода файлов csv в Save и Load
+		io_backend io;
+
+		// Индекс имен (name_index.h): списки номеров по фамилии и полному имени. Ведется AddRecord_no_block
+		// и DeleteRecord_no_block; при генерации и загрузке базы данных (name_index_deferred) записи в индекс
+		// по одной не добавляются, а индекс строится после добавления всех записей в num_threads потоках.
+		name_index names_index;
+		bool name_index_enabled;
+		bool name_index_deferred;
+
+		// номер записи в индексе имен: для номеров "8" + 10 цифр - 10 цифр номера (списки упорядочены по номерам),
+		// для международных номеров - ключ нумерационного плана с установленным старшим битом
+		uint64_t NameIndexId(int first_number, number_key second_number) const;
+		number_index NameIndexNumber(uint64_t id) const;
+
+		// построение индекса имен по всем записям базы данных в num_threads потоках (под монопольной блокировкой)
+		void RebuildNameIndex(unsigned int num_threads);
+
+		// Вспомогательный класс отложенного построения индекса имен на время генерации или загрузки базы данных.
+		// Индекс строится методом rebuild до освобождения блокировки; если операция прервана исключением,
+		// индекс строится по добавленным записям в деструкторе.
+		class deferred_name_index {
+			data& db;
+			unsigned int num_threads;
+		public:
+			deferred_name_index(data& d, unsigned int threads) : db(d), num_threads(threads)
+			{
+				db.name_index_deferred = true;
+			}
+
+			void rebuild()
+			{
+				db.name_index_deferred = false;
+				try {
+					db.RebuildNameIndex(num_threads);
+				}
+				catch (...) {
+					db.names_index.clear();
+					throw;
+				}
+			}
+
+			~deferred_name_index()
+			{
+				if (!db.name_index_deferred)
+					return;
+				db.name_index_deferred = false;
+				try {
+					db.RebuildNameIndex(num_threads);
+				}
+				catch (...) {
+					db.names_index.clear();
+				}
+			}
+		};
+
+		unsigned int save_retention;  // количество хранимых прежних снимков Save
+		unsigned int loaded_generation; // поколение снимка последней операции Load
+
+		// Состояние ленивой загрузки (LoadLazy): отображенный файл снимка, номер блока для каждого сегмента
+		// (-1 - сегмент отсутствует в снимке), признаки загрузки блоков и фоновый поток загрузки.
+		std::unique_ptr<snapshot_mapping> lazy_snapshot;
+		std::vector<int> lazy_block_of_bucket;
+		std::unique_ptr<std::once_flag[]> lazy_once;
+		size_t lazy_number_of_blocks;
+		std::atomic<size_t> lazy_remaining;   // количество незагруженных блоков; 0 - ленивая загрузка не выполняется
+		std::atomic<bool> lazy_stop;
+		std::thread lazy_thread;
 
 		// установка размера базы данных
 		void Set_number_of_records(unsigned long N);
@@ -115,30 +368,100 @@ namespace DataBase {
 		bool Empty();
 
 		// Вспомогательный метод добавления записи в базу данных без захвата блокировки.
-		bool AddRecord_no_block(const unsigned int& first_number, const unsigned int& second_number, const bool& activity, mapped_type& rec);
+		bool AddRecord_no_block(const unsigned int& first_number, const number_key& second_number, const bool& activity, mapped_type& rec);
 
 		// Вспомогательный метод удаления записи из базы данных без захвата блокировки.
-		bool DeleteRecord_no_block(int first_number, int second_number);
-
-		// однопоточный метод генерации базы данных.
-		void GenerateOneThread(unsigned int count,
-			unsigned int block_begin,
+		bool DeleteRecord_no_block(int first_number, number_key second_number);
+
+		// Разбиение [0, count) на num_threads последовательных диапазонов с примерно равным суммарным весом
+		// weight(i) - количеством записей сегментов: сегменты нумерационного плана заполнены неравномерно,
+		// поэтому диапазоны с равным количеством сегментов дают потокам разный объем работы.
+		// Диапазон потока i - [bounds[i], bounds[i + 1]).
+		template<typename Weight>
+		static std::vector<unsigned int> SplitBuckets(unsigned int count, unsigned int num_threads, Weight weight);
+
+		// количество записей сегмента index
+		unsigned long long BucketRecords(unsigned int index) const
+		{
+			return activ_users[index].size() + inactiv_users[index].size();
+		}
+
+		// однопоточный метод генерации базы данных: сегменты [block_begin, block_end) по модели генерации.
+		void GenerateOneThread(unsigned int block_begin,
 			unsigned int block_end,
-			const names_vector& v_last_name_male,
-			const names_vector& v_last_name_female,
-			const names_vector& v_first_name_male,
-			const names_vector& v_first_name_female,
-			const names_vector& v_patronymic_male,
-			const names_vector& v_patronymic_female);
+			const generation_model& model,
+			uint64_t seed);
 
 		// однопоточный метод очистки базы данных.
 		void ClearOneThread(unsigned int block_begin, unsigned int block_end);
 
+		// запись базы данных в файлы операции Save в num_threads потоках без синхронизации с другими операциями
+		unsigned long SaveFiles(const unsigned int num_threads, const std::string file_name);
+
 		// однопоточный метод сохранения базы данных.
 		unsigned long SaveOneThread(unsigned int block_begin, unsigned int block_end, const std::string file_name);
 
+		// Вывод номера телефона сегмента bucket по ключу записи в строку вывода thread_safe_map::print;
+		// номер записывается по таблице двузначных чисел (hash.h) без выделения памяти.
+		struct number_writer {
+			const Hash& hasher;
+			int bucket;
+
+			void operator()(const number_key& key, std::string& line) const
+			{
+				char number[Hash::max_number_length];
+				line.append(number, hasher.unhash(bucket, key, number));
+			}
+		};
+
+		// вывод записей сегментов [block_begin, block_end) в поток; возвращает количество выведенных записей
+		unsigned long PrintBuckets(std::ostream& file, unsigned int block_begin, unsigned int block_end);
+
+		// конец диапазона, соответствующий концу файла
+		static const unsigned long long whole_file = ~0ULL;
+
+		// количество строк csv, номера которых преобразуются в индексы одним вызовом Hasher.hash (Load, SplitImportRows)
+		static const size_t hash_batch_size = 64;
+
 		// однопоточный метод загрузки базы данных.
-		unsigned long LoadOneThread(const std::string file_name);
+		unsigned long LoadOneThread(const std::string file_name, unsigned long long begin = 0, unsigned long long end = whole_file);
+
+		// загрузка снимка по манифесту: файлы и их части распределяются по num_threads потокам
+		unsigned long LoadPieces(const unsigned int num_threads, const std::string file_name, const save_manifest& manifest,
+			unsigned int generation = 0);
+
+		// количество сегментов в одном блоке снимка
+		static const unsigned int buckets_per_block = 16;
+
+		// формирование блока снимка из сегментов [first_bucket, end_bucket)
+		void BuildBlock(unsigned int first_bucket, unsigned int end_bucket, block_compression compression,
+			block_header& header, std::string& stored);
+
+		// добавление в базу данных записей несжатого блока снимка; записи должны принадлежать сегментам блока
+		unsigned long LoadBlock(uint32_t version, const block_header& header, const std::string& raw);
+
+		// загрузка блока ленивой загрузки, содержащего сегмент bucket, если он еще не загружен
+		void MaterializeBucket(unsigned int bucket);
+
+		// загрузка блока ленивой загрузки с номером i (выполняется однократно)
+		void MaterializeBlock(size_t i);
+
+		// функция фонового потока ленивой загрузки
+		void LazyWarmUp();
+
+		// прекращение ленивой загрузки без загрузки оставшихся блоков
+		void StopLazyLoad();
+
+		// удаление записей, загруженных прерванной из-за ошибки операцией загрузки
+		void DiscardPartialLoad();
+
+		// однопоточный метод записи сегментов buckets[begin, end) в файлы версии version каталога dir_name;
+		// количество записей каждого сегмента сохраняется в counts
+		void SaveBucketsOneThread(const std::vector<unsigned int>& buckets, size_t begin, size_t end,
+			const std::string& dir_name, unsigned long version, std::vector<unsigned long>& counts);
+
+		// однопоточный метод загрузки списка файлов
+		unsigned long LoadFilesOneThread(const std::vector<std::string>& files, size_t begin, size_t end);
 	
 		// вспомогательный класс, изменяющий счетчик операций записи/чтения в конструкторе при создании объекта
 		// и отменяющей данное изменении в деструкторе при уничтожении объекта
@@ -171,16 +494,16 @@ namespace DataBase {
 	// базовым классом выбран однонаправленный итератор forward_iterator_tag.
 	template<typename Key, typename T>
 	class data_iterator :
-		public std::iterator<std::forward_iterator_tag, std::pair<const int, T> > // наследуем итератор от итератора из шаблонного класса iterator_traits
+		public std::iterator<std::forward_iterator_tag, std::pair<const number_key, T> > // наследуем итератор от итератора из шаблонного класса iterator_traits
 	{
 	public:
 		data_iterator(); //конструктор по умолчанию
-		data_iterator(unsigned int, bool, typename thread_safe_map<int, T>::const_iterator,
+		data_iterator(unsigned int, bool, typename thread_safe_map<number_key, T>::const_iterator,
 			const data<Key, T>*);
 
 		// операторы разыменования итератора
-		const std::pair<const int, T>& operator*()  const;
-		const std::pair<const int, T>* operator->() const;
+		const std::pair<const number_key, T>& operator*()  const;
+		const std::pair<const number_key, T>* operator->() const;
 
 		// оператор инкрементирования
 		data_iterator<Key, T>& operator++(); // префиксный инкремент
@@ -198,17 +521,10 @@ namespace DataBase {
 	private:
 		unsigned int mBucket;
 		bool activ;
-		typename thread_safe_map<int, T>::const_iterator it;
+		typename thread_safe_map<number_key, T>::const_iterator it;
 		const    data<Key, T>* ptr_vector;
 	};
 
-	// Вспомогательные функции:
-	// Чтение базы данных имен, фамилий и отчеств из файла f в вектор v
-	names_vector read_name_file(const std::string& file_name);
-
-	// Функция из вектора случайным образом выбирает имя с заданным полом
-	const std::string& generate_random_name(const names_vector& v, const std::string& sex);
-
 } // namespace DataBase
 
 #include "data.inl" // "C++ Cookbook", D.Ryan Stephens в главе 2.5 Including an inline File.
@@ -6,28 +6,55 @@
 namespace DataBase {
 
 	template<typename Key, typename T>
-	data<Key, T>::data(int L_ex, int L_in)
+	const unsigned long long data<Key, T>::whole_file;
+
+	template<typename Key, typename T>
+	const size_t data<Key, T>::hash_batch_size;
+
+	template<typename Key, typename T>
+	data<Key, T>::data(int L_ex, int L_in, const numbering_plan& plan)
 		try :
 		number_of_first_digits(L_ex), number_of_second_digits(L_in), number_of_records(0), number_of_bytes(0),
-		activ_users(int(pow(10, L_ex))), inactiv_users(int(pow(10, L_ex))),
+		activ_users(int(pow(10, L_ex)) + plan.number_of_buckets()), inactiv_users(int(pow(10, L_ex)) + plan.number_of_buckets()),
 		count_of_read_operations(0), count_of_write_operations(0),
-		Hasher(L_ex, L_in)
+		dirty(int(pow(10, L_ex)) + plan.number_of_buckets()), modifications(0),
+		recent_snapshot_size(0), recent_snapshot_time(0), recent_snapshot_modifications(0), checkpoint_version(0),
+		log(nullptr), log_mutexes(64), io(io_backend::stream), name_index_enabled(false), name_index_deferred(false), save_retention(1), loaded_generation(0),
+		lazy_number_of_blocks(0), lazy_remaining(0), lazy_stop(false),
+		Hasher(L_ex, L_in, plan)
 	{
 		if (L_ex + L_in != 10 || L_ex < 1 || L_ex > 9) // размеры вектора и ассоциативного массива должны быть согласованы
 			throw std::invalid_argument("DataBase: the sum of the parameters L_ex and L_in should be equal to 10");
+
+		// пустые сегменты еще не сохранены ни в одной контрольной точке
+		for (auto& d : dirty)
+			d = true;
 	}
-	catch (std::bad_alloc) {
+	catch (std::bad_alloc&) {
 		// Ошибка выделения памяти. Исключение должно быть обработано кодом более высокого уровня.
 		throw;
 	}
 
+	template<typename Key, typename T>
+	data<Key, T>::~data()
+	{
+		// остановка фонового потока ленивой загрузки
+		lazy_stop = true;
+		if (lazy_thread.joinable())
+			lazy_thread.join();
+	}
+
 	// Генерация базы данных.
 	template<typename Key, typename T>
-	std::pair<unsigned long, unsigned long long> data<Key, T>::Generate(int num_records, int num_threads, int wait_time,
-	 	const std::string& last_name_male_file,  const std::string& last_name_female_file,
-		const std::string& first_name_male_file, const std::string& first_name_female_file,
-		const std::string& patronymic_male_file, const std::string& patronymic_female_file)
+	std::pair<unsigned long, unsigned long long> data<Key, T>::Generate(int num_records, int num_threads, const name_lists& names,
+		int wait_time, uint64_t seed, const generation_profile& profile)
 	{
+		// Модель генерации (таблицы выбора имен и количество записей сегментов) строится до блокировки базы данных.
+		// Количество записей каждого сегмента и последовательность случайных чисел сегмента определяются
+		// только моделью генерации, seed и номером сегмента, поэтому потоки получают произвольные диапазоны сегментов.
+		const generation_model model(names, profile, (unsigned long long)num_records, number_of_first_digits, number_of_second_digits);
+		const unsigned int number_of_buckets = model.number_of_buckets();
+
 		// База данных отсутствует в памяти. Любые операции чтения, сохранения и модификации
 		// во время создания записей не имеют смысла.
 		// База данных блокируется для доступа со стороны других потоков до полного завершения операции генерирования.
@@ -37,61 +64,25 @@ namespace DataBase {
 		// и не произвелась ее очистка в течении времени ожидания
 		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return Empty(); }) == false)
 			throw SequenceError("The database has already been generated.");
-				
-		// Чтение имен, фамилий и отчеств из баз данных "first_name.csv", "last_name.csv", "patronymic.csv".
-		// Объем этих файлов на диске имеет относительно небольшой размер, 
-		// поэтому считываем эти данные в память. Так как к данным потребуется большое
-		// количество обращений на чтение произвольного элемента, то данные помещаем в вектор.
-		names_vector v_last_name_male;
-		names_vector v_last_name_female;
-		names_vector v_first_name_male;
-		names_vector v_first_name_female;
-		names_vector v_patronymic_male;
-		names_vector v_patronymic_female;
-
-		v_last_name_male   = read_name_file(last_name_male_file);
-		v_last_name_female = read_name_file(last_name_female_file);
-
-		v_first_name_male   = read_name_file(first_name_male_file);
-		v_first_name_female = read_name_file(first_name_female_file);
-		
-		v_patronymic_male   = read_name_file(patronymic_male_file);
-		v_patronymic_female = read_name_file(patronymic_female_file);
+
+		// индекс имен строится после генерации всех записей
+		deferred_name_index deferred(*this, (unsigned int)num_threads);
 
 		// Массив будущих результатов используется для фиксации исключений.
 		std::vector<std::future<void> > futures(num_threads - 1);
 
-		unsigned int block_size = static_cast<unsigned int>(pow(10, number_of_first_digits) / num_threads); // определение количества блоков, обрабатываемого в одном потоке.
-		unsigned long count = num_records / num_threads; // число записей, генерируемых в одном потоке.
-		if (block_size == 0) // если количество блоков меньше числа потоков, избыточные потоки не запускаются
-			block_size = num_threads - 1;
-
-		// начальный и конечный индексы массивов, в которых осуществляется однопоточная генерация
-		unsigned int block_begin = 0;
-		unsigned int block_end   = 0;
-
 		// генерация num_records записей типа record в num_threads потоках
-		// и размещение их в памяти в массивах activ_users и inactiv_users.
+		// и размещение их в памяти в массивах activ_users и inactiv_users;
+		// диапазоны сегментов потоков содержат примерно равное количество записей модели.
+		std::vector<unsigned int> bounds = SplitBuckets(number_of_buckets, (unsigned int)num_threads,
+			[&](unsigned int bucket) { return model.records_in_bucket(bucket); });
 		for (int i = 0; i < (num_threads - 1); ++i) {
-			block_end += block_size;
-			futures[i] = std::async(std::launch::async, &data::GenerateOneThread, this, 
-						count, block_begin, block_end,
-						std::ref(v_last_name_male),  std::ref(v_last_name_female),
-						std::ref(v_first_name_male), std::ref(v_first_name_female),
-						std::ref(v_patronymic_male), std::ref(v_patronymic_female));
-			block_begin = block_end;
+			futures[i] = std::async(std::launch::async, &data::GenerateOneThread, this,
+						bounds[i], bounds[i + 1], std::cref(model), seed);
 		}
 
-		unsigned int d = (num_records - static_cast<unsigned int>(num_records/num_threads)*num_threads);
-
-		// генерация оставшихся записей в главном потоке
-		data::GenerateOneThread(count + d, block_begin, (unsigned int)pow(10, number_of_first_digits),
-			std::ref(v_last_name_male),
-			std::ref(v_last_name_female),
-			std::ref(v_first_name_male),
-			std::ref(v_first_name_female),
-			std::ref(v_patronymic_male),
-			std::ref(v_patronymic_female));
+		// генерация последнего диапазона в главном потоке
+		data::GenerateOneThread(bounds[num_threads - 1], number_of_buckets, model, seed);
 
 		// ожидание завершения работы потоков.
 		// возникшие исключения сохраняются в массиве futures[i].
@@ -101,6 +92,7 @@ namespace DataBase {
 		}
 
 		// генерация базы данных завершена
+		deferred.rebuild();
 
 		unsigned long count_records    = number_of_records.load();
 		unsigned long long count_bytes = number_of_bytes.load();
@@ -137,13 +129,36 @@ namespace DataBase {
 		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return count_of_write_operations == 0; }) == false)
 			throw WaitTimeError("Timeout exceeded. Write operations in progress.");
 
+		// снимок ленивой загрузки должен быть загружен полностью
+		MaterializeAll();
+
+		unsigned long count = SaveFiles(num_threads, file_name);
+
+		// все записи журнала отражены в сохраненном снимке
+		if (log)
+			log->checkpoint(file_name, num_threads);
+
+		// сохранение базы данных завершено;
+		// уведомление ожидающим потокам
+		lock.unlock();
+		data_cond.notify_one();
+
+		return count;
+	}
+
+	// Запись базы данных в файлы file_name с номерами 0..num_threads-1 (в каждом файле - свой диапазон сегментов)
+	template<typename Key, typename T>
+	unsigned long data<Key, T>::SaveFiles(const unsigned int num_threads, const std::string file_name)
+	{
 		// Массив будущих результатов используется для передачи количества сохраненых элементов в основной поток и фиксации исключений.
 		std::vector<std::future<unsigned long> > futures(num_threads - 1);
 
-		unsigned int block_size = static_cast<unsigned int>(pow(10, number_of_first_digits) / num_threads); // определение количества блоков, обрабатываемого в одном потоке.
-		
-		if (block_size == 0) // если количество блоков меньше числа потоков, избыточные потоки не запускаются
-			block_size = num_threads - 1;
+		// описание файлов снимка для манифеста
+		std::vector<save_manifest::piece> pieces(num_threads);
+
+		// диапазоны сегментов файлов содержат примерно равное количество записей
+		std::vector<unsigned int> bounds = SplitBuckets((unsigned int)activ_users.size(), num_threads,
+			[&](unsigned int bucket) { return BucketRecords(bucket); });
 
 		// на каждом блоке ассоциативных массивов запускается однопоточная задача сохранения базы данных
 		unsigned int block_begin = 0;
@@ -151,32 +166,93 @@ namespace DataBase {
 		std::string file = file_name;
 		unsigned int i = 0;
 		for (; i < (num_threads - 1); ++i) {
-			block_end += block_size;
+			block_end = bounds[i + 1];
 			file.insert(file.size() - 4, std::to_string(i)); // добавление префикса к имени сохраняемого файла
+			pieces[i].file = file;
+			pieces[i].first_bucket = block_begin;
+			pieces[i].end_bucket = block_end;
 			futures[i] = std::async(std::launch::async, &data::SaveOneThread, this,
-				block_begin, block_end, file);
+				block_begin, block_end, save_temporary_name(file));
 			block_begin = block_end;
 			file = file_name;
 		}
 
 		file.insert(file.size() - 4, std::to_string(i)); // добавление префикса к имени сохраняемого файла
-		unsigned long count = data::SaveOneThread(block_begin, (unsigned int)pow(10, number_of_first_digits), file);
+		pieces[i].file = file;
+		pieces[i].first_bucket = block_begin;
+		pieces[i].end_bucket = (unsigned int)activ_users.size();
+		unsigned long count = 0;
+		try {
+			pieces[i].records = data::SaveOneThread(block_begin, pieces[i].end_bucket, save_temporary_name(file));
+			count = pieces[i].records;
+
+			// ожидание завершения работы потоков.
+			// возникшие исключения сохранены в массиве futures[i].
+			for (unsigned int i = 0; i < (num_threads - 1); ++i)
+			{
+				pieces[i].records = futures[i].get();
+				count += pieces[i].records;
+			}
+		}
+		catch (...) {
+			// прежний снимок не изменен, временные файлы удаляются
+			for (auto& f : futures)
+				if (f.valid())
+					f.wait();
+			boost::system::error_code ec;
+			for (auto& piece : pieces)
+				boost::filesystem::remove(save_temporary_name(piece.file), ec);
+			throw;
+		}
 
-		// ожидание завершения работы потоков.
-		// возникшие исключения сохранены в массиве futures[i].
-		for (unsigned int i = 0; i < (num_threads - 1); ++i)
-		{
-			count += futures[i].get();
+		// Манифест перечисляет файлы снимка, их размеры, количество записей и диапазоны сегментов;
+		// по нему Load распределяет загрузку по любому числу потоков. Имена файлов в манифесте - относительно его каталога.
+		save_manifest manifest;
+		manifest.number_of_buckets = (unsigned int)activ_users.size();
+		for (auto& piece : pieces) {
+			boost::system::error_code ec;
+			piece.bytes = boost::filesystem::file_size(save_temporary_name(piece.file), ec);
+			if (ec)
+				throw FileOpenError(save_temporary_name(piece.file));
+			piece.file = boost::filesystem::path(piece.file).filename().string();
 		}
+		manifest.pieces = std::move(pieces);
 
-		// сохранение базы данных завершено;
-		// уведомление ожидающим потокам
-		lock.unlock();
-		data_cond.notify_one();
+		// Записанные и сброшенные на диск временные файлы заменяют файлы прежнего снимка, который
+		// сохраняется в поколениях <файл>.1 .. <файл>.<save_retention>.
+		commit_save_snapshot(file_name, manifest, save_retention);
 
 		return count;
 	}
 
+	// Сохранение базы данных в дочернем процессе
+	template<typename Key, typename T>
+	forked_save_stats data<Key, T>::SaveForked(const unsigned int num_threads, const std::string file_name, int wait_time)
+	{
+		std::unique_ptr<forked_save> child;
+		{
+			// Монопольная блокировка удерживается только на время fork(): к этому моменту завершены все начатые
+			// операции с базой данных, поэтому ни один поток не удерживает блокировки сегментов, которые
+			// понадобятся дочернему процессу. Счетчики операций чтения/записи не используются - после fork()
+			// операции записи продолжаются, не влияя на копию базы данных в дочернем процессе.
+			std::unique_lock<boost::shared_mutex> lock(mutex);
+
+			if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return !( Empty()); }) == false)
+				throw SequenceError("The database is not in memory.");
+
+			// снимок ленивой загрузки должен быть загружен полностью: фоновый поток ленивой загрузки
+			// не должен изменять сегменты во время fork()
+			MaterializeAll();
+
+			child.reset(new forked_save([this, num_threads, file_name]() { return SaveFiles(num_threads, file_name); }));
+		}
+		data_cond.notify_one();
+
+		// Журнал не усекается: записи, добавленные после fork(), в сохраненные файлы не попали,
+		// поэтому контрольная точка журнала остается прежней.
+		return child->wait();
+	}
+
 	// Загрузка базы данных из файла
 	template<typename Key, typename T>
 	unsigned long data<Key, T>::Load(const unsigned int num_threads, const std::string file_name, int wait_time)
@@ -196,26 +272,69 @@ namespace DataBase {
 		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return count_of_read_operations == 0; }) == false)
 			throw WaitTimeError("Timeout exceeded. Write operations in progress.");
 
+		// индекс имен строится после загрузки всех записей
+		deferred_name_index deferred(*this, num_threads);
+
 		// Массив будущих результатов используется для фиксации исключений.
 		std::vector<std::future<unsigned long> > futures(num_threads - 1);
 
-		std::string file = file_name;
-		unsigned int i = 0;
-		for (; i < (num_threads - 1); ++i) {
-			file.insert(file.size() - 4, std::to_string(i)); // добавление префикса к имени сохраняемого файла
-			futures[i] = std::async(std::launch::async, &data::LoadOneThread, this, file);
-			file = file_name;
-		}
+		unsigned long count = 0;
+		try {
+			// снимок с манифестом загружается в любом числе потоков
+			save_manifest manifest;
+			loaded_generation = 0;
+			if (read_save_manifest(file_name, manifest)) {
+				try {
+					count = LoadPieces(num_threads, file_name, manifest);
+				}
+				catch (FileError&) {
+					// файлы снимка не совпадают с манифестом: загружается предыдущее поколение, если оно есть
+					if (!read_save_manifest(file_name, manifest, 1))
+						throw;
+					DiscardPartialLoad();
+					loaded_generation = 1;
+					count = LoadPieces(num_threads, file_name, manifest, 1);
+				}
+			}
+			else if (read_save_manifest(file_name, manifest, 1)) {
+				// сохранение прервано до записи манифеста: целым остается поколение 1
+				loaded_generation = 1;
+				count = LoadPieces(num_threads, file_name, manifest, 1);
+			}
+			else {
+				// снимок без манифеста: файлы <имя>0.csv .. <имя>{num_threads-1}.csv, по одному на поток
+				std::string file = file_name;
+				unsigned int i = 0;
+				for (; i < (num_threads - 1); ++i) {
+					file.insert(file.size() - 4, std::to_string(i)); // добавление префикса к имени сохраняемого файла
+					futures[i] = std::async(std::launch::async, &data::LoadOneThread, this, file, 0ULL, whole_file);
+					file = file_name;
+				}
 
-		file.insert(file.size() - 4, std::to_string(i)); // добавление префикса к имени сохраняемого файла
-		unsigned long count = data::LoadOneThread(file);
+				file.insert(file.size() - 4, std::to_string(i)); // добавление префикса к имени сохраняемого файла
+				count = data::LoadOneThread(file);
 
-		// ожидание завершения работы потоков.
-		// возникшие исключения сохраняются в массиве futures[i].
-		for (unsigned int i = 0; i < (num_threads - 1); ++i)
-		{
-			count += futures[i].get();
+				// ожидание завершения работы потоков.
+				// возникшие исключения сохраняются в массиве futures[i].
+				for (unsigned int i = 0; i < (num_threads - 1); ++i)
+				{
+					count += futures[i].get();
+				}
+			}
 		}
+		catch (...) {
+			// поврежденный или обрезанный файл не должен оставлять в памяти часть базы данных
+			for (auto& f : futures)
+				if (f.valid())
+					f.wait();
+			DiscardPartialLoad();
+			throw;
+		}
+		deferred.rebuild();
+
+		// загруженный снимок становится новой контрольной точкой журнала
+		if (log)
+			log->checkpoint(file_name, num_threads);
 
 		// Загрузка базы данных из файла завершена, посылается уведомление ожидающим потокам.
 		lock.unlock();
@@ -224,6 +343,688 @@ namespace DataBase {
 		return count;
 	}
 		
+	// Загрузка снимка по манифесту в num_threads потоках
+	template<typename Key, typename T>
+	unsigned long data<Key, T>::LoadPieces(const unsigned int num_threads, const std::string file_name, const save_manifest& manifest,
+		unsigned int generation)
+	{
+		// размеры файлов сверяются с манифестом до загрузки: снимок, перезаписанный не полностью, не загружается
+		boost::filesystem::path dir = boost::filesystem::path(file_name).parent_path();
+		std::vector<std::string> files;
+		unsigned long long total_bytes = 0;
+		for (auto& piece : manifest.pieces) {
+			files.push_back(save_generation_name((dir / piece.file).string(), generation));
+			boost::system::error_code ec;
+			auto size = boost::filesystem::file_size(files.back(), ec);
+			if (ec)
+				throw FileOpenError(files.back());
+			if (size != piece.bytes)
+				throw FileCorruptError(files.back(), "размер файла " + std::to_string(size)
+					+ " байт не совпадает с манифестом (" + std::to_string(piece.bytes) + " байт)");
+			total_bytes += piece.bytes;
+		}
+
+		// Задание - диапазон байтов одного файла. Если файлов меньше, чем потоков, файлы делятся на части
+		// пропорционально размеру (границы частей выравниваются по началу строки при разборе). Прямой ввод-вывод
+		// читает файлы только целиком.
+		struct load_task {
+			size_t piece;
+			unsigned long long begin, end;
+		};
+		std::vector<load_task> tasks;
+		for (size_t p = 0; p < manifest.pieces.size(); ++p) {
+			unsigned long long bytes = manifest.pieces[p].bytes;
+			unsigned long long parts = 1;
+			if (io == io_backend::stream && num_threads > manifest.pieces.size() && total_bytes > 0)
+				parts = std::max(1ULL, (bytes * num_threads + total_bytes - 1) / total_bytes);
+			for (unsigned long long k = 0; k < parts; ++k)
+				tasks.push_back(load_task{ p, bytes * k / parts, (k + 1 == parts) ? whole_file : bytes * (k + 1) / parts });
+		}
+
+		// потоки выбирают задания по очереди, поэтому различие размеров файлов не приводит к простою потоков
+		std::atomic<size_t> next_task(0);
+		std::atomic<bool> failed(false);
+		std::vector<std::atomic<unsigned long> > piece_records(manifest.pieces.size());
+		for (auto& records : piece_records)
+			records.store(0);
+
+		auto worker = [&]() -> unsigned long {
+			unsigned long count = 0;
+			try {
+				for (size_t i = next_task++; i < tasks.size() && !failed; i = next_task++) {
+					unsigned long records = LoadOneThread(files[tasks[i].piece], tasks[i].begin, tasks[i].end);
+					piece_records[tasks[i].piece] += records;
+					count += records;
+				}
+			}
+			catch (...) {
+				failed = true;
+				throw;
+			}
+			return count;
+		};
+
+		unsigned int number_of_workers = (unsigned int)std::min<size_t>(std::max(1u, num_threads), tasks.size());
+		std::vector<std::future<unsigned long> > futures;
+		for (unsigned int i = 1; i < number_of_workers; ++i)
+			futures.push_back(std::async(std::launch::async, worker));
+
+		unsigned long count = 0;
+		std::exception_ptr error;
+		try {
+			count = worker();
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+		for (auto& f : futures) {
+			try {
+				count += f.get();
+			}
+			catch (...) {
+				if (!error)
+					error = std::current_exception();
+			}
+		}
+		if (error)
+			std::rethrow_exception(error);
+
+		for (size_t p = 0; p < manifest.pieces.size(); ++p)
+			if (piece_records[p] != manifest.pieces[p].records)
+				throw FileCorruptError(files[p], "количество записей " + std::to_string(piece_records[p].load())
+					+ " не совпадает с манифестом (" + std::to_string(manifest.pieces[p].records) + ")");
+
+		return count;
+	}
+
+	// Сохранение базы данных в файл блочного формата
+	template<typename Key, typename T>
+	unsigned long data<Key, T>::SaveSnapshot(const unsigned int num_threads, const std::string file_name,
+		block_compression compression, int wait_time)
+	{
+		// синхронизация с другими операциями аналогична операции Save
+		boost::shared_lock<boost::shared_mutex> lock(mutex);
+
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return !( Empty()); }) == false) 
+			throw SequenceError("The database is not in memory.");
+
+		increase_count_of_operation inc(count_of_read_operations);
+
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return count_of_write_operations == 0; }) == false)
+			throw WaitTimeError("Timeout exceeded. Write operations in progress.");
+
+		// снимок ленивой загрузки должен быть загружен полностью
+		MaterializeAll();
+
+		snapshot_writer writer(file_name, number_of_first_digits, number_of_second_digits);
+		unsigned long count = WriteSnapshot(writer, num_threads, compression);
+		writer.close();
+		SetRecentSnapshot(file_name);
+
+		if (log)
+			log->checkpoint(file_name, num_threads);
+
+		lock.unlock();
+		data_cond.notify_one();
+
+		return count;
+	}
+
+	// Запись снимка базы данных блочного формата в поток
+	template<typename Key, typename T>
+	unsigned long data<Key, T>::ExportSnapshot(std::ostream& out, const unsigned int num_threads,
+		block_compression compression, int wait_time)
+	{
+		// синхронизация с другими операциями аналогична операции Save
+		boost::shared_lock<boost::shared_mutex> lock(mutex);
+
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return !( Empty()); }) == false) 
+			throw SequenceError("The database is not in memory.");
+
+		increase_count_of_operation inc(count_of_read_operations);
+
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return count_of_write_operations == 0; }) == false)
+			throw WaitTimeError("Timeout exceeded. Write operations in progress.");
+
+		MaterializeAll();
+
+		snapshot_writer writer(out, "<export>", number_of_first_digits, number_of_second_digits);
+		unsigned long count = WriteSnapshot(writer, num_threads, compression);
+		writer.close();
+
+		lock.unlock();
+		data_cond.notify_one();
+
+		return count;
+	}
+
+	// Формирование и запись блоков снимка (вызывается под блокировкой, исключающей операции записи)
+	template<typename Key, typename T>
+	unsigned long data<Key, T>::WriteSnapshot(snapshot_writer& writer, const unsigned int num_threads, block_compression compression)
+	{
+		const unsigned int number_of_buckets = (unsigned int)activ_users.size();
+		size_t number_of_blocks = (number_of_buckets + buckets_per_block - 1) / buckets_per_block;
+
+		std::atomic<unsigned long> count(0);
+		write_blocks_parallel(writer, number_of_blocks, num_threads, [&](size_t i, block_header& header, std::string& stored) {
+			unsigned int first_bucket = (unsigned int)i * buckets_per_block;
+			BuildBlock(first_bucket, std::min(first_bucket + buckets_per_block, number_of_buckets), compression, header, stored);
+			count += header.records;
+		});
+		return count.load();
+	}
+
+	template<typename Key, typename T>
+	void data<Key, T>::SetRecentSnapshot(const std::string& file_name)
+	{
+		std::lock_guard<std::mutex> guard(recent_snapshot_mutex);
+		boost::system::error_code ec;
+		recent_snapshot_size = boost::filesystem::file_size(file_name, ec);
+		recent_snapshot_time = boost::filesystem::last_write_time(file_name, ec);
+		recent_snapshot = ec ? std::string() : file_name;
+		recent_snapshot_modifications = modifications.load();
+	}
+
+	template<typename Key, typename T>
+	std::string data<Key, T>::RecentSnapshot() const
+	{
+		std::lock_guard<std::mutex> guard(recent_snapshot_mutex);
+		if (recent_snapshot.empty() || recent_snapshot_modifications != modifications.load())
+			return std::string();
+
+		// файл мог быть перезаписан или удален вне сервера
+		boost::system::error_code ec;
+		uintmax_t size = boost::filesystem::file_size(recent_snapshot, ec);
+		if (ec || size != recent_snapshot_size)
+			return std::string();
+		std::time_t time = boost::filesystem::last_write_time(recent_snapshot, ec);
+		if (ec || time != recent_snapshot_time)
+			return std::string();
+		return recent_snapshot;
+	}
+
+	// Загрузка базы данных из файла блочного формата
+	template<typename Key, typename T>
+	unsigned long data<Key, T>::LoadSnapshot(const unsigned int num_threads, const std::string file_name, int wait_time)
+	{
+		// синхронизация с другими операциями аналогична операции Load
+		std::unique_lock<boost::shared_mutex> lock(mutex);
+
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return Empty(); }) == false)
+			throw SequenceError("The database is already in memory. The database must be out of memory before loading.");
+
+		increase_count_of_operation inc(count_of_write_operations);
+
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return count_of_read_operations == 0; }) == false)
+			throw WaitTimeError("Timeout exceeded. Write operations in progress.");
+
+		snapshot_header header = read_snapshot_header(file_name);
+		if (header.number_of_first_digits != (uint32_t)number_of_first_digits || header.number_of_second_digits != (uint32_t)number_of_second_digits)
+			throw std::invalid_argument("DataBase: the snapshot " + file_name + " was saved with a different number of buckets.");
+
+		deferred_name_index deferred(*this, num_threads);
+
+		const uint32_t version = header.version;
+		std::atomic<unsigned long> count(0);
+		try {
+			read_blocks_parallel(file_name, num_threads, [&](const block_header& header, const std::string& raw) {
+				count += LoadBlock(version, header, raw);
+			});
+		}
+		catch (...) {
+			// блоки, загруженные до обнаружения поврежденного блока, удаляются
+			DiscardPartialLoad();
+			throw;
+		}
+		deferred.rebuild();
+		SetRecentSnapshot(file_name);
+
+		if (log)
+			log->checkpoint(file_name, num_threads);
+
+		lock.unlock();
+		data_cond.notify_one();
+
+		return count.load();
+	}
+
+	// Ленивая загрузка базы данных из файла блочного формата
+	template<typename Key, typename T>
+	unsigned long data<Key, T>::LoadLazy(const std::string file_name, int wait_time)
+	{
+		// синхронизация с другими операциями аналогична операции Load
+		std::unique_lock<boost::shared_mutex> lock(mutex);
+
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return Empty(); }) == false)
+			throw SequenceError("The database is already in memory. The database must be out of memory before loading.");
+
+		increase_count_of_operation inc(count_of_write_operations);
+
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return count_of_read_operations == 0; }) == false)
+			throw WaitTimeError("Timeout exceeded. Write operations in progress.");
+
+		// фоновый поток предыдущей ленивой загрузки уже загрузил все блоки
+		if (lazy_thread.joinable())
+			lazy_thread.join();
+
+		std::unique_ptr<snapshot_mapping> mapping(new snapshot_mapping(file_name));
+		const snapshot_header& header = mapping->header();
+		if (header.number_of_first_digits != (uint32_t)number_of_first_digits || header.number_of_second_digits != (uint32_t)number_of_second_digits)
+			throw std::invalid_argument("DataBase: the snapshot " + file_name + " was saved with a different number of buckets.");
+
+		// соответствие сегментов блокам снимка
+		const std::vector<block_location>& blocks = mapping->blocks();
+		std::vector<int> block_of_bucket(activ_users.size(), -1);
+		unsigned long count = 0;
+		for (size_t i = 0; i < blocks.size(); ++i) {
+			if (blocks[i].header.end_bucket > activ_users.size())
+				throw std::runtime_error("Snapshot: the block index is out of range.");
+			for (unsigned int bucket = blocks[i].header.first_bucket; bucket != blocks[i].header.end_bucket; ++bucket)
+				block_of_bucket[bucket] = (int)i;
+			count += blocks[i].header.records;
+		}
+
+		lazy_block_of_bucket.swap(block_of_bucket);
+		lazy_once.reset(new std::once_flag[blocks.size()]);
+		lazy_number_of_blocks = blocks.size();
+		lazy_snapshot = std::move(mapping);
+		lazy_stop = false;
+		lazy_remaining = lazy_number_of_blocks;
+		if (lazy_number_of_blocks)
+			lazy_thread = std::thread(&data::LazyWarmUp, this);
+
+		if (log)
+			log->checkpoint(file_name, 1);
+
+		lock.unlock();
+		data_cond.notify_one();
+
+		return count;
+	}
+
+	// Загрузка всех незагруженных блоков ленивой загрузки
+	template<typename Key, typename T>
+	void data<Key, T>::MaterializeAll()
+	{
+		for (size_t i = 0; i < lazy_number_of_blocks && lazy_remaining.load(); ++i)
+			MaterializeBlock(i);
+	}
+
+	// Загрузка блока, содержащего сегмент bucket
+	template<typename Key, typename T>
+	void data<Key, T>::MaterializeBucket(unsigned int bucket)
+	{
+		if (lazy_remaining.load() == 0)
+			return;
+		int block = lazy_block_of_bucket[bucket];
+		if (block >= 0)
+			MaterializeBlock(block);
+	}
+
+	// Однократная загрузка блока ленивой загрузки. Одновременные обращения к загружаемому блоку
+	// ожидают завершения его загрузки; при ошибке блок остается незагруженным и загружается при следующем обращении.
+	template<typename Key, typename T>
+	void data<Key, T>::MaterializeBlock(size_t i)
+	{
+		std::call_once(lazy_once[i], [&] {
+			std::string raw;
+			lazy_snapshot->read_block(i, raw);
+			LoadBlock(lazy_snapshot->header().version, lazy_snapshot->blocks()[i].header, raw);
+
+			// все блоки загружены - отображение файла больше не нужно
+			if (--lazy_remaining == 0)
+				lazy_snapshot.reset();
+		});
+	}
+
+	// Прекращение ленивой загрузки без загрузки оставшихся блоков (вызывается под монопольной блокировкой)
+	template<typename Key, typename T>
+	void data<Key, T>::StopLazyLoad()
+	{
+		lazy_stop = true;
+		if (lazy_thread.joinable())
+			lazy_thread.join();
+		lazy_remaining = 0;
+		lazy_snapshot.reset();
+	}
+
+	// Фоновая загрузка блоков ленивой загрузки по порядку
+	template<typename Key, typename T>
+	void data<Key, T>::LazyWarmUp()
+	{
+		for (size_t i = 0; i < lazy_number_of_blocks && !lazy_stop && lazy_remaining.load(); ++i) {
+			try {
+				MaterializeBlock(i);
+			}
+			catch (...) {
+				// ошибка будет сообщена запросу, обратившемуся к сегменту этого блока
+			}
+		}
+		data_cond.notify_all();
+	}
+
+	// Инкрементальное сохранение базы данных в каталог
+	template<typename Key, typename T>
+	std::pair<unsigned long, unsigned long> data<Key, T>::SaveIncremental(const unsigned int num_threads, const std::string dir_name, int wait_time)
+	{
+		// Синхронизация с другими операциями аналогична операции Save: доступ на чтение не блокируется,
+		// запуск новых операций записи откладывается до завершения сохранения.
+		boost::shared_lock<boost::shared_mutex> lock(mutex);
+
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return !( Empty()); }) == false) 
+			throw SequenceError("The database is not in memory.");
+
+		increase_count_of_operation inc(count_of_read_operations);
+
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return count_of_write_operations == 0; }) == false)
+			throw WaitTimeError("Timeout exceeded. Write operations in progress.");
+
+		// снимок ленивой загрузки должен быть загружен полностью
+		MaterializeAll();
+
+		boost::system::error_code ec;
+		boost::filesystem::create_directories(dir_name, ec);
+		if (ec)
+			throw FileOpenError(dir_name);
+
+		// Признаки изменения сегментов согласованы только с последней контрольной точкой в том же каталоге.
+		// В остальных случаях (новый каталог, каталог изменен другим процессом) сохраняются все сегменты.
+		const unsigned int number_of_buckets = (unsigned int)activ_users.size();
+		incremental_manifest manifest;
+		bool full = !read_incremental_manifest(dir_name, manifest) || manifest.number_of_buckets != number_of_buckets
+			|| dir_name != checkpoint_dir || manifest.version != checkpoint_version;
+		if (full) {
+			manifest = incremental_manifest();
+			manifest.number_of_buckets = number_of_buckets;
+		}
+		unsigned long version = manifest.version + 1;
+
+		// список перезаписываемых сегментов; признаки изменения сбрасываются (операции записи заблокированы)
+		std::vector<unsigned int> buckets;
+		for (unsigned int i = 0; i < number_of_buckets; ++i) {
+			if (dirty[i].exchange(false) || full)
+				buckets.push_back(i);
+		}
+
+		std::vector<unsigned long> counts(buckets.size(), 0);
+		try {
+			// сегменты распределяются между потоками частями с примерно равным количеством записей
+			std::vector<std::future<void> > futures(num_threads - 1);
+			std::vector<unsigned int> bounds = SplitBuckets((unsigned int)buckets.size(), num_threads,
+				[&](unsigned int i) { return BucketRecords(buckets[i]); });
+			for (unsigned int i = 0; i < (num_threads - 1); ++i) {
+				futures[i] = std::async(std::launch::async, &data::SaveBucketsOneThread, this,
+					std::cref(buckets), (size_t)bounds[i], (size_t)bounds[i + 1], std::cref(dir_name), version, std::ref(counts));
+			}
+			data::SaveBucketsOneThread(buckets, bounds[num_threads - 1], buckets.size(), dir_name, version, counts);
+
+			for (unsigned int i = 0; i < (num_threads - 1); ++i)
+				futures[i].get();
+
+			// файлы сегментов созданы и сброшены на диск; фиксация их имен в каталоге
+			sync_directory(dir_name);
+
+			// обновление манифеста: пустые сегменты из него исключаются
+			unsigned long count = 0;
+			for (size_t i = 0; i < buckets.size(); ++i) {
+				if (counts[i] != 0) {
+					manifest.buckets[buckets[i]].version = version;
+					manifest.buckets[buckets[i]].records = counts[i];
+					count += counts[i];
+				}
+				else
+					manifest.buckets.erase(buckets[i]);
+			}
+			manifest.version = version;
+			write_incremental_manifest(dir_name, manifest);
+
+			checkpoint_dir = dir_name;
+			checkpoint_version = version;
+
+			// предыдущие версии перезаписанных сегментов больше не нужны
+			remove_obsolete_bucket_files(dir_name, manifest);
+
+			if (log)
+				log->checkpoint(dir_name, num_threads);
+
+			lock.unlock();
+			data_cond.notify_one();
+
+			return std::make_pair((unsigned long)buckets.size(), count);
+		}
+		catch (...) {
+			// контрольная точка не создана - сегменты остаются измененными
+			for (unsigned int bucket : buckets)
+				dirty[bucket] = true;
+			throw;
+		}
+	}
+
+	// Загрузка базы данных из каталога инкрементальных контрольных точек
+	template<typename Key, typename T>
+	unsigned long data<Key, T>::LoadIncremental(const unsigned int num_threads, const std::string dir_name, int wait_time)
+	{
+		// синхронизация с другими операциями аналогична операции Load
+		std::unique_lock<boost::shared_mutex> lock(mutex);
+
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return Empty(); }) == false)
+			throw SequenceError("The database is already in memory. The database must be out of memory before loading.");
+
+		increase_count_of_operation inc(count_of_write_operations);
+
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return count_of_read_operations == 0; }) == false)
+			throw WaitTimeError("Timeout exceeded. Write operations in progress.");
+
+		incremental_manifest manifest;
+		if (!read_incremental_manifest(dir_name, manifest))
+			throw FileOpenError(dir_name + "/MANIFEST");
+		if (manifest.number_of_buckets != activ_users.size() && manifest.number_of_buckets != (unsigned int)Hasher.number_of_domestic_buckets())
+			throw std::invalid_argument("DataBase: the snapshot " + dir_name + " was saved with a different number of buckets.");
+
+		// актуальная версия каждого сегмента
+		std::vector<std::string> files;
+		files.reserve(manifest.buckets.size());
+		for (auto& bucket : manifest.buckets)
+			files.push_back(bucket_file_name(dir_name, bucket.first, bucket.second.version));
+
+		deferred_name_index deferred(*this, num_threads);
+
+		std::vector<std::future<unsigned long> > futures(num_threads - 1);
+		size_t block_size = files.size() / num_threads;
+		size_t block_begin = 0;
+		for (unsigned int i = 0; i < (num_threads - 1); ++i) {
+			futures[i] = std::async(std::launch::async, &data::LoadFilesOneThread, this,
+				std::cref(files), block_begin, block_begin + block_size);
+			block_begin += block_size;
+		}
+		unsigned long count = data::LoadFilesOneThread(files, block_begin, files.size());
+
+		for (unsigned int i = 0; i < (num_threads - 1); ++i)
+			count += futures[i].get();
+		deferred.rebuild();
+
+		// содержимое памяти совпадает с загруженной контрольной точкой
+		for (auto& d : dirty)
+			d = false;
+		checkpoint_dir = dir_name;
+		checkpoint_version = manifest.version;
+
+		if (log)
+			log->checkpoint(dir_name, num_threads);
+
+		lock.unlock();
+		data_cond.notify_one();
+
+		return count;
+	}
+		
+	// Колоночная выгрузка базы данных для аналитики
+	template<typename Key, typename T>
+	unsigned long data<Key, T>::SaveColumnar(const unsigned int num_threads, const std::string dir_name, int wait_time)
+	{
+		// синхронизация с другими операциями аналогична операции Save
+		boost::shared_lock<boost::shared_mutex> lock(mutex);
+
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return !( Empty()); }) == false) 
+			throw SequenceError("The database is not in memory.");
+
+		increase_count_of_operation inc(count_of_read_operations);
+
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return count_of_write_operations == 0; }) == false)
+			throw WaitTimeError("Timeout exceeded. Write operations in progress.");
+
+		// снимок ленивой загрузки должен быть загружен полностью
+		MaterializeAll();
+
+		boost::system::error_code ec;
+		boost::filesystem::create_directories(dir_name, ec);
+		if (ec)
+			throw FileOpenError(dir_name);
+
+		// сегменты делятся на num_threads непрерывных диапазонов; строки выгрузки упорядочены так же,
+		// как записи блочного снимка: по сегментам, внутри сегмента - активные, затем неактивные абоненты
+		const unsigned int number_of_buckets = (unsigned int)activ_users.size();
+		const unsigned int number_of_ranges = std::max(1u, std::min(num_threads, number_of_buckets));
+		std::vector<unsigned int> range_begin(number_of_ranges + 1);
+		for (unsigned int r = 0; r <= number_of_ranges; ++r)
+			range_begin[r] = (unsigned int)((unsigned long long)number_of_buckets * r / number_of_ranges);
+
+		// выполнение task(r) для всех диапазонов; первый диапазон обрабатывается текущим потоком
+		auto for_each_range = [&](const std::function<void(unsigned int)>& task) {
+			std::vector<std::future<void> > futures(number_of_ranges - 1);
+			for (unsigned int r = 1; r < number_of_ranges; ++r)
+				futures[r - 1] = std::async(std::launch::async, task, r);
+			task(0);
+			for (auto& f : futures)
+				f.get();
+		};
+
+		// первый проход: количество строк и различные значения колонок с именами в каждом диапазоне
+		const int number_of_name_columns = 3;
+		std::vector<unsigned long> range_rows(number_of_ranges, 0);
+		std::vector<std::vector<std::unordered_set<std::string> > > range_names(number_of_ranges,
+			std::vector<std::unordered_set<std::string> >(number_of_name_columns));
+		for_each_range([&](unsigned int r) {
+			for (unsigned int index = range_begin[r]; index != range_begin[r + 1]; ++index) {
+				for (int n = 0; n < 2; ++n) {
+					const thread_safe_map<number_key, T>& map = (n == 0) ? activ_users[index] : inactiv_users[index];
+					for (auto it = map.begin(); it != map.end(); ++it) {
+						range_names[r][0].insert(it->second.get_last_name());
+						range_names[r][1].insert(it->second.get_first_name());
+						range_names[r][2].insert(it->second.get_patronymic());
+						++range_rows[r];
+					}
+				}
+			}
+		});
+
+		// упорядоченные словари и коды их строк
+		std::vector<std::vector<std::string> > dictionaries(number_of_name_columns);
+		std::vector<std::unordered_map<std::string, uint32_t> > codes(number_of_name_columns);
+		for (int c = 0; c < number_of_name_columns; ++c) {
+			std::unordered_set<std::string> names;
+			for (auto& range : range_names)
+				names.insert(range[c].begin(), range[c].end());
+			dictionaries[c].assign(names.begin(), names.end());
+			std::sort(dictionaries[c].begin(), dictionaries[c].end());
+			for (size_t i = 0; i < dictionaries[c].size(); ++i)
+				codes[c].emplace(dictionaries[c][i], (uint32_t)i);
+		}
+		range_names.clear();
+
+		// номер первой строки каждого диапазона
+		std::vector<uint64_t> range_first_row(number_of_ranges + 1, 0);
+		for (unsigned int r = 0; r < number_of_ranges; ++r)
+			range_first_row[r + 1] = range_first_row[r] + range_rows[r];
+		const uint64_t rows = range_first_row[number_of_ranges];
+
+		const char* name_columns[number_of_name_columns] = { "last_name", "first_name", "patronymic" };
+		column_writer numbers(dir_name, "number", column_type::uint64, sizeof(uint64_t), rows);
+		column_writer activity(dir_name, "activity", column_type::bitset, 0, rows);
+		std::vector<std::unique_ptr<column_writer> > names;
+		std::vector<uint32_t> widths;
+		for (int c = 0; c < number_of_name_columns; ++c) {
+			widths.push_back(dictionary_code_width(dictionaries[c].size()));
+			names.emplace_back(new column_writer(dir_name, name_columns[c], column_type::dictionary,
+				widths[c], rows, dictionaries[c].size()));
+		}
+
+		// биты активности соседних диапазонов могут попасть в одно слово
+		std::vector<std::atomic<uint64_t> > activity_words((size_t)((rows + 63) / 64));
+		for (auto& word : activity_words)
+			word.store(0, std::memory_order_relaxed);
+
+		// второй проход: значения колонок накапливаются в буферах и записываются в файлы по номерам строк
+		const uint64_t number_base = 8 * (uint64_t)pow(10, number_of_first_digits + number_of_second_digits);
+		const uint64_t bucket_scale = (uint64_t)pow(10, number_of_second_digits);
+		const unsigned int domestic_buckets = (unsigned int)Hasher.number_of_domestic_buckets();
+		const uint64_t international_number_flag = uint64_t(1) << 63;
+		const size_t chunk_rows = 1 << 16;
+		for_each_range([&](unsigned int r) {
+			std::vector<uint64_t> number_chunk;
+			std::vector<std::vector<char> > name_chunks(number_of_name_columns);
+			number_chunk.reserve(chunk_rows);
+			for (int c = 0; c < number_of_name_columns; ++c)
+				name_chunks[c].reserve(chunk_rows * widths[c]);
+
+			uint64_t row = range_first_row[r];   // номер строки, следующей за записанными в файлы
+			auto flush = [&]() {
+				numbers.write_values(row, number_chunk.data(), number_chunk.size());
+				for (int c = 0; c < number_of_name_columns; ++c) {
+					names[c]->write_values(row, name_chunks[c].data(), number_chunk.size());
+					name_chunks[c].clear();
+				}
+				row += number_chunk.size();
+				number_chunk.clear();
+			};
+
+			for (unsigned int index = range_begin[r]; index != range_begin[r + 1]; ++index) {
+				for (int n = 0; n < 2; ++n) {
+					const thread_safe_map<number_key, T>& map = (n == 0) ? activ_users[index] : inactiv_users[index];
+					for (auto it = map.begin(); it != map.end(); ++it) {
+						if (n == 0) {
+							uint64_t current = row + number_chunk.size();
+							activity_words[current / 64].fetch_or(uint64_t(1) << (current % 64), std::memory_order_relaxed);
+						}
+						// международный номер записывается значением цифр с установленным старшим битом
+						if (index < domestic_buckets)
+							number_chunk.push_back(number_base + index * bucket_scale + it->first);
+						else
+							number_chunk.push_back(international_number_flag | numbering_plan::digits_value(it->first));
+
+						const std::string* fields[number_of_name_columns] = {
+							&it->second.get_last_name(), &it->second.get_first_name(), &it->second.get_patronymic() };
+						for (int c = 0; c < number_of_name_columns; ++c) {
+							// код записывается младшими байтами вперед
+							uint32_t code = codes[c].find(*fields[c])->second;
+							for (uint32_t b = 0; b < widths[c]; ++b)
+								name_chunks[c].push_back((char)(code >> (8 * b)));
+						}
+
+						if (number_chunk.size() == chunk_rows)
+							flush();
+					}
+				}
+			}
+			flush();
+		});
+
+		std::vector<uint64_t> words(activity_words.size());
+		for (size_t i = 0; i < words.size(); ++i)
+			words[i] = activity_words[i].load(std::memory_order_relaxed);
+		activity.write_bitset(words);
+
+		numbers.close();
+		activity.close();
+		for (int c = 0; c < number_of_name_columns; ++c)
+			names[c]->close(dictionaries[c]);
+
+		lock.unlock();
+		data_cond.notify_one();
+
+		return (unsigned long)rows;
+	}
+
 	// Очистка базы данных
 	template<typename Key, typename T>
 	void data<Key, T>::Clear(unsigned int num_threads, int wait_time)
@@ -236,17 +1037,22 @@ namespace DataBase {
 		// ожидание данных в течении wait_time мс. при отсутствии данных в течении времени ожидания возвращение управления.
 		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return !(Empty()); }) == false)
 			throw SequenceError("The database is not in memory.");
+
+		// незагруженные блоки снимка ленивой загрузки больше не нужны: фоновый поток останавливается до очистки
+		StopLazyLoad();
 		
 		// Массив будущих результатов используется для фиксации исключений.
 		std::vector<std::future<void> > futures(num_threads - 1);
 
-		unsigned int block_size = static_cast<unsigned int>( pow(10, number_of_first_digits) / num_threads); // определение количества блоков, обрабатываемого в одном потоке.
+		// диапазоны сегментов потоков содержат примерно равное количество записей
+		std::vector<unsigned int> bounds = SplitBuckets((unsigned int)activ_users.size(), num_threads,
+			[&](unsigned int bucket) { return BucketRecords(bucket); });
 
 		unsigned int block_begin = 0;
 		unsigned int block_end = 0;
 
 		for (unsigned int i = 0; i < (num_threads - 1); ++i) {
-			block_end += block_size;
+			block_end = bounds[i + 1];
 
 			futures[i] = std::async(std::launch::async, &data::ClearOneThread, this,
 				block_begin, block_end);
@@ -255,7 +1061,7 @@ namespace DataBase {
 		}
 
 		// очищение оставшихся массивов
-		while (block_begin != pow(10, number_of_first_digits)) {
+		while (block_begin != activ_users.size()) {
 			activ_users[block_begin].clear();
 			inactiv_users[block_begin].clear();
 			++block_begin;
@@ -270,89 +1076,417 @@ namespace DataBase {
 
 		Set_number_of_records(0);
 		Set_number_of_bytes(0);
+		names_index.clear();
+
+		// все сегменты стали пустыми и отличаются от сохраненных
+		for (auto& d : dirty)
+			d = true;
+		++modifications;
+
+		if (log)
+			log->checkpoint("", 0);
 
 		// Очистка базы данных завершена, посылается уведомление ожидающим потокам.
 		lock.unlock();
 		data_cond.notify_one();
 	}
 
-	// Добавление записи в базу данных
+	// Добавление записи в базу данных
+	template<typename Key, typename T>
+	bool data<Key, T>::AddRecord(boost::string_view number, bool activity, T& rec, int wait_time) {
+
+		// Предполагается, что одному индексу соответствует только один абонент.
+		// В противном случае вместо контейнера map следовало бы выбрать std::multimap (или в map<> помещать list<record>).
+		// Также предполагается наличие абонента с одним номером только в одном из ассоциативном массиве: либо в activ_users, либо в inactiv_users.
+
+		// Запись добавляется в потокобезопасный массив, поэтому ее осуществление возможно из нескольких потоков без
+		// захвата мьютекса. Для синхронизации с блокирующими операциями доступа к базе данных (например, при ее генерации)
+		// используется блокировка boost::shared_lock<>. При этом возможны многопоточные операции добавления записи в базу данных AddRecord.
+		// Одновременный доступ со стороны читающих операций (таких как Save), которые также защищены блокировкой boost::shared_lock<> необходимо
+		// запретить, так как в процессе исполнения операции AddRecord могут нарушаться инварианты базы данных. Для этого 
+		// используются два счетчика операций записи/чтения count_of_write_operations и count_of_read_operations. При этом
+		// все операции записи (защищенные boost::shared_lock<>) не начинают свое выполнение до завершения всех
+		// операций чтения (также защищенных boost::shared_lock<>), и наоборот.
+
+		bool success;
+		unsigned long long lsn = 0; // номер записи в журнале
+		{
+			boost::shared_lock<boost::shared_mutex> lock(mutex);
+
+			// увеличение счетчика операций записи - блокируется запуск новых операций на чтение, защищенных
+			// блокировкой boost::shared_lock<> (например Save).
+			increase_count_of_operation inc(count_of_write_operations);
+
+			// Ожидание завершения операций чтения в базу данных (Save) в течении wait_time мс. 
+			if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return count_of_read_operations == 0; }) == false)
+				throw WaitTimeError("Timeout exceeded. Write operations in progress.");
+
+			number_index P = Hasher.hash(number);
+			MaterializeBucket(P.first);
+
+			// произведен захват внешней блокировки - возможно применении асинхронной функции AddRecord_no_block
+			if (log) {
+				// запись журнала добавляется до изменения базы данных: при отказе журнала (исключение
+				// FileWriteError) база данных остается неизменной
+				std::lock_guard<std::mutex> log_lock(log_mutexes[P.first % log_mutexes.size()]);
+				lsn = log->append_add(number, activity, rec.get_last_name(), rec.get_first_name(), rec.get_patronymic());
+				success = AddRecord_no_block(P.first, P.second, activity, rec);
+			}
+			else
+				success = AddRecord_no_block(P.first, P.second, activity, rec);
+
+			// операция добавления завершена, уменьшении счетчика записывающих операций
+			// и уведомление ожидающих потоков.
+			lock.unlock();
+			data_cond.notify_one();
+		}
+
+		// ожидание сброса записи журнала на диск (group commit) выполняется вне блокировки базы данных
+		if (log)
+			log->wait(lsn);
+
+		return success;
+	}
+
+	// Разбор пакета строк импорта и распределение строк по частям
+	template<typename Key, typename T>
+	void data<Key, T>::SplitImportRows(const char* text, size_t size, const std::string& source, unsigned long first_line,
+		std::vector<std::vector<import_row> >& parts) const
+	{
+		// Строки читаются группами по hash_batch_size, номера группы преобразуются в индексы одним вызовом
+		// Hasher.hash. Строки группы, предшествующие ошибке формата, распределяются до сообщения об ошибке.
+		subscriber_csv_reader in(text, size, source, first_line);
+		subscriber_row rows[hash_batch_size];
+		boost::string_view numbers[hash_batch_size];
+		unsigned long lines[hash_batch_size];
+		number_index indices[hash_batch_size];
+		size_t n;
+		do {
+			std::exception_ptr format_error;
+			try {
+				for (n = 0; n < hash_batch_size && in.next(rows[n]); ++n) {
+					numbers[n] = rows[n].number;
+					lines[n] = first_line + in.line_number() - 1;
+				}
+			}
+			catch (...) {
+				format_error = std::current_exception();
+			}
+
+			size_t valid = Hasher.hash(numbers, n, indices);
+			for (size_t i = 0; i < valid; ++i)
+				parts[indices[i].first % parts.size()].push_back(import_row{ rows[i], indices[i] });
+
+			if (valid != n)
+				throw FileCorruptError(source, "строка " + std::to_string(lines[valid])
+					+ ", недопустимый номер телефона " + numbers[valid].to_string());
+			if (format_error)
+				std::rethrow_exception(format_error);
+		} while (n == hash_batch_size);
+	}
+
+	// Добавление пакета записей в базу данных
+	template<typename Key, typename T>
+	std::pair<unsigned long, unsigned long> data<Key, T>::ImportRows(const std::vector<import_row>& rows, int wait_time)
+	{
+		unsigned long added = 0, replaced = 0;
+		unsigned long long lsn = 0; // номер последней записи пакета в журнале
+		try {
+			// синхронизация с другими операциями аналогична операции AddRecord
+			boost::shared_lock<boost::shared_mutex> lock(mutex);
+
+			increase_count_of_operation inc(count_of_write_operations);
+
+			if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return count_of_read_operations == 0; }) == false)
+				throw WaitTimeError("Timeout exceeded. Write operations in progress.");
+
+			for (const import_row& item : rows) {
+				const subscriber_row& row = item.row;
+				number_index P = item.index;
+				MaterializeBucket(P.first);
+
+				T rec(row.last_name.to_string(), row.first_name.to_string(), row.patronymic.to_string());
+				bool success;
+				if (log) {
+					std::lock_guard<std::mutex> log_lock(log_mutexes[P.first % log_mutexes.size()]);
+					lsn = log->append_add(row.number, row.activity, rec.get_last_name(), rec.get_first_name(), rec.get_patronymic());
+					success = AddRecord_no_block(P.first, P.second, row.activity, rec);
+				}
+				else
+					success = AddRecord_no_block(P.first, P.second, row.activity, rec);
+
+				if (success)
+					++added;
+				else
+					++replaced;
+			}
+
+			lock.unlock();
+			data_cond.notify_one();
+		}
+		catch (...) {
+			// записи пакета до ошибки уже применены и должны быть сохранены в журнале
+			if (log && lsn)
+				log->wait(lsn);
+			throw;
+		}
+
+		// ожидание сброса записей журнала на диск выполняется вне блокировки базы данных
+		if (log && lsn)
+			log->wait(lsn);
+
+		return std::make_pair(added, replaced);
+	}
+
+	// Удаление записи из базы данных
+	template<typename Key, typename T>
+	bool data<Key, T>::DeleteRecord(boost::string_view number, int wait_time) {
+				
+		bool success;
+		unsigned long long lsn = 0; // номер записи в журнале
+		{
+			boost::shared_lock<boost::shared_mutex> lock(mutex);
+
+			// увеличение счетчика операций записи - блокируется запуск новых операций на чтение, защищенных
+			// блокировкой boost::shared_lock<> (например Save).
+			increase_count_of_operation inc(count_of_write_operations);
+
+			// Ожидание завершения операций чтения в базу данных (например Save) в течении wait_time мс. 
+			if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return count_of_read_operations == 0; }) == false)
+				throw WaitTimeError("Timeout exceeded. Write operations in progress.");
+
+			// преобразование строкового представления номера в два целых числа
+			number_index P = Hasher.hash(number);
+			MaterializeBucket(P.first);
+
+			// произведен захват внешней блокировки - возможно применении асинхронной функции AddRecord_no_block
+			if (log) {
+				std::lock_guard<std::mutex> log_lock(log_mutexes[P.first % log_mutexes.size()]);
+				// в журнал записываются только фактически выполняемые удаления; запись журнала добавляется
+				// до удаления, чтобы при отказе журнала база данных осталась неизменной
+				if (activ_users[P.first].contains(P.second) || inactiv_users[P.first].contains(P.second)) {
+					lsn = log->append_delete(number);
+					success = DeleteRecord_no_block(P.first, P.second);
+				}
+			}
+			else
+				success = DeleteRecord_no_block(P.first, P.second);
+
+			// операция добавления завершена, уменьшении счетчика записывающих операций
+			// и уведомление ожидающих потоков.
+			lock.unlock();
+			data_cond.notify_one();
+		}
+
+		// ожидание сброса записи журнала на диск выполняется вне блокировки базы данных
+		if (log && lsn)
+			log->wait(lsn);
+
+		return success;
+	}
+
+	// Поиск записи в базе данных по телефонному номеру
+	template<typename Key, typename T>
+	bool data<Key, T>::FindRecord(boost::string_view number, bool& activity, T& rec, const unsigned int wait_time) {
+				
+		boost::shared_lock<boost::shared_mutex> lock(mutex);
+
+		// Ожидание появления в течении wait_time мс записей в базе данных.
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return !(Empty()); }) == false)
+			throw SequenceError("The database is empty.");
+
+		// увеличение счетчика операций чтения - блокируется запуск новых операций на запись (например AddRecord).
+		increase_count_of_operation inc(count_of_read_operations);
+
+		// ожидание завершения операций записи, защищенных блокировкой boost::shared_lock<>.
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return count_of_write_operations == 0; }) == false)
+			throw WaitTimeError("Timeout exceeded. Write operations in progress.");
+
+		//преобразование номер абонента в два индекса first_number и second_number
+		number_index P = Hasher.hash(number);
+		int first_number = P.first;
+		number_key second_number = P.second;
+
+		// при ленивой загрузке блок с сегментом загружается при первом обращении к нему
+		MaterializeBucket(first_number);
+
+		// значение по умолчанию для возврата из функции поиска в случае отсутствия найденного значения
+		record default_value = { "", "", "" };
+		
+		// поиск элемента базы данных сначала в массиве с активными абонентами, затем в массиве с неактивными абонентами
+		if ((rec = (activ_users[first_number]).find(second_number, default_value)) != default_value) {
+			activity = true; // установка признака активности найденного абонента
+			return true;
+		}
+		else if ((rec = (inactiv_users[first_number]).find(second_number, default_value)) != default_value) {
+			activity = false; // установка признака активности найденного абонента
+			return true;
+		}
+		
+		// операция добавления завершена, уменьшении счетчика записывающих операций
+		// и уведомление ожидающих потоков.
+		lock.unlock();
+		data_cond.notify_one();
+
+		return false; // запись не найдена
+	}
+
+	// Пакетный поиск записей.
 	template<typename Key, typename T>
-	bool data<Key, T>::AddRecord(key_type& number, bool activity, T& rec, int wait_time) {
-
-		// Предполагается, что одному индексу соответствует только один абонент.
-		// В противном случае вместо контейнера map следовало бы выбрать std::multimap (или в map<> помещать list<record>).
-		// Также предполагается наличие абонента с одним номером только в одном из ассоциативном массиве: либо в activ_users, либо в inactiv_users.
-
-		// Запись добавляется в потокобезопасный массив, поэтому ее осуществление возможно из нескольких потоков без
-		// захвата мьютекса. Для синхронизации с блокирующими операциями доступа к базе данных (например, при ее генерации)
-		// используется блокировка boost::shared_lock<>. При этом возможны многопоточные операции добавления записи в базу данных AddRecord.
-		// Одновременный доступ со стороны читающих операций (таких как Save), которые также защищены блокировкой boost::shared_lock<> необходимо
-		// запретить, так как в процессе исполнения операции AddRecord могут нарушаться инварианты базы данных. Для этого 
-		// используются два счетчика операций записи/чтения count_of_write_operations и count_of_read_operations. При этом
-		// все операции записи (защищенные boost::shared_lock<>) не начинают свое выполнение до завершения всех
-		// операций чтения (также защищенных boost::shared_lock<>), и наоборот.
+	template<typename Visit>
+	void data<Key, T>::FindBatch(const boost::string_view* numbers, size_t count, Visit visit, const unsigned int wait_time)
+	{
+		// индексы номеров и позиции номеров в запросе; неверные номера сообщаются сразу.
+		// Преобразование и сортировка выполняются до захвата блокировки базы данных.
+		typedef std::pair<number_index, size_t> entry;
+		std::vector<entry> entries;
+		entries.reserve(count);
+		number_index indices[hash_batch_size];
+		for (size_t begin = 0; begin < count; ) {
+			size_t n = std::min(hash_batch_size, count - begin);
+			size_t valid = Hasher.hash(numbers + begin, n, indices);
+			for (size_t i = 0; i < valid; ++i)
+				entries.push_back(std::make_pair(indices[i], begin + i));
+			if (valid < n) {
+				visit(begin + valid, find_status::invalid_number, false, (const T*)nullptr);
+				++valid;
+			}
+			begin += valid;
+		}
+		std::sort(entries.begin(), entries.end());
 
 		boost::shared_lock<boost::shared_mutex> lock(mutex);
 
-		// увеличение счетчика операций записи - блокируется запуск новых операций на чтение, защищенных
-		// блокировкой boost::shared_lock<> (например Save).
-		increase_count_of_operation inc(count_of_write_operations);
+		// Ожидание появления в течении wait_time мс записей в базе данных.
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return !(Empty()); }) == false)
+			throw SequenceError("The database is empty.");
 
-		// Ожидание завершения операций чтения в базу данных (Save) в течении wait_time мс. 
-		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return count_of_read_operations == 0; }) == false)
-			throw WaitTimeError("Timeout exceeded. Write operations in progress.");
+		// увеличение счетчика операций чтения - блокируется запуск новых операций на запись (например AddRecord).
+		increase_count_of_operation inc(count_of_read_operations);
 
-		std::pair<int, int> P = Hasher.hash(number);
+		// ожидание завершения операций записи, защищенных блокировкой boost::shared_lock<>.
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return count_of_write_operations == 0; }) == false)
+			throw WaitTimeError("Timeout exceeded. Write operations in progress.");
 
-		// произведен захват внешней блокировки - возможно применении асинхронной функции AddRecord_no_block
-		bool success = AddRecord_no_block(P.first, P.second, activity, rec);
+		auto key_of = [](const entry& e) { return e.first.second; };
+		std::vector<entry> missing;
+		for (auto group = entries.begin(); group != entries.end(); ) {
+			const int bucket = group->first.first;
+			auto group_end = group;
+			while (group_end != entries.end() && group_end->first.first == bucket)
+				++group_end;
+
+			// при ленивой загрузке блок с сегментом загружается при первом обращении к нему
+			MaterializeBucket(bucket);
+
+			// поиск сначала среди активных абонентов сегмента, ненайденные номера - среди неактивных
+			missing.clear();
+			activ_users[bucket].find_sorted(group, group_end, key_of, [&](const entry& e, const T* rec) {
+				if (rec)
+					visit(e.second, find_status::found, true, rec);
+				else
+					missing.push_back(e);
+			});
+			inactiv_users[bucket].find_sorted(missing.begin(), missing.end(), key_of, [&](const entry& e, const T* rec) {
+				visit(e.second, rec ? find_status::found : find_status::not_found, false, rec);
+			});
+			group = group_end;
+		}
 
-		// операция добавления завершена, уменьшении счетчика записывающих операций
-		// и уведомление ожидающих потоков.
 		lock.unlock();
 		data_cond.notify_one();
-		return success;
 	}
 
-	// Удаление записи из базы данных
+	// Обход диапазона номеров.
 	template<typename Key, typename T>
-	bool data<Key, T>::DeleteRecord(key_type& number, int wait_time) {
-				
+	template<typename Visit>
+	bool data<Key, T>::FindRange(number_index& from, const number_index& to, activity_filter filter, size_t max_records,
+		Visit visit, const unsigned int wait_time)
+	{
+		// номера "8" + 10 цифр упорядочены по сегменту и ключу; международные номера распределены по сегментам
+		// нумерационного плана не по порядку, поэтому диапазоны для них не поддерживаются
+		if (from.first >= Hasher.number_of_domestic_buckets() || to.first >= Hasher.number_of_domestic_buckets())
+			throw std::invalid_argument("The range bounds must be set in the format '89993332211'.");
+
 		boost::shared_lock<boost::shared_mutex> lock(mutex);
 
-		// увеличение счетчика операций записи - блокируется запуск новых операций на чтение, защищенных
-		// блокировкой boost::shared_lock<> (например Save).
-		increase_count_of_operation inc(count_of_write_operations);
+		// Ожидание появления в течении wait_time мс записей в базе данных.
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return !(Empty()); }) == false)
+			throw SequenceError("The database is empty.");
 
-		// Ожидание завершения операций чтения в базу данных (например Save) в течении wait_time мс. 
-		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return count_of_read_operations == 0; }) == false)
-			throw WaitTimeError("Timeout exceeded. Write operations in progress.");
+		// увеличение счетчика операций чтения - блокируется запуск новых операций на запись (например AddRecord).
+		increase_count_of_operation inc(count_of_read_operations);
 
-		// преобразование строкового представления номера в два целых числа
-		std::pair<int, int> P = Hasher.hash(number);
+		// ожидание завершения операций записи, защищенных блокировкой boost::shared_lock<>.
+		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return count_of_write_operations == 0; }) == false)
+			throw WaitTimeError("Timeout exceeded. Write operations in progress.");
 
-		// произведен захват внешней блокировки - возможно применении асинхронной функции AddRecord_no_block
-		bool success = DeleteRecord_no_block(P.first, P.second);
+		size_t count = 0;
+		bool finished = true;
+		for (; from.first <= to.first; from = number_index(from.first + 1, 0)) {
+			const int bucket = from.first;
+			const number_key last = (bucket == to.first) ? to.second : ~(number_key)0;
+
+			// при ленивой загрузке блок с сегментом загружается при первом обращении к нему
+			MaterializeBucket(bucket);
+
+			// Массивы активных и неактивных абонентов упорядочены по ключу и не содержат общих ключей: записи сегмента
+			// выводятся слиянием, начиная с первого ключа не меньше from.second.
+			const thread_safe_map<number_key, T>& activ = activ_users[bucket];
+			const thread_safe_map<number_key, T>& inactiv = inactiv_users[bucket];
+			auto a = (filter != activity_filter::inactive) ? activ.lower_bound(from.second) : activ.end();
+			auto i = (filter != activity_filter::active) ? inactiv.lower_bound(from.second) : inactiv.end();
+			for (;;) {
+				bool use_a = (a != activ.end() && a->first <= last);
+				bool use_i = (i != inactiv.end() && i->first <= last);
+				if (!use_a && !use_i)
+					break;
+				if (use_a && use_i) {
+					use_a = a->first < i->first;
+					use_i = !use_a;
+				}
+				if (count == max_records) {
+					from.second = use_a ? a->first : i->first;
+					finished = false;
+					break;
+				}
+				if (use_a) {
+					visit(bucket, a->first, true, a->second);
+					++a;
+				}
+				else {
+					visit(bucket, i->first, false, i->second);
+					++i;
+				}
+				++count;
+			}
+			if (!finished)
+				break;
+		}
 
-		// операция добавления завершена, уменьшении счетчика записывающих операций
-		// и уведомление ожидающих потоков.
 		lock.unlock();
 		data_cond.notify_one();
-
-		return success;
+		return finished;
 	}
 
-	// Поиск записи в базе данных по телефонному номеру
+	// Поиск записей по имени.
 	template<typename Key, typename T>
-	bool data<Key, T>::FindRecord(const key_type& number, bool& activity, T& rec, const unsigned int wait_time) {
-				
+	template<typename Visit>
+	unsigned long data<Key, T>::FindByName(boost::string_view last_name, boost::string_view first_name, boost::string_view patronymic,
+		Visit visit, const unsigned int wait_time)
+	{
+		if (last_name.empty())
+			throw std::invalid_argument("The last name must be set.");
+
 		boost::shared_lock<boost::shared_mutex> lock(mutex);
 
 		// Ожидание появления в течении wait_time мс записей в базе данных.
 		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return !(Empty()); }) == false)
 			throw SequenceError("The database is empty.");
 
+		if (!name_index_enabled)
+			throw SequenceError("The name index is disabled.");
+
 		// увеличение счетчика операций чтения - блокируется запуск новых операций на запись (например AddRecord).
 		increase_count_of_operation inc(count_of_read_operations);
 
@@ -360,30 +1494,47 @@ namespace DataBase {
 		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return count_of_write_operations == 0; }) == false)
 			throw WaitTimeError("Timeout exceeded. Write operations in progress.");
 
-		//преобразование номер абонента в два индекса first_number и second_number
-		std::pair<int, int> P = Hasher.hash(number);
-		int first_number = P.first;
-		int second_number = P.second;
+		// записи снимка ленивой загрузки добавляются в индекс при загрузке их блоков; блоки с искомым именем
+		// неизвестны до их загрузки, поэтому загружаются все оставшиеся блоки
+		MaterializeAll();
 
-		// значение по умолчанию для возврата из функции поиска в случае отсутствия найденного значения
-		record default_value = { "", "", "" };
-		
-		// поиск элемента базы данных сначала в массиве с активными абонентами, затем в массиве с неактивными абонентами
-		if ((rec = (activ_users[first_number]).find(second_number, default_value)) != default_value) {
-			activity = true; // установка признака активности найденного абонента
-			return true;
-		}
-		else if ((rec = (inactiv_users[first_number]).find(second_number, default_value)) != default_value) {
-			activity = false; // установка признака активности найденного абонента
-			return true;
+		// по полному имени - список полного имени, иначе список фамилии с отбором записей по заданным частям имени
+		std::vector<uint64_t> ids = (!first_name.empty() && !patronymic.empty()) ?
+			names_index.find(last_name, first_name, patronymic) : names_index.find(last_name);
+
+		// Записи списка сверяются с искомым именем: ключи индекса - хэши имен, совпадающие и у различных имен.
+		auto matches = [&](const T& rec) {
+			return rec.get_last_name() == last_name &&
+				(first_name.empty() || rec.get_first_name() == first_name) &&
+				(patronymic.empty() || rec.get_patronymic() == patronymic);
+		};
+
+		unsigned long count = 0;
+		auto key_of = [](const number_key& key) { return key; };
+		for (uint64_t id : ids) {
+			number_index P = NameIndexNumber(id);
+			bool found = false;
+			activ_users[P.first].find_sorted(&P.second, &P.second + 1, key_of, [&](const number_key& key, const T* rec) {
+				if (!rec)
+					return;
+				found = true;
+				if (matches(*rec)) {
+					visit(P.first, key, true, *rec);
+					++count;
+				}
+			});
+			if (!found)
+				inactiv_users[P.first].find_sorted(&P.second, &P.second + 1, key_of, [&](const number_key& key, const T* rec) {
+					if (rec && matches(*rec)) {
+						visit(P.first, key, false, *rec);
+						++count;
+					}
+				});
 		}
-		
-		// операция добавления завершена, уменьшении счетчика записывающих операций
-		// и уведомление ожидающих потоков.
+
 		lock.unlock();
 		data_cond.notify_one();
-
-		return false; // запись не найдена
+		return count;
 	}
 
 	// Вывод N первых записей базы данных в консоль. (Вспомогательная отладочная функция)
@@ -406,6 +1557,9 @@ namespace DataBase {
 		if (data_cond.wait_for(lock, std::chrono::milliseconds(wait_time), [&] {return count_of_write_operations == 0; }) == false)
 			throw WaitTimeError("Timeout exceeded. Write operations in progress.");
 
+		// снимок ленивой загрузки должен быть загружен полностью
+		MaterializeAll();
+
 		int count = 0;
 		bool a = true; // признак активности абонента
 
@@ -426,11 +1580,11 @@ namespace DataBase {
 
 				while (it_in != it_in_end && num < N) {   // цикл по каждому ассоциативному массиву 
 					auto ind = std::distance(it_ex_beg, it_ex);       // расстояние между итераторами it_ex_beg и it_ex соответствует индексу текущего элемента, т.е. первой части телефонного номера
-					std::cout << "8" << int_to_string(ind, number_of_first_digits) <<
-						int_to_string(it_in->first, number_of_second_digits) << ", ";  // вывод номера телефона
-						std::cout << it_in->second.last_name << ", ";				   // вывод фамилии
-						std::cout << it_in->second.first_name << ", ";				   // вывод имени
-						std::cout << it_in->second.patronymic << ", ";				   // вывод отчества
+					char number[DefaultHash<std::string>::max_number_length];
+					std::cout.write(number, Hasher.unhash((int)ind, it_in->first, number) - number) << ", ";  // вывод номера телефона
+						std::cout << it_in->second.get_last_name() << ", ";			   // вывод фамилии
+						std::cout << it_in->second.get_first_name() << ", ";		   // вывод имени
+						std::cout << it_in->second.get_patronymic() << ", ";		   // вывод отчества
 						std::cout << a << std::endl;								   // вывод признака активности
 					++it_in;
 					++num;
@@ -459,16 +1613,29 @@ namespace DataBase {
 
 	// Вспомогательная функция добавления записи в базу данных без захвата блокировки.
 	template<typename Key, typename T>
-	bool data<Key, T>::AddRecord_no_block(const unsigned int& first_number, const unsigned int& second_number, const bool& activity, mapped_type& rec) {
+	bool data<Key, T>::AddRecord_no_block(const unsigned int& first_number, const number_key& second_number, const bool& activity, mapped_type& rec) {
 
 		unsigned int old_size = 0;  // размер старой записи, которая заменяется при добавлении новой записи
 		bool succes;
+
+		// при ведении индекса имен заменяемая запись сохраняется в old_rec для удаления ее имени из индекса
+		const bool index = name_index_enabled && !name_index_deferred;
+		T old_rec;
+		T* old_value = index ? &old_rec : nullptr;
+
+		// сегмент изменен и должен быть перезаписан следующей инкрементальной контрольной точкой;
+		// признак записывается, только если еще не установлен, чтобы потоки, изменяющие соседние сегменты,
+		// не передавали друг другу строку кэша (признаки сбрасываются при заблокированных операциях записи)
+		if (!dirty[first_number].load(std::memory_order_relaxed))
+			dirty[first_number] = true;
+		++modifications;
+
 		// Проверка на наличие абонента в обоих массивах.
 		// В случае отсутствия записи, соответствующей добавляемому номеру,
 		// добавляем запись в соответствующий ассоциативный массив.
 		// В противном случае производится замена старой записи новой и коррекция размера база данных.
 		if (activity) {
-			if (!(activ_users[first_number]).add_or_update(second_number, rec, old_size)) {
+			if (!(activ_users[first_number]).add_or_update(second_number, rec, old_size, old_value)) {
 				// запись уже присутствовала в ассоциативном массиве; после ее замены корректируем размер базы данных.
 				number_of_bytes += (rec.last_name_size() + rec.first_name_size() + rec.patronymic_size() - old_size);
 				succes = false;
@@ -476,7 +1643,7 @@ namespace DataBase {
 			else {
 				// при добавлении записи в массив с активными абонентами необходимо удалить запись,
 				// соответствующую заданному индексу, из массива с неактивными абонентами.
-				if ((inactiv_users[first_number]).erase(second_number, old_size)) {
+				if ((inactiv_users[first_number]).erase(second_number, old_size, old_value)) {
 					// добавляемая запись уже присутствовала в массиве с неактивными абонентами.
 					number_of_bytes += (rec.last_name_size() + rec.first_name_size() + rec.patronymic_size() - old_size);
 					succes = false;
@@ -490,12 +1657,12 @@ namespace DataBase {
 			}
 		}
 		else { // аналогично ветке для активных абонентов
-			if (!(inactiv_users[first_number]).add_or_update(second_number, rec, old_size)) {
+			if (!(inactiv_users[first_number]).add_or_update(second_number, rec, old_size, old_value)) {
 				number_of_bytes += (rec.last_name_size() + rec.first_name_size() + rec.patronymic_size() - old_size);
 				succes = false;
 			}
 			else {
-				if ((activ_users[first_number]).erase(second_number, old_size)) {
+				if ((activ_users[first_number]).erase(second_number, old_size, old_value)) {
 					number_of_bytes += (rec.last_name_size() + rec.first_name_size() + rec.patronymic_size() - old_size);
 					succes = false;
 				}
@@ -507,26 +1674,40 @@ namespace DataBase {
 				}
 			}
 		}
+
+		// имя замененной записи удаляется из индекса, если оно изменилось
+		if (index && (succes || old_rec != rec)) {
+			const uint64_t id = NameIndexId(first_number, second_number);
+			if (!succes)
+				names_index.remove(old_rec.get_last_name(), old_rec.get_first_name(), old_rec.get_patronymic(), id);
+			names_index.add(rec.get_last_name(), rec.get_first_name(), rec.get_patronymic(), id);
+		}
 		return succes;
 	}
 
 	// Вспомогательная функция удаления записи из базы данных без захвата блокировки.
 	template<typename Key, typename T>
-	bool data<Key, T>::DeleteRecord_no_block(int first_number, int second_number) {
+	bool data<Key, T>::DeleteRecord_no_block(int first_number, number_key second_number) {
 
 		unsigned int old_size = 0;  // размер удаляемой записи (если таковая существует)
+
+		// при ведении индекса имен удаляемая запись сохраняется в old_rec для удаления ее имени из индекса
+		const bool index = name_index_enabled && !name_index_deferred;
+		T old_rec;
+		T* old_value = index ? &old_rec : nullptr;
 	
 		// Удаление абонента из обоих массивов.
-		if ( (activ_users[first_number]).erase(second_number, old_size) ){
-			// запись успешно удалена; корректируем размер базы данных
-			number_of_bytes -= old_size;
-			--number_of_records;
-			return true;
-		}
-		if ((inactiv_users[first_number]).erase(second_number, old_size)) {
+		if ((activ_users[first_number]).erase(second_number, old_size, old_value) ||
+			(inactiv_users[first_number]).erase(second_number, old_size, old_value)) {
 			// запись успешно удалена; корректируем размер базы данных
 			number_of_bytes -= old_size;
 			--number_of_records;
+			if (!dirty[first_number].load(std::memory_order_relaxed))
+				dirty[first_number] = true;
+			++modifications;
+			if (index)
+				names_index.remove(old_rec.get_last_name(), old_rec.get_first_name(), old_rec.get_patronymic(),
+					NameIndexId(first_number, second_number));
 			return true;
 		}
 		
@@ -540,151 +1721,187 @@ namespace DataBase {
 		return lock;
 	}
 
+	// подключение журнала упреждающей записи
+	template<typename Key, typename T>
+	void data<Key, T>::AttachLog(write_ahead_log* wal) {
+		std::unique_lock<boost::shared_mutex> lock(mutex);
+		log = wal;
+	}
+
+	// включение и выключение индекса имен
+	template<typename Key, typename T>
+	void data<Key, T>::SetNameIndex(bool enabled, unsigned int num_threads) {
+		std::unique_lock<boost::shared_mutex> lock(mutex);
+
+		// индекс строится по всем записям, в том числе еще не загруженным блокам ленивой загрузки
+		MaterializeAll();
+		name_index_enabled = enabled;
+		RebuildNameIndex(num_threads);
+	}
+
+	// номер записи в индексе имен
+	template<typename Key, typename T>
+	uint64_t data<Key, T>::NameIndexId(int first_number, number_key second_number) const {
+		if (first_number >= Hasher.number_of_domestic_buckets())
+			return (1ULL << 63) | second_number;
+		uint64_t divisor = 1;
+		for (int i = 0; i < number_of_second_digits; ++i)
+			divisor *= 10;
+		return (uint64_t)first_number * divisor + second_number;
+	}
+
+	// сегмент и ключ записи по номеру в индексе имен
+	template<typename Key, typename T>
+	number_index data<Key, T>::NameIndexNumber(uint64_t id) const {
+		if (id >> 63) {
+			// сегмент международного номера определяется нумерационным планом по цифрам номера
+			char buffer[Hash::max_number_length];
+			char* end = numbering_plan::decode(id & ~(1ULL << 63), buffer);
+			return Hasher.hash(boost::string_view(buffer, end - buffer));
+		}
+		uint64_t divisor = 1;
+		for (int i = 0; i < number_of_second_digits; ++i)
+			divisor *= 10;
+		return number_index((int)(id / divisor), id % divisor);
+	}
+
+	// Построение индекса имен: потоки перебирают записи своих диапазонов сегментов
+	template<typename Key, typename T>
+	void data<Key, T>::RebuildNameIndex(unsigned int num_threads) {
+		names_index.clear();
+		if (!name_index_enabled || num_threads == 0)
+			return;
+
+		// диапазоны сегментов потоков содержат примерно равное количество записей
+		const std::vector<unsigned int> bounds = SplitBuckets((unsigned int)activ_users.size(), num_threads,
+			[&](unsigned int bucket) { return BucketRecords(bucket); });
+		names_index.build(num_threads, [&](unsigned int part, name_index::collector& emit) {
+			for (unsigned int index = bounds[part]; index != bounds[part + 1]; ++index) {
+				for (int n = 0; n < 2; ++n) {
+					const thread_safe_map<number_key, T>& map = (n == 0) ? activ_users[index] : inactiv_users[index];
+					for (auto it = map.begin(); it != map.end(); ++it)
+						emit(it->second.get_last_name(), it->second.get_first_name(), it->second.get_patronymic(),
+							NameIndexId(index, it->first));
+				}
+			}
+		});
+	}
+
+	// восстановление базы данных из снимка последней контрольной точки и журнала
+	template<typename Key, typename T>
+	unsigned long data<Key, T>::Recover(write_ahead_log& wal, bool lazy, int wait_time) {
+
+		// журнал подключается после восстановления, поэтому загрузка снимка не создает новую контрольную точку
+		// и не усекает еще не примененный журнал
+		std::string snapshot;
+		unsigned int num_threads = 1;
+		if (wal.read_checkpoint(snapshot, num_threads)) {
+			incremental_manifest manifest;
+			if (read_incremental_manifest(snapshot, manifest))
+				LoadIncremental(num_threads, snapshot, wait_time);
+			else if (is_snapshot_file(snapshot) && lazy)
+				LoadLazy(snapshot, wait_time);
+			else if (is_snapshot_file(snapshot))
+				LoadSnapshot(num_threads, snapshot, wait_time);
+			else
+				Load(num_threads, snapshot, wait_time);
+		}
+
+		// последовательное применение записей журнала под монопольной блокировкой
+		std::unique_lock<boost::shared_mutex> lock(mutex);
+		unsigned long count = wal.replay([&](const wal_entry& entry) {
+			number_index P = Hasher.hash(entry.number);
+			MaterializeBucket(P.first);
+			if (entry.op == 'A') {
+				T rec(std::string(entry.last_name), std::string(entry.first_name), std::string(entry.patronymic));
+				AddRecord_no_block(P.first, P.second, entry.activity, rec);
+			}
+			else
+				DeleteRecord_no_block(P.first, P.second);
+		});
+		log = &wal;
+
+		lock.unlock();
+		data_cond.notify_one();
+
+		return count;
+	}
+
 	// проверка базы данных на пустоту
 	template<typename Key, typename T>
 	bool data<Key, T>::Empty() {
-		if (number_of_records.load())
+		// база данных не пуста, пока не завершена ленивая загрузка снимка
+		if (number_of_records.load() || lazy_remaining.load())
 			return false;
 		else
 			return true;
 	}
 
+	// Разбиение [0, count) на диапазоны потоков по весу сегментов
 	template<typename Key, typename T>
-	void data<Key, T>::GenerateOneThread(unsigned int count_of_records,
-		unsigned int block_begin, unsigned int block_end,
-		const names_vector& v_last_name_male,
-		const names_vector& v_last_name_female,
-		const names_vector& v_first_name_male,
-		const names_vector& v_first_name_female,
-		const names_vector& v_patronymic_male,
-		const names_vector& v_patronymic_female)
+	template<typename Weight>
+	std::vector<unsigned int> data<Key, T>::SplitBuckets(unsigned int count, unsigned int num_threads, Weight weight)
 	{
-		// проверка на непустоту генерируемого диапазона
-		unsigned int count_of_map = block_end - block_begin; // количество map, в которые генерируются записи
-		if (count_of_map == 0)
-			return;
-
-		double count_record_per_map = count_of_records / static_cast<double>(count_of_map);
-		int count_integer_part = static_cast<int>(count_record_per_map);
-		double count_fractional_part = count_record_per_map - count_integer_part;
-		int count_in_map = count_integer_part;
-		
-		std::vector<int> indexes_vec; // вектор для хранения второй половины генерируемого номера
-		std::set<int>    indexes_set; // набор для хранения второй половины генерируемого номера
-
-		// размер вектора известен заранее - резервируем его.
-		indexes_vec.reserve(count_integer_part);
-				
-		std::random_device rd;
-		std::default_random_engine generator(rd());
-		//std::mt19937 generator(rd());
-		std::bernoulli_distribution bernoulli(0.5); // генератор числа 0 либо 1 с равной вероятностью
-		std::bernoulli_distribution small_bernoulli(count_fractional_part); // генератор числа 0 либо 1 с вероятностью count_fractional_part
-		std::uniform_int_distribution<unsigned int> distr_second_part(0, (unsigned int)pow(10, number_of_second_digits) - 1);     // генератор случайного целого числа от 0 до 10^number_of_second_digits - случайная вторая половина телефонного номера
-
-		// генераторы индексов массивов с соответсвующими именами
-		std::uniform_int_distribution<unsigned int> distr_last_name_male(0,    (unsigned int) v_last_name_male.size() - 1);
-		std::uniform_int_distribution<unsigned int> distr_last_name_female(0,  (unsigned int) v_last_name_female.size() - 1);
-		std::uniform_int_distribution<unsigned int> distr_first_name_male(0,   (unsigned int) v_first_name_male.size() - 1);
-		std::uniform_int_distribution<unsigned int> distr_first_name_female(0, (unsigned int) v_first_name_female.size() - 1);
-		std::uniform_int_distribution<unsigned int> distr_patronymic_male(0,   (unsigned int) v_patronymic_male.size() - 1);
-		std::uniform_int_distribution<unsigned int> distr_patronymic_female(0, (unsigned int) v_patronymic_female.size() - 1);
-
-		int count = 0;
-		int small_random = 0;
-		std::pair<const Key, T> P;
-		unsigned int second_part;
-		unsigned int random_last_name_index;
-		unsigned int random_first_name_index;
-		unsigned int random_patronymic_index;
-
-		unsigned int first_index = block_begin;
-		while (first_index != block_end)	//  цикл по map
-		{
-			// два цикла: по целой (k == 0) и дробной частям (k == 1)
-			// отдельная генерация нецелого числа записей: если генератор случайного числа 0/1 с вероятностью, 
-			// равной дробной части количества генерируемых записей в каждом массиве, выдает значение 1 - производится
-			// генерация новой записи и ее добавление в массив.
-			for (int k = 0; k < 2; ++k) {
-				if (count_integer_part > 0 && k == 0) {
-
-					// генерация count_integer_part неповторяющихся случайных чисел, соответствующим второй половине номера абонента
-					while (indexes_vec.size() != count_integer_part) {
-						second_part = distr_second_part(generator);
-						indexes_vec.push_back(second_part);
-						indexes_set.insert(second_part);
-						if (indexes_vec.size() != indexes_set.size())
-							indexes_vec.pop_back();
-					}
-				}
-				if (count_fractional_part == 0 && k == 1)	continue;
-
-				count = 0;
-
-				// генерация count_integer_part записей в каждом ассоциативном массиве
-				// для дробной части производится только один цикл в случае выпадения 1 (с вероятностью count_fractional_part)
-				count_in_map = (k == 0)? count_integer_part : small_bernoulli(generator);
-								
-				while (count < count_in_map) {
-
-					// генерация случайных индексов массивов с фамилиями, именами и отчествами
-					std::string sex = bernoulli(generator) ? "f" : "m"; // равновероятный пол
-					if (sex == "m") {
-						random_last_name_index  = distr_last_name_male(generator);
-						random_first_name_index = distr_first_name_male(generator);
-						random_patronymic_index = distr_patronymic_male(generator);
-					}
-					else
-					{
-						random_last_name_index  = distr_last_name_female(generator);
-						random_first_name_index = distr_first_name_female(generator);
-						random_patronymic_index = distr_patronymic_female(generator);
-					}
+		std::vector<unsigned long long> weights(count);
+		unsigned long long total = 0;
+		for (unsigned int i = 0; i < count; ++i) {
+			weights[i] = weight(i);
+			total += weights[i];
+		}
 
-					// считывание фамилии, имени и отчества из соответствующих векторов по случайному индексу
-					std::string last_name  = (sex == "m") ? v_last_name_male[random_last_name_index] : v_last_name_female[random_last_name_index];
-					std::string first_name = (sex == "m") ? v_first_name_male[random_first_name_index] : v_first_name_female[random_first_name_index];
-					std::string patronymic = (sex == "m") ? v_patronymic_male[random_patronymic_index] : v_patronymic_female[random_patronymic_index];
-					
-					// генерация второй части номера
-					second_part = distr_second_part(generator);
+		std::vector<unsigned int> bounds(num_threads + 1, count);
+		bounds[0] = 0;
+		if (total == 0) {
+			// записей нет: диапазоны с равным количеством сегментов
+			for (unsigned int part = 1; part < num_threads; ++part)
+				bounds[part] = (unsigned int)((unsigned long long)count * part / num_threads);
+			return bounds;
+		}
 
-					// генерация признака активности
-					bool activity = bernoulli(generator) ? true : false;
+		// граница part ставится перед сегментом, к началу которого накоплена доля part / num_threads всех записей
+		unsigned long long accumulated = 0;
+		unsigned int part = 1;
+		for (unsigned int i = 0; i < count && part < num_threads; ++i) {
+			while (part < num_threads && accumulated >= total * part / num_threads)
+				bounds[part++] = i;
+			accumulated += weights[i];
+		}
+		return bounds;
+	}
 
-					// создание новой записи
-					T rec(std::move(last_name), std::move(first_name), std::move(patronymic));
+	template<typename Key, typename T>
+	void data<Key, T>::GenerateOneThread(unsigned int block_begin, unsigned int block_end,
+		const generation_model& model, uint64_t seed)
+	{
+		// собственный генератор потока (generator.h); сегменты генерируются последовательностями bucket_seed(seed, сегмент)
+		record_generator generator(model, seed);
 
-					if (k == 0) {
-						// добавление записи в один из массивов. на каждой итерации цикла по уникальному ключу добавляется
-						// новая запись, поэтому отсутствует необходимость проверки на ее наличие в обоих массивах.						//activ_users[first_index].add(indexes[count], rec); // значение второй половины записи находится в векторе indexes 
-						if(activity)
-							activ_users[first_index].add(indexes_vec[count], rec);
-						else 
-							inactiv_users[first_index].add(indexes_vec[count], rec);
-					}
-					else {// ветвь для дробной части
-						unsigned int old_size = 0; 
-						// добавление записи с проверкой на ее наличие в обоих массивах
-						if (activity){
-							while( !(activ_users[first_index].add_or_update(second_part, rec, old_size)) )
-								second_part = distr_second_part(generator); // повторная генерация второй части номера
-							number_of_bytes += rec.size() - old_size;   // коррекция размера базы данных в случае обновления элемента
-						}
-						else {
-							while (!(inactiv_users[first_index].add_or_update(second_part, rec, old_size)))
-								second_part = distr_second_part(generator); // повторная генерация второй части номера
-							number_of_bytes += rec.size() - old_size;   // коррекция размера базы данных в случае обновления элемента
-						}
-					}
+		std::vector<generated_record> records, active, inactive;
 
-					// увеличение счетчиков числа записей и размера базы данных
-					++number_of_records;
-					number_of_bytes += rec.size();
-					++count;
-				}
-			}			
-			++first_index;
+		for (unsigned int first_index = block_begin; first_index != block_end; ++first_index)	//  цикл по map
+		{
+			dirty[first_index] = true;
+			++modifications;
+
+			// записи с различными вторыми частями номера по возрастанию распределяются между массивами
+			// активных и неактивных абонентов и остаются упорядоченными
+			generator.generate_bucket(first_index, records);
+			active.clear();
+			inactive.clear();
+			for (auto& rec : records)
+				(rec.activity ? active : inactive).push_back(rec);
+
+			// строки копируются из списков имен непосредственно в запись
+			auto make_record = [](const generated_record& rec) {
+				return std::make_pair((number_key)rec.suffix,
+					T(rec.last_name.to_string(), rec.first_name.to_string(), rec.patronymic.to_string()));
+			};
+			unsigned long long bytes = activ_users[first_index].append_sorted(active.begin(), active.end(), make_record);
+			bytes += inactiv_users[first_index].append_sorted(inactive.begin(), inactive.end(), make_record);
+
+			// счетчики числа записей и размера базы данных обновляются один раз на сегмент
+			number_of_records += (unsigned long)records.size();
+			number_of_bytes += bytes;
 		}
 	}
 			
@@ -692,6 +1909,19 @@ namespace DataBase {
 	template<typename Key, typename T>
 	unsigned long data<Key, T>::SaveOneThread(unsigned int block_begin, unsigned int block_end, const std::string file_name)
 	{
+		if (io == io_backend::direct) {
+			// прямой вывод: записи форматируются в выровненные буферы, которые записываются на диск параллельно с выводом
+			direct_output_buffer buffer(file_name);
+			std::ostream file(&buffer);
+			unsigned long count = PrintBuckets(file, block_begin, block_end);
+			if (!file)
+				throw FileWriteError(file_name);
+			buffer.close();
+			sync_file(file_name);
+			data_cond.notify_one();
+			return count;
+		}
+
 		// открытие файла на запись
 		std::ofstream file(file_name);
 		if (!file) {
@@ -699,65 +1929,115 @@ namespace DataBase {
 			throw(FileOpenError("Can not open " + file_name + "."));
 		}
 
+		unsigned long count = PrintBuckets(file, block_begin, block_end);
+
+		// Сохранение базы данных в файл завершено, посылается уведомление ожидающим потокам.
+		file.close(); // Когда file выйдет из области видимости, то деструктор класса ofstream автоматически закроет файл - поэтому нет необходимости в вызове .close().
+		if (!file)
+			throw FileWriteError(file_name);
+
+		// файл сбрасывается на диск в потоке, который его записал, поэтому файлы снимка сбрасываются параллельно
+		sync_file(file_name);
+		data_cond.notify_one();
+
+		return count;
+	}
+
+	// Вывод записей сегментов [block_begin, block_end) в поток: сначала активные, затем неактивные абоненты
+	template<typename Key, typename T>
+	unsigned long data<Key, T>::PrintBuckets(std::ostream& file, unsigned int block_begin, unsigned int block_end)
+	{
 		unsigned long count = 0;
 
 		// вывод активных абонентов
 		unsigned int index = block_begin;
 		while (index != block_end) {
-			count += activ_users[index].print(file, index, true, number_of_first_digits, number_of_second_digits);
+			count += activ_users[index].print(file, true, number_writer{ Hasher, (int)index });
 			++index;
 		}
 
 		// вывод неактивных абонентов
 		index = block_begin;
 		while (index != block_end) {
-			count += inactiv_users[index].print(file, index, false, number_of_first_digits, number_of_second_digits);
+			count += inactiv_users[index].print(file, false, number_writer{ Hasher, (int)index });
 			++index;
 		}
 
-		// Сохранение базы данных в файл завершено, посылается уведомление ожидающим потокам.
-		file.close(); // Когда file выйдет из области видимости, то деструктор класса ofstream автоматически закроет файл - поэтому нет необходимости в вызове .close().
-		data_cond.notify_one();
-
 		return count;
 	}
 
 	// Загрузка базы данных из файла в один поток
 	template<typename Key, typename T>
-	unsigned long data<Key, T>::LoadOneThread(const std::string file_name)
+	unsigned long data<Key, T>::LoadOneThread(const std::string file_name, unsigned long long begin, unsigned long long end)
 	{
 		unsigned long count = 0;
 
-		// открытие файла базы данных на чтение с помощью стороннего ридера (https://github.com/ben-strasser/fast-cpp-csv-parser).
 		try {
-			io::CSVReader<5> in(file_name); // инициализация ридера
-
-			std::pair<int, int> pair;
-			// построчное чтение csv-файла в переменные number, last_name, first_name, patronymic, activity
-			std::string number; std::string last_name; std::string first_name; std::string patronymic; int activity;
-			while (in.read_row(number, last_name, first_name, patronymic, activity)) {
-				// создание новой записи в памяти
-				T rec(std::move(last_name), std::move(first_name), std::move(patronymic));
-				//T rec(last_name, first_name, patronymic);
-
-				// нахождение индексов, соответсвующих телефонному номеру
-				std::pair<int, int> pair = Hasher.hash(number);
-
-				// Добавление записи в базу данных без защиты блокировкой, так как операцией Load уже захвачена блокировка с монопольным доступом.
-				// Теоретически в базе данных могут находиться неуникальные записи, поэтому при каждом добавлении записи в базу данных
-				// осуществляется ее предварительный поиск в ней, что существенно снижает скорость операции загрузки базы данных отностильно ее выгрузки на диск
-				AddRecord_no_block(pair.first, pair.second, activity, rec);
-				++count;
-			}
+			if (io == io_backend::direct) {
+				// При прямом вводе-выводе файл читается стороннем ридером (https://github.com/ben-strasser/fast-cpp-csv-parser),
+				// который получает данные из direct_byte_source.
+				io::CSVReader<5> in(file_name, std::unique_ptr<io::ByteSourceBase>(new direct_byte_source(file_name)));
+
+				// построчное чтение csv-файла в переменные number, last_name, first_name, patronymic, activity
+				std::string number; std::string last_name; std::string first_name; std::string patronymic; int activity;
+				while (in.read_row(number, last_name, first_name, patronymic, activity)) {
+					// создание новой записи в памяти
+					T rec(std::move(last_name), std::move(first_name), std::move(patronymic));
 
-			// Когда file выйдет из области видимости, то деструктор класса io::CSVReader<5> автоматически закроет файл - поэтому нет необходимости в вызове .close().
+					// нахождение индексов, соответсвующих телефонному номеру
+					number_index pair = Hasher.hash(number);
 
+					// Добавление записи в базу данных без защиты блокировкой, так как операцией Load уже захвачена блокировка с монопольным доступом.
+					AddRecord_no_block(pair.first, pair.second, activity, rec);
+					++count;
+				}
+			}
+			else {
+				// Файл отображается в память и разбирается специализированным ридером subscriber_csv_reader:
+				// поля строки указывают на данные файла, строки std::string создаются только для записи базы данных.
+				// Читаются строки, начинающиеся в диапазоне байтов [begin, end).
+				// Строки читаются группами по hash_batch_size, номера группы преобразуются в индексы одним вызовом Hasher.hash.
+				subscriber_csv_reader in(file_name, begin, end);
+				subscriber_row rows[hash_batch_size];
+				boost::string_view numbers[hash_batch_size];
+				number_index indices[hash_batch_size];
+				size_t n;
+				do {
+					for (n = 0; n < hash_batch_size && in.next(rows[n]); ++n)
+						numbers[n] = rows[n].number;
+
+					size_t valid = Hasher.hash(numbers, n, indices);
+					if (valid != n)
+						throw FileCorruptError(file_name, "недопустимый номер телефона " + numbers[valid].to_string());
+
+					for (size_t i = 0; i < n; ++i) {
+						const subscriber_row& row = rows[i];
+						T rec(row.last_name.to_string(), row.first_name.to_string(), row.patronymic.to_string());
+
+						// Добавление записи в базу данных без защиты блокировкой, так как операцией Load уже захвачена блокировка с монопольным доступом.
+						// Теоретически в базе данных могут находиться неуникальные записи, поэтому при каждом добавлении записи в базу данных
+						// осуществляется ее предварительный поиск в ней, что существенно снижает скорость операции загрузки базы данных отностильно ее выгрузки на диск
+						AddRecord_no_block(indices[i].first, indices[i].second, row.activity, rec);
+						++count;
+					}
+				} while (n == hash_batch_size);
+			}
 		}
-		catch (std::bad_alloc) {
+		catch (std::bad_alloc&) {
 			throw FileError("Ошибка выделения памяти при загрузки данных из файла: " + file_name);
 		}
+		catch (FileError&) {
+			throw;
+		}
+		catch (io::error::base& e) {
+			// ошибка разбора сообщается с номером строки файла (обрезанный или поврежденный файл)
+			std::string reason = e.what();
+			if (!reason.empty() && reason.back() == '.')
+				reason.pop_back();
+			throw FileCorruptError(file_name, reason);
+		}
 		catch (...) {
-			throw FileError("Ошибка открытия/чтения файла: " + file_name);
+			throw FileReadError(file_name);
 		}
 		// Сохранение базы данных в файл завершено, посылается уведомление ожидающим потокам.
 		data_cond.notify_one();
@@ -765,6 +2045,92 @@ namespace DataBase {
 		return count;
 	}
 
+	// Формирование блока снимка из сегментов [first_bucket, end_bucket)
+	template<typename Key, typename T>
+	void data<Key, T>::BuildBlock(unsigned int first_bucket, unsigned int end_bucket, block_compression compression,
+		block_header& header, std::string& stored)
+	{
+		std::string raw;
+		header.first_bucket = first_bucket;
+		header.end_bucket   = end_bucket;
+		header.records      = 0;
+
+		// записи блока упорядочены так же, как в базе данных: по сегментам, внутри сегмента - активные, затем неактивные абоненты
+		for (unsigned int index = first_bucket; index != end_bucket; ++index) {
+			for (int n = 0; n < 2; ++n) {
+				const thread_safe_map<number_key, T>& map = (n == 0) ? activ_users[index] : inactiv_users[index];
+				for (auto it = map.begin(); it != map.end(); ++it) {
+					append_row(raw, index, it->first, n == 0,
+						it->second.get_last_name(), it->second.get_first_name(), it->second.get_patronymic());
+					++header.records;
+				}
+			}
+		}
+
+		stored = encode_block(raw, compression, header);
+	}
+
+	// Добавление в базу данных записей несжатого блока снимка
+	template<typename Key, typename T>
+	unsigned long data<Key, T>::LoadBlock(uint32_t version, const block_header& header, const std::string& raw)
+	{
+		unsigned long count = 0;
+		uint32_t bucket;
+		uint64_t suffix;
+		bool activity;
+		std::string last_name, first_name, patronymic;
+
+		row_reader reader(raw.data(), raw.size(), version);
+		while (reader.next(bucket, suffix, activity, last_name, first_name, patronymic)) {
+			if (bucket < header.first_bucket || bucket >= header.end_bucket || !Hasher.valid_index(bucket, suffix))
+				throw std::runtime_error("Snapshot: the record index is out of range.");
+
+			T rec(std::move(last_name), std::move(first_name), std::move(patronymic));
+			AddRecord_no_block(bucket, suffix, activity, rec);
+			++count;
+		}
+		return count;
+	}
+
+	// Запись сегментов в файлы каталога инкрементальных контрольных точек в один поток
+	template<typename Key, typename T>
+	void data<Key, T>::SaveBucketsOneThread(const std::vector<unsigned int>& buckets, size_t begin, size_t end,
+		const std::string& dir_name, unsigned long version, std::vector<unsigned long>& counts)
+	{
+		for (size_t i = begin; i != end; ++i) {
+			unsigned int index = buckets[i];
+
+			// пустой сегмент исключается из манифеста, файл для него не создается
+			if (activ_users[index].empty() && inactiv_users[index].empty())
+				continue;
+
+			std::string file_name = bucket_file_name(dir_name, index, version);
+			std::ofstream file(file_name);
+			if (!file)
+				throw(FileOpenError(file_name));
+
+			counts[i]  = activ_users[index].print(file, true, number_writer{ Hasher, (int)index });
+			counts[i] += inactiv_users[index].print(file, false, number_writer{ Hasher, (int)index });
+
+			file.close();
+			if (!file)
+				throw(FileWriteError(file_name));
+
+			// файл сегмента должен быть на диске до публикации манифеста
+			sync_file(file_name);
+		}
+	}
+
+	// Загрузка списка файлов в один поток
+	template<typename Key, typename T>
+	unsigned long data<Key, T>::LoadFilesOneThread(const std::vector<std::string>& files, size_t begin, size_t end)
+	{
+		unsigned long count = 0;
+		for (size_t i = begin; i != end; ++i)
+			count += LoadOneThread(files[i]);
+		return count;
+	}
+
 	template<typename Key, typename T>
 	void data<Key, T>::ClearOneThread(unsigned int block_begin, unsigned int block_end) {
 		while (block_begin != block_end) {
@@ -775,8 +2141,20 @@ namespace DataBase {
 		}
 	}
 
+	// Удаление записей, загруженных прерванной операцией загрузки (вызывается под монопольной блокировкой)
+	template<typename Key, typename T>
+	void data<Key, T>::DiscardPartialLoad() {
+		ClearOneThread(0, (unsigned int)activ_users.size());
+		Set_number_of_records(0);
+		Set_number_of_bytes(0);
+		names_index.clear();
+		for (auto& d : dirty)
+			d = true;
+		++modifications;
+	}
+
+	// счетчики читаются без блокировки базы данных: во время операций загрузки и генерации возвращается текущее значение
 	template<typename Key, typename T> unsigned long data<Key, T>::Get_number_of_records(void) const {
-		boost::shared_lock<boost::shared_mutex> lock(mutex);
 		return number_of_records.load();
 	}
 
@@ -785,8 +2163,12 @@ namespace DataBase {
 		return number_of_first_digits;
 	}
 
+	template<typename Key, typename T>
+	unsigned int data<Key, T>::Get_number_of_buckets(void)  const {
+		return (unsigned int)activ_users.size();
+	}
+
 	template<typename Key, typename T> unsigned long long data<Key, T>::Get_number_of_bytes(void)   const {
-		boost::shared_lock<boost::shared_mutex> lock(mutex);
 		return number_of_bytes.load();
 	}
 
@@ -809,7 +2191,7 @@ namespace DataBase {
 
 		if (number_of_records.load() == 0) {
 			// Элементы отсутствуют - возвращается конечный итератор.
-			return (data_iterator<Key, T>(static_cast<unsigned int>(pow(10, number_of_first_digits)) - 1, false, (inactiv_users[static_cast<unsigned int>(pow(10, number_of_first_digits)) - 1]).end(), this));
+			return (data_iterator<Key, T>((unsigned int)inactiv_users.size() - 1, false, (inactiv_users[inactiv_users.size() - 1]).end(), this));
 		}
 
 		// Здесь существует по крайней мере один элемент. Находим первый элемент и возвращаем итератор на него
@@ -824,7 +2206,7 @@ namespace DataBase {
 		}
 
 		// Теоретически мы не должны попасть сюда, но в этом случае возвращаем конечный итератор. 
-		return (data_iterator<Key, T>( (unsigned int)pow(10, number_of_first_digits) - 1, false, (inactiv_users[inactiv_users.size() - 1]).end(), this));
+		return (data_iterator<Key, T>((unsigned int)inactiv_users.size() - 1, false, (inactiv_users[inactiv_users.size() - 1]).end(), this));
 
 	}
 
@@ -840,7 +2222,7 @@ namespace DataBase {
 		}
 
 		// Теоретически мы не должны попасть сюда, но в этом случае возвращаем конечный итератор. 
-		return (data_iterator<Key, T>((unsigned int)pow(10, number_of_first_digits) - 1, false, (inactiv_users[inactiv_users.size() - 1]).end(), this));
+		return (data_iterator<Key, T>((unsigned int)inactiv_users.size() - 1, false, (inactiv_users[inactiv_users.size() - 1]).end(), this));
 	}
 
 	template <typename Key, typename T>
@@ -848,7 +2230,7 @@ namespace DataBase {
 		data<Key, T>::end() const
 	{
 		// Конечный итератор базы данных - это конечный итератор ассоциативного массива в последнем сегменте. 
-		return (data_iterator<Key, T>((unsigned int)pow(10, number_of_first_digits) - 1, false, (inactiv_users[inactiv_users.size() - 1]).end(), this));
+		return (data_iterator<Key, T>((unsigned int)inactiv_users.size() - 1, false, (inactiv_users[inactiv_users.size() - 1]).end(), this));
 	}
 
 	// итератор по-умолчанию. так как операция разыменования данного итератора не имеет смысла, 
@@ -858,13 +2240,13 @@ namespace DataBase {
 	{
 		mBucket = -1;
 		activ = true;
-		it = thread_safe_map<int, T>::const_iterator();
+		it = thread_safe_map<number_key, T>::const_iterator();
 		ptr_vector = NULL;
 	}
 
 
 	template<typename Key, typename T>
-	data_iterator<Key, T>::data_iterator(unsigned int Bucket, bool Activ, typename thread_safe_map<int, T>::const_iterator in_iterator,
+	data_iterator<Key, T>::data_iterator(unsigned int Bucket, bool Activ, typename thread_safe_map<number_key, T>::const_iterator in_iterator,
 		const data<Key, T>* in_ptr_vector) :
 		mBucket(Bucket), activ(Activ), it(in_iterator), ptr_vector(in_ptr_vector)
 	{
@@ -883,14 +2265,14 @@ namespace DataBase {
 	}
 
 	template<typename Key, typename T>
-	const std::pair<const int, T>&
+	const std::pair<const number_key, T>&
 		data_iterator<Key, T>::operator*() const
 	{
 		return (*it);
 	}
 
 	template<typename Key, typename T>
-	const std::pair<const int, T>*
+	const std::pair<const number_key, T>*
 		data_iterator<Key, T>::operator->() const
 	{
 		return (&(*it));
@@ -979,45 +2361,6 @@ namespace DataBase {
 		return (!operator== (rhs));
 	}
 
-	// вспомогательные функции
-
-		// чтение базы данных имен, фамилий и отчеств из файла f в вектор v.
-	names_vector read_name_file(const std::string& file_name)
-	{
-		names_vector vec;
-
-		// открытие базы имен, фамилий или отчеств,
-		// в случае неуспеха генерируется исключение.
-		try{
-		io::CSVReader<1> in(file_name); // инициализация ридера
-
-		// построчное чтение csv-файла в переменные name, sex
-		std::string name; 
-		while (in.read_row(name)) 
-			vec.push_back(name);
-			
-		}
-		catch(...)
-		{
-			// ошибка чтения файла, генерируется исключение
-			throw FileReadError(file_name);
-		}
-
-		return vec;
-	}
-
-	// функция из вектора случайным образом выбирает имя с заданным полом.
-	const std::string& generate_random_name(const names_vector& v, const std::string& sex) {
-
-		std::random_device rd;
-		std::default_random_engine generator(rd());
-		std::uniform_int_distribution<> distribution(0, int(v.size() - 1));
-
-		int index = distribution(generator); // индекс случайного элемента вектора
-
-		return v[index]; // возвращение случайного имени с заданным полом.
-	}
-	
 } // namespace DataBase
 
 #endif // data_INL
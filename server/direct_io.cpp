@@ -0,0 +1,271 @@
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "direct_io.h"
+#include "error.h"
+
+namespace DataBase {
+
+	namespace {
+
+		size_t align_up(size_t size)
+		{
+			return (size + aligned_buffer::alignment - 1) / aligned_buffer::alignment * aligned_buffer::alignment;
+		}
+
+		// Открытие файла с флагом O_DIRECT; если файловая система его не поддерживает (например, tmpfs),
+		// файл открывается без него. В direct возвращается признак использования O_DIRECT.
+		int open_direct(const std::string& file_name, int flags, bool& direct)
+		{
+			int fd = -1;
+#ifdef O_DIRECT
+			fd = ::open(file_name.c_str(), flags | O_DIRECT, 0644);
+#endif
+			direct = (fd >= 0);
+			if (fd < 0)
+				fd = ::open(file_name.c_str(), flags, 0644);
+			return fd;
+		}
+
+		// запись size байт по смещению offset с повторением при частичной записи
+		void write_at(int fd, const char* data, size_t size, uint64_t offset, const std::string& file_name)
+		{
+			size_t done = 0;
+			while (done < size) {
+				ssize_t n = ::pwrite(fd, data + done, size - done, offset + done);
+				if (n <= 0)
+					throw FileWriteError(file_name);
+				done += n;
+			}
+		}
+
+		// чтение до size байт по смещению offset; меньшее количество возвращается только в конце файла
+		size_t read_at(int fd, char* data, size_t size, uint64_t offset, const std::string& file_name)
+		{
+			size_t done = 0;
+			while (done < size) {
+				ssize_t n = ::pread(fd, data + done, size - done, offset + done);
+				if (n < 0)
+					throw FileReadError(file_name);
+				if (n == 0)
+					break;
+				done += n;
+			}
+			return done;
+		}
+	}
+
+	io_backend parse_io_backend(const std::string& backend)
+	{
+		if (backend == "stream") return io_backend::stream;
+		if (backend == "direct") return io_backend::direct;
+		throw std::invalid_argument("Unknown I/O backend '" + backend + "'. Use stream or direct.");
+	}
+
+	aligned_buffer::aligned_buffer(size_t size) : ptr(nullptr), length(align_up(size))
+	{
+		void* p = nullptr;
+		if (posix_memalign(&p, alignment, length) != 0)
+			throw std::bad_alloc();
+		ptr = static_cast<char*>(p);
+	}
+
+	aligned_buffer::~aligned_buffer()
+	{
+		std::free(ptr);
+	}
+
+	direct_output_buffer::direct_output_buffer(const std::string& name, size_t buffer_size, unsigned int queue_depth) :
+		file_name(name), fd(-1), is_direct(false), failed(false), current(0), offset(0)
+	{
+		if (queue_depth < 2)
+			queue_depth = 2;
+		for (unsigned int i = 0; i < queue_depth; ++i)
+			buffers.emplace_back(buffer_size);
+		pending.resize(queue_depth);
+
+		fd = open_direct(file_name, O_WRONLY | O_CREAT | O_TRUNC, is_direct);
+		if (fd < 0)
+			throw FileOpenError(file_name);
+
+		setp(buffers[0].data(), buffers[0].data() + buffers[0].size());
+	}
+
+	direct_output_buffer::~direct_output_buffer()
+	{
+		if (fd < 0)
+			return;
+		// файл не был закрыт явно (исключение при выводе) - дожидаемся запросов, ошибки игнорируются
+		for (auto& f : pending)
+			if (f.valid())
+				f.wait();
+		::close(fd);
+	}
+
+	void direct_output_buffer::submit(size_t size)
+	{
+		const char* data = buffers[current].data();
+		uint64_t at = offset;
+		int file = fd;
+		const std::string& name = file_name;
+		pending[current] = std::async(std::launch::async, [=, &name]() { write_at(file, data, size, at, name); });
+		offset += size;
+
+		// следующий буфер можно заполнять только после завершения его предыдущей записи
+		current = (current + 1) % buffers.size();
+		if (pending[current].valid()) {
+			try {
+				pending[current].get();
+			}
+			catch (...) {
+				failed = true; // std::ostream перехватывает исключение, ошибка сообщается в close()
+				throw;
+			}
+		}
+		setp(buffers[current].data(), buffers[current].data() + buffers[current].size());
+	}
+
+	void direct_output_buffer::wait_all()
+	{
+		for (auto& f : pending)
+			if (f.valid())
+				f.get();
+	}
+
+	direct_output_buffer::int_type direct_output_buffer::overflow(int_type ch)
+	{
+		if (fd < 0)
+			return traits_type::eof();
+		submit(pptr() - pbase());
+		if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+			*pptr() = traits_type::to_char_type(ch);
+			pbump(1);
+		}
+		return traits_type::not_eof(ch);
+	}
+
+	int direct_output_buffer::sync()
+	{
+		// данные передаются на диск целыми буферами; остаток записывается в close()
+		return 0;
+	}
+
+	void direct_output_buffer::close()
+	{
+		if (fd < 0)
+			return;
+
+		try {
+			// размер запроса O_DIRECT должен быть кратен размеру блока: хвост дополняется нулями,
+			// после записи файл усекается до фактического размера
+			size_t tail = pptr() - pbase();
+			uint64_t file_size = offset + tail;
+			if (tail > 0) {
+				size_t padded = is_direct ? align_up(tail) : tail;
+				std::memset(pptr(), 0, padded - tail);
+				submit(padded);
+			}
+			wait_all();
+			if (failed)
+				throw FileWriteError(file_name);
+
+			if (offset != file_size && ::ftruncate(fd, file_size) != 0)
+				throw FileWriteError(file_name);
+		}
+		catch (...) {
+			for (auto& f : pending)
+				if (f.valid())
+					f.wait();
+			::close(fd);
+			fd = -1;
+			throw;
+		}
+
+		int result = ::close(fd);
+		fd = -1;
+		if (result != 0)
+			throw FileWriteError(file_name);
+	}
+
+	direct_byte_source::direct_byte_source(const std::string& name, size_t chunk_size, unsigned int queue_depth) :
+		file_name(name), fd(-1), is_direct(false), file_size(0), next_chunk(0), current(0), position(0), available(0), started(false)
+	{
+		if (queue_depth < 2)
+			queue_depth = 2;
+		for (unsigned int i = 0; i < queue_depth; ++i)
+			buffers.emplace_back(chunk_size);
+		pending.resize(queue_depth);
+
+		fd = open_direct(file_name, O_RDONLY, is_direct);
+		if (fd < 0)
+			throw FileOpenError(file_name);
+
+		struct stat st;
+		if (::fstat(fd, &st) != 0) {
+			::close(fd);
+			throw FileReadError(file_name);
+		}
+		file_size = st.st_size;
+	}
+
+	direct_byte_source::~direct_byte_source()
+	{
+		for (auto& f : pending)
+			if (f.valid())
+				f.wait();
+		::close(fd);
+	}
+
+	void direct_byte_source::submit(unsigned int index)
+	{
+		uint64_t at = next_chunk * buffers[index].size();
+		if (at >= file_size)
+			return; // файл прочитан полностью, pending[index] остается пустым
+
+		++next_chunk;
+		char* data = buffers[index].data();
+		size_t size = buffers[index].size();
+		int file = fd;
+		const std::string& name = file_name;
+		pending[index] = std::async(std::launch::async, [=, &name]() { return read_at(file, data, size, at, name); });
+	}
+
+	int direct_byte_source::read(char* buffer, int size)
+	{
+		if (!started) {
+			for (unsigned int i = 0; i < buffers.size(); ++i)
+				submit(i);
+			started = true;
+		}
+
+		int done = 0;
+		while (done < size) {
+			if (position == available) {
+				// текущий буфер разобран: он передается на чтение следующего блока, чтение продолжается из следующего буфера
+				if (available > 0) {
+					submit(current);
+					current = (current + 1) % buffers.size();
+				}
+				position = available = 0;
+				if (!pending[current].valid())
+					break; // конец файла
+				available = pending[current].get();
+				if (available == 0)
+					break;
+			}
+
+			size_t n = std::min(available - position, (size_t)(size - done));
+			std::memcpy(buffer + done, buffers[current].data() + position, n);
+			position += n;
+			done += (int)n;
+		}
+		return done;
+	}
+
+} // namespace DataBase
@@ -0,0 +1,118 @@
+#ifndef DIRECT_IO_H
+#define DIRECT_IO_H
+
+#include <string>
+#include <vector>
+#include <streambuf>
+#include <future>
+#include <cstdint>
+
+#include "../lib/csv.h"
+
+namespace DataBase {
+
+	// Способ ввода-вывода при сохранении и загрузке базы данных (Save/Load):
+	// - stream - std::ofstream при записи и fread блоками по 1 Мб (io::LineReader) при чтении;
+	// - direct - прямой ввод-вывод в обход кэша страниц (O_DIRECT) с выровненными буферами,
+	//   несколькими одновременными запросами к диску и перекрытием ввода-вывода с обработкой данных.
+	//   Если файловая система не поддерживает O_DIRECT, файл открывается обычным образом,
+	//   остальные свойства (выровненные буферы, параллельные запросы) сохраняются.
+	enum class io_backend { stream, direct };
+
+	// преобразование строкового представления ("stream", "direct") в io_backend
+	io_backend parse_io_backend(const std::string& backend);
+
+	// буфер, выровненный по границе блока устройства (требование O_DIRECT)
+	class aligned_buffer {
+	public:
+		static const size_t alignment = 4096;
+
+		explicit aligned_buffer(size_t size);
+		~aligned_buffer();
+
+		aligned_buffer(const aligned_buffer&) = delete;
+		aligned_buffer& operator=(const aligned_buffer&) = delete;
+		aligned_buffer(aligned_buffer&& other) noexcept : ptr(other.ptr), length(other.length) { other.ptr = nullptr; }
+
+		char* data() const { return ptr; }
+		size_t size() const { return length; }
+
+	private:
+		char* ptr;
+		size_t length;
+	};
+
+	// Буфер потока вывода, записывающий файл прямым вводом-выводом.
+	// Данные форматируются непосредственно в один из queue_depth выровненных буферов;
+	// заполненный буфер передается на запись (pwrite по своему смещению) в отдельном потоке,
+	// а вывод продолжается в следующий буфер. Таким образом одновременно выполняются
+	// до queue_depth - 1 запросов записи, а формирование данных перекрывается с записью.
+	// Используется как std::ostream out(&buffer).
+	class direct_output_buffer : public std::streambuf {
+	public:
+		direct_output_buffer(const std::string& file_name, size_t buffer_size = 1 << 20, unsigned int queue_depth = 4);
+		~direct_output_buffer();
+
+		direct_output_buffer(const direct_output_buffer&) = delete;
+		direct_output_buffer& operator=(const direct_output_buffer&) = delete;
+
+		// запись оставшихся данных, установка точного размера файла и его закрытие;
+		// ошибки записи сообщаются исключением FileWriteError
+		void close();
+
+		// файл открыт с флагом O_DIRECT
+		bool direct() const { return is_direct; }
+
+	protected:
+		int_type overflow(int_type ch) override;
+		int sync() override;
+
+	private:
+		std::string file_name;
+		int fd;
+		bool is_direct;
+		bool failed;                               // ошибка записи одного из буферов
+		std::vector<aligned_buffer> buffers;
+		std::vector<std::future<void> > pending;   // запросы записи буферов
+		unsigned int current;                      // буфер, в который выполняется вывод
+		uint64_t offset;                           // смещение в файле начала текущего буфера
+
+		// передача текущего буфера (size байт) на запись и переход к следующему буферу
+		void submit(size_t size);
+
+		// ожидание завершения всех запросов записи
+		void wait_all();
+	};
+
+	// Источник байтов для io::LineReader (lib/csv.h), читающий файл прямым вводом-выводом.
+	// Файл читается выровненными блоками chunk_size; queue_depth блоков читаются заранее
+	// в отдельных потоках (pread по своему смещению), пока ридер разбирает уже прочитанные данные.
+	class direct_byte_source : public io::ByteSourceBase {
+	public:
+		direct_byte_source(const std::string& file_name, size_t chunk_size = 1 << 20, unsigned int queue_depth = 4);
+		~direct_byte_source();
+
+		int read(char* buffer, int size) override;
+
+		bool direct() const { return is_direct; }
+
+	private:
+		std::string file_name;
+		int fd;
+		bool is_direct;
+		uint64_t file_size;
+		std::vector<aligned_buffer> buffers;
+		std::vector<std::future<size_t> > pending;  // запросы чтения блоков
+		uint64_t next_chunk;                       // номер следующего блока, передаваемого на чтение
+		unsigned int current;                      // буфер, из которого выполняется чтение
+		size_t position;                           // позиция чтения в текущем буфере
+		size_t available;                          // количество прочитанных байт в текущем буфере
+		bool started;
+
+		// передача блока с номером next_chunk на чтение в буфер index
+		void submit(unsigned int index);
+	};
+
+} // namespace DataBase
+
+#endif // DIRECT_IO_H
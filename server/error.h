@@ -5,11 +5,12 @@
 namespace DataBase {
 	/*
 	* В базе данных используются следующие типы исключений:
-	* - исключения, связанные с записью/чтением файла данных с диска (FileOpenError, FileReadError),
+	* - исключения, связанные с записью/чтением файла данных с диска (FileOpenError, FileReadError, FileWriteError, FileCorruptError),
 	*   которые наследуются от FileError (runtime_error);
 	* - окончание времени ожидания (WaitTimeError);
 	* - исключения, связанные с нарушением последовательности доступа к базе данных (SequenceError);
 	* - превышение числа потоков для одновременной обработки запросов (MaxThreadError);
+	* - ошибка дочернего процесса фонового сохранения (ChildProcessError);
 	* - стандартные исключения std::bad_alloc и std::invalid_argument. 
 	*/
 
@@ -48,6 +49,26 @@ namespace DataBase {
 		virtual ~FileReadError() noexcept {}
 	};
 
+	// ошибка записи файла
+	class FileWriteError : public FileError
+	{
+	public:
+		FileWriteError(const std::string& fileNameIn) : FileError(fileNameIn) {
+			mMsg = "Ошибка записи файла " + fileNameIn + ".";
+		}
+		virtual ~FileWriteError() noexcept {}
+	};
+
+	// повреждение файла данных (несовпадение контрольной суммы, обрезанный файл); reason указывает место повреждения
+	class FileCorruptError : public FileError
+	{
+	public:
+		FileCorruptError(const std::string& fileNameIn, const std::string& reason) : FileError(fileNameIn) {
+			mMsg = "Файл " + fileNameIn + " поврежден: " + reason + ".";
+		}
+		virtual ~FileCorruptError() noexcept {}
+	};
+
 	// окончание времени ожидания
 	class WaitTimeError : public std::runtime_error
 	{
@@ -90,6 +111,20 @@ namespace DataBase {
 		std::string mMsg;
 	};
 
+	//  ошибка дочернего процесса (например, при сохранении базы данных в режиме fork)
+	class ChildProcessError : public std::runtime_error
+	{
+	public:
+		ChildProcessError(const std::string& message) : std::runtime_error(""), mMsg(message) {}
+		virtual ~ChildProcessError() noexcept {}
+		virtual const char* what() const throw ()
+		{
+			return mMsg.c_str();
+		}
+	protected:
+		std::string mMsg;
+	};
+
 /*
 	// тип ошибки при работе с данными
 	class DataError : public std::runtime_error
@@ -0,0 +1,174 @@
+#include <stdexcept>
+#include <algorithm>
+#include <fstream>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+
+#include <boost/filesystem.hpp>
+
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "file_utils.h"
+#include "error.h"
+
+namespace DataBase {
+
+	void sync_file(const std::string& file_name)
+	{
+#ifdef _WIN32
+		int fd = _open(file_name.c_str(), _O_RDWR);
+		if (fd < 0)
+			throw FileOpenError(file_name);
+		int res = _commit(fd);
+		_close(fd);
+#else
+		int fd = ::open(file_name.c_str(), O_RDONLY);
+		if (fd < 0)
+			throw FileOpenError(file_name);
+		int res = ::fsync(fd);
+		::close(fd);
+#endif
+		if (res != 0)
+			throw FileWriteError(file_name);
+	}
+
+	void sync_directory(const std::string& dir_name)
+	{
+#ifndef _WIN32
+		// в windows метаданные каталога фиксируются файловой системой самостоятельно
+		int fd = ::open(dir_name.c_str(), O_RDONLY);
+		if (fd < 0)
+			throw FileOpenError(dir_name);
+		int res = ::fsync(fd);
+		::close(fd);
+		if (res != 0)
+			throw FileWriteError(dir_name);
+#endif
+	}
+
+	std::string parent_directory(const std::string& file_name)
+	{
+		boost::filesystem::path parent = boost::filesystem::path(file_name).parent_path();
+		return parent.empty() ? std::string(".") : parent.string();
+	}
+
+	void rename_file(const std::string& from, const std::string& to)
+	{
+		boost::system::error_code ec;
+		boost::filesystem::rename(from, to, ec); // rename заменяет существующий файл атомарно
+		if (ec)
+			throw FileWriteError(to);
+		sync_directory(parent_directory(to));
+	}
+
+	void replace_file(const std::string& file_name, const std::string& content)
+	{
+		std::string tmp = file_name + ".tmp";
+		{
+			std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+			if (!out)
+				throw FileOpenError(tmp);
+			out << content;
+			out.close();
+			if (!out)
+				throw FileWriteError(tmp);
+		}
+		sync_file(tmp);
+		rename_file(tmp, file_name);
+	}
+
+	void write_chunks_parallel(size_t number_of_chunks, unsigned int num_threads,
+		const std::function<void(size_t, std::string&)>& build,
+		const std::function<void(size_t, const std::string&)>& write)
+	{
+		// без формирующих потоков запись ожидала бы первый фрагмент бесконечно
+		num_threads = std::max(num_threads, 1u);
+
+		struct slot {
+			std::string chunk;
+			bool        ready;
+			slot() : ready(false) {}
+		};
+		std::vector<slot> slots(number_of_chunks);
+
+		std::mutex mutex;
+		std::condition_variable cond;
+		size_t next = 0;         // номер следующего формируемого фрагмента
+		size_t written = 0;      // количество записанных фрагментов
+		bool failed = false;
+		const size_t window = 2 * num_threads; // максимальное количество сформированных, но не записанных фрагментов
+
+		auto worker = [&]() {
+			while (true) {
+				size_t i;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					cond.wait(lock, [&] { return failed || next >= number_of_chunks || next < written + window; });
+					if (failed || next >= number_of_chunks)
+						return;
+					i = next++;
+				}
+
+				std::string chunk;
+				try {
+					build(i, chunk);
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock(mutex);
+					failed = true;
+					cond.notify_all();
+					throw;
+				}
+
+				std::lock_guard<std::mutex> lock(mutex);
+				slots[i].chunk.swap(chunk);
+				slots[i].ready = true;
+				cond.notify_all();
+			}
+		};
+
+		std::vector<std::future<void> > futures(num_threads);
+		for (unsigned int i = 0; i < num_threads; ++i)
+			futures[i] = std::async(std::launch::async, worker);
+
+		try {
+			for (size_t i = 0; i < number_of_chunks; ++i) {
+				std::unique_lock<std::mutex> lock(mutex);
+				cond.wait(lock, [&] { return slots[i].ready || failed; });
+				if (failed)
+					break;
+				std::string chunk;
+				chunk.swap(slots[i].chunk);
+				lock.unlock();
+
+				write(i, chunk);
+
+				lock.lock();
+				written = i + 1;
+				cond.notify_all();
+			}
+		}
+		catch (...) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				failed = true;
+				cond.notify_all();
+			}
+			for (auto& f : futures)
+				f.wait();
+			throw;
+		}
+
+		// исключения, возникшие при формировании фрагментов, передаются вызывающему коду
+		for (auto& f : futures)
+			f.get();
+	}
+
+} // namespace DataBase
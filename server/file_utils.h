@@ -0,0 +1,38 @@
+#ifndef FILE_UTILS_H
+#define FILE_UTILS_H
+
+#include <string>
+#include <functional>
+
+namespace DataBase {
+
+	// Вспомогательные функции для надежной записи файлов базы данных на диск.
+	// Ошибки сообщаются исключениями FileOpenError и FileWriteError.
+
+	// сброс содержимого файла file_name на диск (fsync)
+	void sync_file(const std::string& file_name);
+
+	// сброс на диск каталога dir_name: фиксирует создание, удаление и переименование файлов в нем
+	void sync_directory(const std::string& dir_name);
+
+	// каталог, содержащий файл file_name ("." для имени без каталога)
+	std::string parent_directory(const std::string& file_name);
+
+	// атомарное переименование файла from в to с фиксацией каталога; существующий файл to заменяется
+	void rename_file(const std::string& from, const std::string& to);
+
+	// атомарная замена содержимого файла: запись во временный файл, fsync и переименование
+	void replace_file(const std::string& file_name, const std::string& content);
+
+	// Параллельное формирование фрагментов файла и их запись в порядке номеров.
+	// build(i, chunk) вызывается в num_threads потоках для каждого фрагмента i из [0, number_of_chunks);
+	// вызывающий поток передает готовые фрагменты в write(i, chunk) по возрастанию i. Количество сформированных,
+	// но еще не записанных фрагментов ограничено (2 * num_threads), поэтому объем занимаемой памяти не зависит
+	// от размера файла. Исключение build или write прекращает работу и передается вызывающему коду.
+	void write_chunks_parallel(size_t number_of_chunks, unsigned int num_threads,
+		const std::function<void(size_t, std::string&)>& build,
+		const std::function<void(size_t, const std::string&)>& write);
+
+} // namespace DataBase
+
+#endif // FILE_UTILS_H
@@ -0,0 +1,137 @@
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <chrono>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "fork_save.h"
+#include "error.h"
+#include "../lib/timer.h"
+
+namespace DataBase {
+
+	namespace {
+		// сообщение дочернего процесса; размер меньше PIPE_BUF, поэтому оно записывается в канал атомарно
+		struct child_result {
+			int32_t  success;
+			uint64_t records;
+			double   time;
+			char     message[512];
+		};
+
+		// интервал измерения памяти родительского процесса во время сохранения
+		const std::chrono::milliseconds sample_interval(20);
+	}
+
+	unsigned long long private_memory_bytes()
+	{
+		std::ifstream in("/proc/self/smaps_rollup");
+		std::string name;
+		unsigned long long value, bytes = 0;
+		std::getline(in, name);   // первая строка - диапазон адресов
+		while (in >> name >> value) {
+			if (name == "Private_Clean:" || name == "Private_Dirty:")
+				bytes += value * 1024;
+			in.ignore(64, '\n');   // единица измерения (kB)
+		}
+		return bytes;
+	}
+
+	forked_save::forked_save(const std::function<unsigned long()>& task) : pid(-1), fd(-1), fork_time(0), private_bytes(0), finished(false)
+	{
+		int fds[2];
+		if (::pipe2(fds, O_CLOEXEC) != 0)
+			throw ChildProcessError("Can not create a pipe for the save process: " + std::string(std::strerror(errno)) + ".");
+
+		Timer t;
+		pid = ::fork();
+		if (pid < 0) {
+			int error = errno;
+			::close(fds[0]);
+			::close(fds[1]);
+			throw ChildProcessError("Can not fork the save process: " + std::string(std::strerror(error)) + ".");
+		}
+
+		if (pid == 0) {
+			// дочерний процесс: деструкторы и обработчики atexit родительского процесса не выполняются
+			::close(fds[0]);
+			child_result result;
+			std::memset(&result, 0, sizeof(result));
+			Timer child;
+			try {
+				result.records = task();
+				result.success = 1;
+			}
+			catch (std::exception& e) {
+				std::strncpy(result.message, e.what(), sizeof(result.message) - 1);
+			}
+			catch (...) {
+				std::strncpy(result.message, "Unknown error.", sizeof(result.message) - 1);
+			}
+			result.time = child.elapsed();
+			ssize_t n = ::write(fds[1], &result, sizeof(result));
+			::_exit((result.success && n == (ssize_t)sizeof(result)) ? 0 : 1);
+		}
+
+		fork_time = t.elapsed();
+		::close(fds[1]);
+		fd = fds[0];
+		private_bytes = private_memory_bytes();
+	}
+
+	forked_save::~forked_save()
+	{
+		if (!finished && pid > 0) {
+			int status;
+			while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+		}
+		if (fd >= 0)
+			::close(fd);
+	}
+
+	forked_save_stats forked_save::wait()
+	{
+		forked_save_stats stats;
+		stats.fork_time = fork_time;
+		stats.cow_bytes = 0;
+
+		// пока дочерний процесс работает, страницы, измененные родительским процессом, становятся его собственными
+		int status = 0;
+		for (;;) {
+			pid_t r = ::waitpid(pid, &status, WNOHANG);
+			if (r == pid)
+				break;
+			if (r < 0 && errno != EINTR) {
+				finished = true;
+				throw ChildProcessError("Can not wait for the save process: " + std::string(std::strerror(errno)) + ".");
+			}
+			unsigned long long bytes = private_memory_bytes();
+			if (bytes > private_bytes)
+				stats.cow_bytes = std::max(stats.cow_bytes, bytes - private_bytes);
+			std::this_thread::sleep_for(sample_interval);
+		}
+		finished = true;
+
+		child_result result;
+		ssize_t n;
+		while ((n = ::read(fd, &result, sizeof(result))) < 0 && errno == EINTR) {}
+
+		if (n != (ssize_t)sizeof(result)) {
+			if (WIFSIGNALED(status))
+				throw ChildProcessError("The save process was terminated by signal " + std::to_string(WTERMSIG(status)) + ".");
+			throw ChildProcessError("The save process exited without a result.");
+		}
+		if (!result.success)
+			throw ChildProcessError(result.message);
+
+		stats.records = (unsigned long)result.records;
+		stats.child_time = result.time;
+		return stats;
+	}
+
+} // namespace DataBase
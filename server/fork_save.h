@@ -0,0 +1,50 @@
+#ifndef FORK_SAVE_H
+#define FORK_SAVE_H
+
+#include <string>
+#include <functional>
+
+#include <sys/types.h>
+
+namespace DataBase {
+
+	// результаты сохранения базы данных в дочернем процессе
+	struct forked_save_stats {
+		unsigned long records;           // количество сохраненных записей
+		double fork_time;                // время вызова fork() (на это время приостанавливаются операции записи), мс
+		double child_time;               // время сохранения в дочернем процессе, мс
+		unsigned long long cow_bytes;    // наибольший прирост памяти родительского процесса, скопированной при записи, байт
+	};
+
+	// Сохранение в дочернем процессе. Конструктор вызывает fork(): дочерний процесс получает копию памяти
+	// родительского процесса в состоянии на момент fork() (страницы копируются ядром только при изменении - copy-on-write),
+	// выполняет task, передает результат родительскому процессу через канал и завершается вызовом _exit.
+	// Родительский процесс продолжает работу; wait() ожидает завершения дочернего процесса и измеряет рост
+	// собственной (не разделяемой с дочерним процессом) памяти родительского процесса.
+	// Вызывающая сторона отвечает за то, чтобы во время fork() ни один поток не удерживал блокировки,
+	// которые понадобятся task: в дочернем процессе существует только поток, вызвавший fork().
+	class forked_save {
+	public:
+		explicit forked_save(const std::function<unsigned long()>& task);
+		~forked_save();
+
+		forked_save(const forked_save&) = delete;
+		forked_save& operator=(const forked_save&) = delete;
+
+		// ожидание завершения дочернего процесса; при ошибке сохранения генерируется исключение ChildProcessError
+		forked_save_stats wait();
+
+	private:
+		pid_t pid;
+		int fd;                          // канал результата (чтение)
+		double fork_time;
+		unsigned long long private_bytes;  // собственная память родительского процесса сразу после fork()
+		bool finished;
+	};
+
+	// собственная память процесса (Private_Clean + Private_Dirty из /proc/self/smaps_rollup), байт; 0, если недоступно
+	unsigned long long private_memory_bytes();
+
+} // namespace DataBase
+
+#endif // FORK_SAVE_H
@@ -0,0 +1,428 @@
+#include <stdexcept>
+#include <fstream>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+
+#include <boost/filesystem.hpp>
+
+#include "generator.h"
+#include "hash.h"
+#include "checkpoint.h"
+#include "file_utils.h"
+#include "error.h"
+#include "../lib/csv.h"
+
+namespace DataBase {
+
+	namespace {
+		// примерный размер фрагмента файла, формируемого одним потоком
+		const unsigned long long chunk_bytes = 4 << 20;
+
+		// средний размер строки csv (номер, фамилия, имя, отчество и признак активности) для выбора числа сегментов фрагмента
+		const unsigned long long average_row_bytes = 64;
+
+		// наибольшее количество сегментов во фрагменте (и в блоке снимка)
+		const unsigned int max_buckets_per_chunk = 16;
+
+		// Веса закона Ципфа 1/rank^exponent для n значений. Ранги назначаются фиксированной перестановкой
+		// (по хешу индекса и salt), поэтому частые значения не зависят от порядка строк файла
+		// (списки имен упорядочены по алфавиту), от номеров соседних сегментов и от seed.
+		std::vector<double> zipf_weights(size_t n, double exponent, uint64_t salt)
+		{
+			std::vector<double> weights(n, 1.0);
+			if (exponent == 0)
+				return weights;
+
+			std::vector<std::pair<uint64_t, uint32_t> > order(n);
+			for (size_t i = 0; i < n; ++i) {
+				uint64_t state = salt ^ ((uint64_t)i * 0xD1B54A32D192ED03ULL);
+				order[i] = std::make_pair(xoshiro256pp::splitmix64(state), (uint32_t)i);
+			}
+			std::sort(order.begin(), order.end());
+			for (size_t rank = 0; rank < n; ++rank)
+				weights[order[rank].second] = std::pow((double)(rank + 1), -exponent);
+			return weights;
+		}
+
+		// Распределение count записей по сегментам пропорционально весам, не более capacity записей в сегменте.
+		// Сегменты, доля которых не меньше capacity, заполняются полностью, а остаток распределяется между
+		// остальными; доли округляются накопленной суммой, поэтому сумма по сегментам точно равна count.
+		void apportion(const std::vector<double>& weights, unsigned long long count, unsigned int capacity,
+			std::vector<unsigned int>& result)
+		{
+			const size_t n = weights.size();
+			result.assign(n, 0);
+			std::vector<char> full(n, 0);
+			unsigned long long remaining = count;
+			long double sum;
+
+			for (;;) {
+				sum = 0;
+				for (size_t i = 0; i < n; ++i)
+					if (!full[i])
+						sum += weights[i];
+				if (remaining == 0 || sum <= 0)
+					break;
+
+				// при заполнении сегмента доли остальных только растут, поэтому переполненные сегменты
+				// одного прохода заполняются одновременно
+				bool overflow = false;
+				for (size_t i = 0; i < n; ++i)
+					if (!full[i] && weights[i] / sum * remaining >= capacity) {
+						full[i] = 1;
+						result[i] = capacity;
+						remaining -= capacity;
+						overflow = true;
+					}
+				if (!overflow)
+					break;
+			}
+			if (remaining == 0)
+				return;
+			if (sum <= 0)
+				throw std::invalid_argument("Generator: the prefix densities leave no room for the records.");
+
+			long double cumulative = 0;
+			unsigned long long assigned = 0;
+			for (size_t i = 0; i < n; ++i) {
+				if (full[i])
+					continue;
+				cumulative += weights[i];
+				unsigned long long end = std::min(remaining, (unsigned long long)(cumulative / sum * remaining));
+				result[i] = (unsigned int)std::min<unsigned long long>(capacity, end - std::min(end, assigned));
+				assigned += result[i];
+			}
+
+			// остаток из-за погрешности округления добавляется к сегментам по порядку
+			for (size_t i = 0; assigned < remaining; i = (i + 1) % n)
+				if (!full[i] && weights[i] > 0 && result[i] < capacity) {
+					++result[i];
+					++assigned;
+				}
+		}
+
+		void append_csv_row(std::string& chunk, const char* number, size_t number_length, const generated_record& rec)
+		{
+			chunk.append(number, number_length);
+			chunk += ", ";
+			chunk.append(rec.last_name.data(), rec.last_name.size());
+			chunk += ", ";
+			chunk.append(rec.first_name.data(), rec.first_name.size());
+			chunk += ", ";
+			chunk.append(rec.patronymic.data(), rec.patronymic.size());
+			chunk += rec.activity ? ", 1\n" : ", 0\n";
+		}
+	}
+
+	name_dictionary read_name_file(const std::string& file_name)
+	{
+		name_dictionary dictionary;
+
+		// открытие базы имен, фамилий или отчеств,
+		// в случае неуспеха генерируется исключение.
+		try {
+			io::CSVReader<1> in(file_name); // инициализация ридера
+
+			char* name;
+			while (in.read_row(name))
+				dictionary.push_back(name);
+		}
+		catch (...) {
+			// ошибка чтения файла, генерируется исключение
+			throw FileReadError(file_name);
+		}
+
+		if (dictionary.empty())
+			throw FileCorruptError(file_name, "список имен пуст");
+		return dictionary;
+	}
+
+	name_lists name_lists::load(
+		const std::string& last_name_male_file,  const std::string& last_name_female_file,
+		const std::string& first_name_male_file, const std::string& first_name_female_file,
+		const std::string& patronymic_male_file, const std::string& patronymic_female_file)
+	{
+		name_lists names;
+		names.last_names[0]  = read_name_file(last_name_male_file);
+		names.last_names[1]  = read_name_file(last_name_female_file);
+		names.first_names[0] = read_name_file(first_name_male_file);
+		names.first_names[1] = read_name_file(first_name_female_file);
+		names.patronymics[0] = read_name_file(patronymic_male_file);
+		names.patronymics[1] = read_name_file(patronymic_female_file);
+		return names;
+	}
+
+	std::shared_ptr<const name_lists> name_lists_cache::get()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!lists)
+			lists = std::make_shared<const name_lists>(name_lists::load());
+		return lists;
+	}
+
+	uint64_t random_seed()
+	{
+		std::random_device rd;
+		return ((uint64_t)rd() << 32) ^ rd();
+	}
+
+	uint64_t bucket_seed(uint64_t seed, unsigned int bucket)
+	{
+		// номер сегмента - счетчик: соседние номера разносятся умножением на нечетную константу
+		// и перемешиваются шагом splitmix64, поэтому последовательности сегментов независимы
+		uint64_t state = seed ^ ((uint64_t)bucket * 0xD1B54A32D192ED03ULL);
+		return xoshiro256pp::splitmix64(state);
+	}
+
+	void generation_profile::validate() const
+	{
+		if (!(active_ratio >= 0 && active_ratio <= 1))
+			throw std::invalid_argument("Generator: the active ratio must be in [0, 1].");
+		if (!(name_zipf >= 0 && name_zipf <= 16) || !(prefix_zipf >= 0 && prefix_zipf <= 16))
+			throw std::invalid_argument("Generator: the Zipf exponent must be in [0, 16].");
+		for (auto& entry : prefix_densities) {
+			if (entry.prefix.empty() || entry.prefix.find_first_not_of("0123456789") != std::string::npos)
+				throw std::invalid_argument("Generator: invalid prefix '" + entry.prefix + "'.");
+			if (!(entry.density >= 0 && entry.density < 1e300))
+				throw std::invalid_argument("Generator: invalid density of prefix '" + entry.prefix + "'.");
+		}
+	}
+
+	std::vector<prefix_density> generation_profile::load_prefix_densities(const std::string& file_name)
+	{
+		std::ifstream in(file_name);
+		if (!in)
+			throw FileOpenError(file_name);
+
+		std::vector<prefix_density> densities;
+		std::string line;
+		unsigned long line_number = 0;
+		while (std::getline(in, line)) {
+			++line_number;
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			if (line.empty() || line[0] == '#')
+				continue;
+			std::string::size_type comma = line.find(',');
+			try {
+				if (comma == std::string::npos)
+					throw std::invalid_argument("no comma");
+				prefix_density entry = { line.substr(0, comma), std::stod(line.substr(comma + 1)) };
+				densities.push_back(entry);
+			}
+			catch (std::logic_error&) {
+				throw FileCorruptError(file_name, "строка " + std::to_string(line_number) + ", ожидается <префикс>,<плотность>");
+			}
+		}
+		return densities;
+	}
+
+	generation_model::generation_model(const name_lists& names, const generation_profile& profile,
+		unsigned long long num_records, int number_of_first_digits, int number_of_second_digits) :
+		names(names), number_of_suffixes(1)
+	{
+		profile.validate();
+
+		unsigned int buckets = 1;
+		for (int i = 0; i < number_of_first_digits; ++i)
+			buckets *= 10;
+		for (int i = 0; i < number_of_second_digits; ++i)
+			number_of_suffixes *= 10;
+		if (num_records > (unsigned long long)buckets * number_of_suffixes)
+			throw std::invalid_argument("Generator: the number of records exceeds the number of phone numbers.");
+
+		// у каждого списка своя перестановка рангов
+		for (int sex = 0; sex < 2; ++sex) {
+			last_names[sex]  = alias_table(zipf_weights(names.last_names[sex].size(),  profile.name_zipf, 1 + sex));
+			first_names[sex] = alias_table(zipf_weights(names.first_names[sex].size(), profile.name_zipf, 3 + sex));
+			patronymics[sex] = alias_table(zipf_weights(names.patronymics[sex].size(), profile.name_zipf, 5 + sex));
+		}
+
+		active_threshold = (uint64_t)(profile.active_ratio * 4294967296.0);
+
+		if (profile.prefix_zipf == 0 && profile.prefix_densities.empty()) {
+			bucket_records.resize(buckets);
+			for (unsigned int bucket = 0; bucket < buckets; ++bucket)
+				bucket_records[bucket] = DataBase::records_in_bucket(num_records, buckets, bucket);
+			return;
+		}
+
+		// плотность сегмента задается самым длинным из содержащих его префиксов
+		std::vector<prefix_density> densities = profile.prefix_densities;
+		std::stable_sort(densities.begin(), densities.end(), [](const prefix_density& a, const prefix_density& b) {
+			return a.prefix.size() < b.prefix.size();
+		});
+		std::vector<double> weights = zipf_weights(buckets, profile.prefix_zipf, 7);
+		std::vector<double> density(buckets, 1.0);
+		for (auto& entry : densities) {
+			if (entry.prefix.size() > (size_t)number_of_first_digits)
+				throw std::invalid_argument("Generator: prefix '" + entry.prefix + "' is longer than the first part of the number.");
+			unsigned int scale = 1;
+			for (size_t i = entry.prefix.size(); i < (size_t)number_of_first_digits; ++i)
+				scale *= 10;
+			unsigned int first = (unsigned int)std::stoul(entry.prefix) * scale;
+			std::fill(density.begin() + first, density.begin() + first + scale, entry.density);
+		}
+		for (unsigned int bucket = 0; bucket < buckets; ++bucket)
+			weights[bucket] *= density[bucket];
+
+		apportion(weights, num_records, number_of_suffixes, bucket_records);
+	}
+
+	record_generator::record_generator(const generation_model& model, uint64_t seed) :
+		model(model), seed(seed), random(seed), sampler(model.number_of_suffixes)
+	{
+	}
+
+	void record_generator::generate_bucket(unsigned int bucket, std::vector<generated_record>& records)
+	{
+		random = xoshiro256pp(bucket_seed(seed, bucket));
+		sampler.sample(random, model.records_in_bucket(bucket), suffixes);
+
+		const name_lists& names = model.names;
+		records.resize(suffixes.size());
+		uint64_t bits = 0;
+		for (size_t i = 0; i < suffixes.size(); ++i) {
+			// пол - по одному биту 64-разрядного числа
+			if (i % 64 == 0)
+				bits = random();
+			int sex = (int)(bits & 1);
+			bits >>= 1;
+
+			generated_record& rec = records[i];
+			rec.suffix = suffixes[i];
+			rec.activity = (random() >> 32) < model.active_threshold;
+			rec.last_name  = names.last_names[sex][model.last_names[sex](random)];
+			rec.first_name = names.first_names[sex][model.first_names[sex](random)];
+			rec.patronymic = names.patronymics[sex][model.patronymics[sex](random)];
+		}
+	}
+
+	unsigned int records_in_bucket(unsigned long long count, unsigned int number_of_buckets, unsigned int position)
+	{
+		unsigned long long integer_part = count / number_of_buckets;
+		unsigned long long remainder = count - integer_part * number_of_buckets;
+		return (unsigned int)(integer_part
+			+ ((unsigned long long)(position + 1) * remainder / number_of_buckets - (unsigned long long)position * remainder / number_of_buckets));
+	}
+
+	generated_file_format parse_generated_file_format(const std::string& format)
+	{
+		if (format == "csv")      return generated_file_format::csv;
+		if (format == "snapshot") return generated_file_format::snapshot;
+		throw std::invalid_argument("Generator: unknown file format '" + format + "'. Use csv or snapshot.");
+	}
+
+	generated_file_stats generate_file(const std::string& file_name, generated_file_format format,
+		unsigned long long num_records, unsigned int num_threads, const name_lists& names, uint64_t seed,
+		const generation_profile& profile, block_compression compression, int number_of_first_digits, int number_of_second_digits)
+	{
+		if (num_threads == 0)
+			num_threads = 1;
+
+		DefaultHash<std::string> hasher(number_of_first_digits, number_of_second_digits);
+		const generation_model model(names, profile, num_records, number_of_first_digits, number_of_second_digits);
+		const unsigned int number_of_buckets = model.number_of_buckets();
+
+		// фрагмент - последовательные сегменты общим объемом около chunk_bytes (при неравномерной заполненности
+		// сегментов границы фрагментов определяются количеством записей сегментов модели)
+		std::vector<unsigned int> chunk_begin(1, 0);
+		unsigned long long bytes_in_chunk = 0;
+		for (unsigned int bucket = 0; bucket < number_of_buckets; ++bucket) {
+			if (bucket - chunk_begin.back() == max_buckets_per_chunk || bytes_in_chunk >= chunk_bytes) {
+				chunk_begin.push_back(bucket);
+				bytes_in_chunk = 0;
+			}
+			bytes_in_chunk += (unsigned long long)model.records_in_bucket(bucket) * average_row_bytes;
+		}
+		const size_t number_of_chunks = chunk_begin.size();
+		chunk_begin.push_back(number_of_buckets);
+
+		// генерация записей сегментов фрагмента i; consume(bucket, records) получает записи каждого сегмента
+		auto generate_chunk = [&](size_t i, unsigned int& first_bucket, unsigned int& end_bucket,
+			const std::function<void(unsigned int, const std::vector<generated_record>&)>& consume) {
+			first_bucket = chunk_begin[i];
+			end_bucket = chunk_begin[i + 1];
+
+			// каждый сегмент генерируется собственной последовательностью случайных чисел,
+			// поэтому содержимое фрагмента не зависит от того, какой поток его формирует
+			record_generator generator(model, seed);
+			std::vector<generated_record> records;
+			for (unsigned int bucket = first_bucket; bucket != end_bucket; ++bucket) {
+				generator.generate_bucket(bucket, records);
+				consume(bucket, records);
+			}
+		};
+
+		generated_file_stats stats = { 0, 0 };
+
+		if (format == generated_file_format::snapshot) {
+			snapshot_writer writer(file_name, number_of_first_digits, number_of_second_digits);
+			write_blocks_parallel(writer, number_of_chunks, num_threads, [&](size_t i, block_header& header, std::string& stored) {
+				std::string raw;
+				unsigned long records = 0;
+				generate_chunk(i, header.first_bucket, header.end_bucket, [&](unsigned int bucket, const std::vector<generated_record>& recs) {
+					for (auto& rec : recs)
+						append_row(raw, bucket, rec.suffix, rec.activity, rec.last_name, rec.first_name, rec.patronymic);
+					records += (unsigned long)recs.size();
+				});
+				header.records = (uint32_t)records;
+				stored = encode_block(raw, compression, header);
+			});
+			writer.close();
+			stats.records = num_records;
+			stats.bytes = writer.bytes_written();
+			return stats;
+		}
+
+		// csv: один файл, загружаемый по манифесту в любом числе потоков
+		std::string temporary_name = save_temporary_name(file_name);
+		std::ofstream out(temporary_name, std::ios::binary);
+		if (!out)
+			throw FileOpenError(temporary_name);
+
+		try {
+			write_chunks_parallel(number_of_chunks, num_threads, [&](size_t i, std::string& chunk) {
+				chunk.reserve(chunk_bytes + chunk_bytes / 4);
+				char number[DefaultHash<std::string>::max_number_length];
+				unsigned int first_bucket, end_bucket;
+				generate_chunk(i, first_bucket, end_bucket, [&](unsigned int bucket, const std::vector<generated_record>& recs) {
+					for (auto& rec : recs)
+						append_csv_row(chunk, number, hasher.unhash((int)bucket, rec.suffix, number) - number, rec);
+				});
+			}, [&](size_t, const std::string& chunk) {
+				if (!out.write(chunk.data(), chunk.size()))
+					throw FileWriteError(temporary_name);
+			});
+
+			out.close();
+			if (!out)
+				throw FileWriteError(temporary_name);
+			sync_file(temporary_name);
+		}
+		catch (...) {
+			out.close();
+			boost::system::error_code ec;
+			boost::filesystem::remove(temporary_name, ec);
+			throw;
+		}
+
+		save_manifest manifest;
+		manifest.number_of_buckets = number_of_buckets;
+		save_manifest::piece piece;
+		piece.file = boost::filesystem::path(file_name).filename().string();
+		piece.bytes = boost::filesystem::file_size(temporary_name);
+		piece.records = (unsigned long)num_records;
+		piece.first_bucket = 0;
+		piece.end_bucket = number_of_buckets;
+		manifest.pieces.push_back(piece);
+		commit_save_snapshot(file_name, manifest, 0);
+
+		stats.records = num_records;
+		stats.bytes = piece.bytes;
+		return stats;
+	}
+
+} // namespace DataBase
@@ -0,0 +1,186 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include <boost/utility/string_view.hpp>
+
+#include "random.h"
+#include "snapshot.h"
+
+namespace DataBase {
+
+	// Неизменяемый словарь имен, фамилий или отчеств: строки хранятся подряд в одном буфере,
+	// i-я строка занимает [offsets[i], offsets[i + 1]). Выбор строки - два обращения к памяти без разыменования
+	// указателей, словарь из десятков тысяч строк занимает один блок памяти вместо отдельной строки на имя.
+	class name_dictionary {
+	public:
+		name_dictionary() : offsets(1, 0) {}
+
+		void push_back(boost::string_view name)
+		{
+			pool.append(name.data(), name.size());
+			offsets.push_back((uint32_t)pool.size());
+		}
+
+		size_t size() const { return offsets.size() - 1; }
+		bool empty() const { return offsets.size() == 1; }
+
+		boost::string_view operator[](size_t i) const
+		{
+			return boost::string_view(pool.data() + offsets[i], offsets[i + 1] - offsets[i]);
+		}
+
+	private:
+		std::string pool;
+		std::vector<uint32_t> offsets;
+	};
+
+	// чтение базы данных имен, фамилий или отчеств из файла csv (по одному значению в строке);
+	// ошибка сообщается исключениями FileReadError и FileCorruptError (пустой список)
+	name_dictionary read_name_file(const std::string& file_name);
+
+	// списки фамилий, имен и отчеств для генерации абонентов: индекс 0 - мужские, 1 - женские
+	struct name_lists {
+		name_dictionary last_names[2];
+		name_dictionary first_names[2];
+		name_dictionary patronymics[2];
+
+		static name_lists load(
+			const std::string& last_name_male_file    = "last_name_male.csv",
+			const std::string& last_name_female_file  = "last_name_female.csv",
+			const std::string& first_name_male_file   = "first_name_male.csv",
+			const std::string& first_name_female_file = "first_name_female.csv",
+			const std::string& patronymic_male_file   = "patronymic_male.csv",
+			const std::string& patronymic_female_file = "patronymic_female.csv");
+	};
+
+	// Списки имен, загружаемые один раз на время работы сервера: первый успешный вызов get() читает файлы
+	// текущего каталога, последующие возвращают те же неизменяемые списки без обращения к диску.
+	// Ошибка чтения сообщается исключением и повторяется при следующем вызове.
+	class name_lists_cache {
+	public:
+		std::shared_ptr<const name_lists> get();
+
+	private:
+		std::mutex mutex;
+		std::shared_ptr<const name_lists> lists;
+	};
+
+	// случайное начальное значение генерации (std::random_device) для запросов без параметра Seed
+	uint64_t random_seed();
+
+	// Начальное значение последовательности случайных чисел сегмента bucket: последовательность определяется
+	// только парой (seed, bucket), поэтому результат генерации не зависит от числа потоков и порядка обхода сегментов.
+	uint64_t bucket_seed(uint64_t seed, unsigned int bucket);
+
+	// плотность номеров сегментов, первые цифры которых начинаются с prefix (без "8")
+	struct prefix_density {
+		std::string prefix;
+		double density;
+	};
+
+	// Распределения генерируемых данных. По умолчанию записи распределяются по сегментам равномерно,
+	// имена выбираются равновероятно, активна половина абонентов.
+	struct generation_profile {
+		double active_ratio = 0.5;   // доля активных абонентов
+		double name_zipf = 0;        // показатель закона Ципфа частот фамилий, имен и отчеств (0 - равновероятно)
+		double prefix_zipf = 0;      // показатель закона Ципфа заполненности сегментов (0 - равномерно)
+		std::vector<prefix_density> prefix_densities;  // относительные плотности префиксов (сегменты без префикса - 1)
+
+		// проверка параметров; ошибка сообщается исключением std::invalid_argument
+		void validate() const;
+
+		// чтение плотностей префиксов из файла: строки "<префикс>,<плотность>", '#' - комментарий;
+		// ошибка сообщается исключениями FileOpenError и FileCorruptError
+		static std::vector<prefix_density> load_prefix_densities(const std::string& file_name);
+	};
+
+	// Модель генерации, общая для всех потоков: списки имен, таблицы псевдонимов для выбора имен
+	// и количество записей каждого сегмента. Количество записей распределяется по сегментам пропорционально
+	// весам (плотность префикса, умноженная на вес Ципфа) методом наибольших остатков, сегмент вмещает
+	// не более number_of_suffixes записей; сумма по сегментам равна num_records.
+	class generation_model {
+	public:
+		generation_model(const name_lists& names, const generation_profile& profile, unsigned long long num_records,
+			int number_of_first_digits, int number_of_second_digits);
+
+		const name_lists& names;
+
+		// выбор фамилии, имени и отчества пола sex
+		alias_table last_names[2], first_names[2], patronymics[2];
+
+		// порог признака активности: абонент активен, если старшие 32 бита случайного числа меньше порога
+		uint64_t active_threshold;
+
+		uint32_t number_of_suffixes;
+
+		unsigned int number_of_buckets() const { return (unsigned int)bucket_records.size(); }
+		unsigned int records_in_bucket(unsigned int bucket) const { return bucket_records[bucket]; }
+
+	private:
+		std::vector<unsigned int> bucket_records;
+	};
+
+	// сгенерированная запись сегмента; строки принадлежат спискам имен name_lists
+	struct generated_record {
+		uint32_t suffix;                 // вторая часть номера
+		bool activity;
+		boost::string_view last_name;
+		boost::string_view first_name;
+		boost::string_view patronymic;
+	};
+
+	// Генератор записей сегментов: вторые части номеров сегмента выбираются без повторов алгоритмом Флойда,
+	// пол - равновероятно, фамилия, имя, отчество и признак активности - по распределениям модели.
+	// Генератор используется одним потоком.
+	class record_generator {
+	public:
+		record_generator(const generation_model& model, uint64_t seed);
+
+		// записи сегмента bucket (model.records_in_bucket(bucket)) с различными вторыми частями номера по возрастанию;
+		// записи сегмента генерируются собственной последовательностью bucket_seed(seed, bucket)
+		void generate_bucket(unsigned int bucket, std::vector<generated_record>& records);
+
+	private:
+		const generation_model& model;
+		uint64_t seed;
+		xoshiro256pp random;
+		unique_sampler sampler;
+		std::vector<uint32_t> suffixes;
+	};
+
+	// Количество записей сегмента position при равномерном распределении count записей по number_of_buckets
+	// сегментам: каждому сегменту достается целая часть частного, остаток распределяется по сегментам равномерно.
+	unsigned int records_in_bucket(unsigned long long count, unsigned int number_of_buckets, unsigned int position);
+
+	// формат файла генерации: csv - как у /save (с манифестом из одного файла), snapshot - блочный снимок
+	enum class generated_file_format { csv, snapshot };
+
+	// преобразование строкового представления ("csv", "snapshot") в generated_file_format
+	generated_file_format parse_generated_file_format(const std::string& format);
+
+	struct generated_file_stats {
+		unsigned long long records;      // количество записей
+		unsigned long long bytes;        // размер файла
+	};
+
+	// Генерация num_records записей непосредственно в файл file_name без размещения базы данных в памяти.
+	// Потоки генерируют диапазоны сегментов и форматируют их во фрагменты файла, которые записываются
+	// по порядку; объем памяти ограничен несколькими фрагментами на поток, поэтому размер файла
+	// может превышать объем оперативной памяти. Файл записывается во временный файл и переименовывается
+	// после сброса на диск; полученный файл загружается /load (csv) или /load с Mode=snapshot.
+	// При одинаковом seed файл совпадает побайтно при любом num_threads и содержит те же записи, что /generate.
+	generated_file_stats generate_file(const std::string& file_name, generated_file_format format,
+		unsigned long long num_records, unsigned int num_threads, const name_lists& names, uint64_t seed,
+		const generation_profile& profile = generation_profile(),
+		block_compression compression = block_compression::zlib,
+		int number_of_first_digits = 4, int number_of_second_digits = 6);
+
+} // namespace DataBase
+
+#endif // GENERATOR_H
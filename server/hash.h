@@ -4,26 +4,119 @@
 #include <stdexcept>
 #include <utility>
 #include <string>
+#include <cstring>
+#include <cstdint>
+
+#include <boost/utility/string_view.hpp>
+
+#include "numbering_plan.h"
 
 namespace DataBase {
+
+    // Ключ записи внутри сегмента: для номеров "8" + 10 цифр - последние mNumBuckets_in цифр,
+    // для международных номеров - компактный ключ нумерационного плана (numbering_plan.h).
+    typedef uint64_t number_key;
+
+    // сегмент и ключ записи, соответствующие номеру телефона
+    typedef std::pair<int, number_key> number_index;
+
+    // таблица двузначных чисел "00", "01", ..., "99" для вывода чисел по две цифры
+    inline const char* two_digit_table()
+    {
+        static const char table[201] =
+            "0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+            "5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+        return table;
+    }
+
+    // Запись младших digits цифр value (с ведущими нулями) в позиции [end - digits, end) по две цифры за шаг.
+    inline void write_digits(char* end, unsigned int value, int digits)
+    {
+        const char* table = two_digit_table();
+        for (; digits >= 2; digits -= 2) {
+            const char* pair = table + (value % 100) * 2;
+            end -= 2;
+            end[0] = pair[0];
+            end[1] = pair[1];
+            value /= 100;
+        }
+        if (digits)
+            *--end = (char)('0' + value % 10);
+    }
+
+    // Запись номера телефона "8" + first_number (first_digits цифр) + second_number (second_digits цифр) в buffer
+    // без выделения памяти и завершающего нуля. Возвращает указатель на символ, следующий за номером.
+    inline char* format_number(char* buffer, unsigned int first_number, unsigned int second_number, int first_digits, int second_digits)
+    {
+        buffer[0] = '8';
+        write_digits(buffer + 1 + first_digits, first_number, first_digits);
+        write_digits(buffer + 1 + first_digits + second_digits, second_number, second_digits);
+        return buffer + 1 + first_digits + second_digits;
+    }
     
     // шаблон хэш-функции
     template <typename T>
     class DefaultHash
     {
         public:
-            DefaultHash(int mNumBuckets_ex, int mNumBuckets_in);
-            std::pair<int,int> hash(const T& key) const;
-            T unhash(const int& ex_index, const int& it_index);
+            // Номера "8" + 10 цифр занимают сегменты [0, 10^mNumBuckets_ex), международные номера E.164
+            // (с '+' или без него) - следующие plan.number_of_buckets() сегментов.
+            DefaultHash(int mNumBuckets_ex, int mNumBuckets_in, const numbering_plan& plan = numbering_plan());
+            number_index hash(const T& key) const;
+            T unhash(const int& ex_index, const number_key& it_index);
+
+            // длина номера телефона: "8" и 10 цифр
+            static const size_t number_length = 11;
+
+            // наибольшая длина номера: '+' и numbering_plan::max_digits цифр
+            static const size_t max_number_length = 16;
+
+            // Запись номера телефона в buffer из max_number_length символов (без завершающего нуля) без выделения памяти.
+            // Возвращает указатель на символ, следующий за номером.
+            char* unhash(int ex_index, number_key it_index, char* buffer) const
+            {
+                if (ex_index < mDomesticBuckets)
+                    return format_number(buffer, ex_index, (unsigned int)it_index, mNumBuckets_ex, mNumBuckets_in);
+                return numbering_plan::decode(it_index, buffer);
+            }
+
+            // хэш ключа, заданного string_view (без создания копии ключа); определен для T = std::string
+            number_index hash(boost::string_view key) const;
+
+            // Пакетное вычисление хэшей count ключей keys в indices. Возвращает количество преобразованных ключей:
+            // при недопустимом ключе преобразование прекращается, и возвращается его индекс (исключение не генерируется).
+            size_t hash(const boost::string_view* keys, size_t count, number_index* indices) const;
+
+            // общее количество сегментов и количество сегментов номеров "8" + 10 цифр
+            int number_of_buckets() const { return mDomesticBuckets + (int)mPlan.number_of_buckets(); }
+            int number_of_domestic_buckets() const { return mDomesticBuckets; }
+
+            const numbering_plan& plan() const { return mPlan; }
+
+            // проверка, что ключ it_index может находиться в сегменте ex_index (при загрузке снимка)
+            bool valid_index(int ex_index, number_key it_index) const
+            {
+                if (ex_index < 0 || ex_index >= number_of_buckets())
+                    return false;
+                if (ex_index < mDomesticBuckets)
+                    return it_index < mDivisor_in;
+                return mPlan.valid(ex_index - mDomesticBuckets, it_index);
+            }
 
         private:
             int mNumBuckets_ex;
             int mNumBuckets_in;
+            unsigned long long mDivisor_in;   // 10 в степени mNumBuckets_in
+            int mDomesticBuckets;             // 10 в степени mNumBuckets_ex
+            numbering_plan mPlan;
+
+            // проверка и преобразование ключа; возвращает false для недопустимого ключа
+            bool parse(boost::string_view key, number_index& index) const;
     };
 
     // реализация конструктора хэша
     template <typename T>
-    DefaultHash<T>::DefaultHash(int NumBuckets_ex, int NumBuckets_in)
+    DefaultHash<T>::DefaultHash(int NumBuckets_ex, int NumBuckets_in, const numbering_plan& plan) : mPlan(plan)
     {
         if (NumBuckets_ex < 1 || NumBuckets_in < 1) {
             throw (std::invalid_argument("DefaultHash: the value of numBuckets must be greater than 10."));
@@ -37,12 +130,42 @@ namespace DataBase {
 
         mNumBuckets_ex = NumBuckets_ex;
         mNumBuckets_in = NumBuckets_in;
+        mDivisor_in = 1;
+        for (int i = 0; i < mNumBuckets_in; ++i)
+            mDivisor_in *= 10;
+        mDomesticBuckets = 1;
+        for (int i = 0; i < mNumBuckets_ex; ++i)
+            mDomesticBuckets *= 10;
     };
 
+    template <typename T>
+    const size_t DefaultHash<T>::number_length;
+
+    template <typename T>
+    const size_t DefaultHash<T>::max_number_length;
+
+    template <typename T>
+    number_index DefaultHash<T>::hash(boost::string_view key) const
+    {
+        number_index index;
+        if (!parse(key, index))
+            throw std::invalid_argument("Hasher: the number must be set in the format '89993332211' or '+<8-15 digits>'.");
+        return index;
+    }
+
+    template <typename T>
+    size_t DefaultHash<T>::hash(const boost::string_view* keys, size_t count, number_index* indices) const
+    {
+        for (size_t i = 0; i < count; ++i)
+            if (!parse(keys[i], indices[i]))
+                return i;
+        return count;
+    }
+
 	// Вычисление хэша в общем случае
 	// Солтер, Кеплер, глава 23
 	template <typename T>
-	std::pair<int, int> DefaultHash<T>::hash(const T& key) const
+	number_index DefaultHash<T>::hash(const T& key) const
 	{
 		unsigned long res1 = 0;
 		for (int i = 0; i < mNumBuckets_ex; ++i) {
@@ -53,47 +176,78 @@ namespace DataBase {
 		for (int i = mNumBuckets_ex; i < mNumBuckets_ex + mNumBuckets_in; ++i) {
 		    res2 += *((char*)&key + i);
 		}
-		return std::make_pair((res1 % mNumBuckets_ex), (res2 % mNumBuckets_in));
+		return number_index((int)(res1 % mNumBuckets_ex), (number_key)(res2 % mNumBuckets_in));
 	}
 
 	// Преобразование, обратное хэшированию. В программе используется специализация шаблона для типа std::string
 	template <typename T>
-	T DefaultHash<T>::unhash(const int& ex_index, const int& it_index) 
+	T DefaultHash<T>::unhash(const int& ex_index, const number_key& it_index) 
 	{
 	        T t;
 	        return t;
 	}
     
 
-     // Специализация DefaultHash::hash() для поставленной задачи: метод DefaultHash.hash(std::string) переводит std::string в
-     // два int - mNumBuckets_ex и mNumBuckets_in
+     // Специализация DefaultHash::parse() для поставленной задачи: номер "8" + 10 цифр переводится в два числа -
+     // первые mNumBuckets_ex и последние mNumBuckets_in цифр. Цифры проверяются и преобразуются за один проход
+     // без выделения памяти: 8 цифр - одним 64-разрядным словом (SWAR), оставшиеся 2 - по одной.
+     // Остальные ключи (в том числе начинающиеся с '+') преобразуются нумерационным планом как номера E.164.
 	template <>
-	std::pair<int, int> DefaultHash<std::string>::hash(const std::string& key) const
+	inline bool DefaultHash<std::string>::parse(boost::string_view key, number_index& index) const
 		{
-		if (key.size() != 11)
-			throw std::invalid_argument("Hasher: the number must be set in the format '89993332211'.");
+		if (key.size() != 11 || key[0] != '8') {
+			if (!key.empty() && key[0] == '+')
+				key.remove_prefix(1);
+			unsigned int bucket;
+			if (!mPlan.encode(key.data(), key.size(), bucket, index.second))
+				return false;
+			index.first = mDomesticBuckets + (int)bucket;
+			return true;
+		}
+
+		// цифры 1..8 номера; первый символ - в младшем байте слова (little-endian)
+		uint64_t word;
+		std::memcpy(&word, key.data() + 1, sizeof(word));
 
-		// первые mNumBuckets_ex и последние mNumBuckets_in символов ключа отображаем в std::pair<int, int>
-		return std::make_pair(
-			std::stoi(key.substr(1, mNumBuckets_ex)),  // первая цифра "8" телефонного номера в преобразовании не участвует.
-			std::stoi(key.substr(1 + mNumBuckets_ex, mNumBuckets_in)));
+		// каждый байт должен лежать в диапазоне '0'..'9' (0x30..0x39): старшая тетрада равна 3,
+		// и прибавление 6 не вызывает переноса в старшую тетраду
+		if (((word & 0xF0F0F0F0F0F0F0F0ULL) | (((word + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) != 0x3333333333333333ULL)
+			return false;
+
+		// попарное объединение цифр: 8 цифр -> 4 двузначных -> 2 четырехзначных -> восьмизначное число
+		word &= 0x0F0F0F0F0F0F0F0FULL;
+		word = (word * 10 + (word >> 8)) & 0x00FF00FF00FF00FFULL;
+		word = (word * 100 + (word >> 16)) & 0x0000FFFF0000FFFFULL;
+		word = (word * 10000 + (word >> 32)) & 0x00000000FFFFFFFFULL;
+
+		unsigned int d9  = (unsigned char)key[9]  - '0';
+		unsigned int d10 = (unsigned char)key[10] - '0';
+		if (d9 > 9 || d10 > 9)
+			return false;
+
+		// первая цифра "8" телефонного номера в преобразовании не участвует
+		unsigned long long number = word * 100 + d9 * 10 + d10;
+		index.first  = (int)(number / mDivisor_in);
+		index.second = number % mDivisor_in;
+		return true;
+		}
+
+     // Специализация DefaultHash::hash() для поставленной задачи: метод DefaultHash.hash(std::string) переводит std::string в
+     // сегмент и ключ записи
+	template <>
+	inline number_index DefaultHash<std::string>::hash(const std::string& key) const
+		{
+		return hash(boost::string_view(key));
 	    }
 
      // Специализация DefaultHash::unhash() для поставленной задачи: метод DefaultHash<T>::unhash(std::pair<int, int> index)
      // переводит два индекса mNumBuckets_ex и mNumBuckets_in в std::string.
 	template <>
-	std::string DefaultHash<std::string>::unhash(const int& first_number, const int& second_number)
+	inline std::string DefaultHash<std::string>::unhash(const int& first_number, const number_key& second_number)
 		{
-	             	// преобразование int-индексов в std::string.
-					std::string first  = std::to_string(first_number);
-					std::string second = std::to_string(second_number);
-
-					// дополнение строк нулями до требуемого размера телефонного номера
-					std::string add_first(mNumBuckets_ex -  first.size(), '0');
-					std::string add_second(mNumBuckets_in - second.size(), '0');
-
-	                // объединение std::string-представлей входных индексов в один std::string.
-	                return "8" + add_first + first + add_second + second;
+					// номер из 11 символов помещается во внутренний буфер std::string (small string optimization)
+					char buffer[max_number_length];
+					return std::string(buffer, unhash(first_number, second_number, buffer));
 	    	}
 
 }
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cstring>
+
+#include "import.h"
+
+namespace DataBase {
+
+	import_pipeline::import_pipeline(unsigned int num_threads, split_handler split_in, size_t batch_size_in, size_t queue_capacity_in) :
+		split(std::move(split_in)), batch_size(batch_size_in),
+		queue_capacity(queue_capacity_in ? queue_capacity_in : 2 * std::max(1u, num_threads)),
+		queues(std::max(1u, num_threads)), closed(false), failed(false), input_closed(false), next_line(1), received(0)
+	{
+		for (unsigned int i = 0; i < queues.size(); ++i)
+			workers.emplace_back(&import_pipeline::run, this, i);
+	}
+
+	import_pipeline::~import_pipeline()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			failed = true;
+		}
+		stop();
+	}
+
+	bool import_pipeline::push(const char* data, size_t size)
+	{
+		received += size;
+		pending.append(data, size);
+		if (input_closed)
+			return false;
+		if (pending.size() < batch_size)
+			return true;
+
+		// пакет завершается последним переводом строки; неполная строка переходит в следующий пакет
+		size_t end = pending.rfind('\n');
+		if (end == std::string::npos)
+			return true;
+		std::string data_batch(pending, 0, end + 1);
+		pending.erase(0, end + 1);
+		return enqueue(std::move(data_batch));
+	}
+
+	bool import_pipeline::enqueue(std::string&& data)
+	{
+		unsigned long first_line = next_line;
+		next_line += (unsigned long)std::count(data.begin(), data.end(), '\n');
+
+		// пакет разбирается один раз, строки распределяются по задачам частей
+		std::vector<task> tasks(queues.size());
+		std::exception_ptr split_error;
+		try {
+			split(std::move(data), first_line, tasks);
+		}
+		catch (...) {
+			split_error = std::current_exception();
+		}
+
+		// место в очереди ограничивается самым медленным потоком
+		std::unique_lock<std::mutex> lock(mutex);
+		not_full.wait(lock, [&] {
+			return failed || std::all_of(queues.begin(), queues.end(), [&](const std::deque<task>& queue) {
+				return queue.size() < queue_capacity;
+			});
+		});
+		if (failed)
+			return false;
+		for (size_t part = 0; part < queues.size(); ++part)
+			if (tasks[part])
+				queues[part].push_back(std::move(tasks[part]));
+		// после ошибки разбора данные больше не принимаются, строки до ошибки обрабатываются потоками
+		if (split_error) {
+			input_closed = true;
+			if (!error)
+				error = split_error;
+		}
+		lock.unlock();
+		not_empty.notify_all();
+		return !split_error;
+	}
+
+	void import_pipeline::finish()
+	{
+		if (!pending.empty() && !input_closed) {
+			std::string rest;
+			rest.swap(pending);
+			enqueue(std::move(rest));
+		}
+		stop();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	void import_pipeline::stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+		}
+		not_empty.notify_all();
+		not_full.notify_all();
+		for (auto& worker : workers)
+			if (worker.joinable())
+				worker.join();
+	}
+
+	void import_pipeline::run(unsigned int part)
+	{
+		std::deque<task>& queue = queues[part];
+		for (;;) {
+			task current;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				not_empty.wait(lock, [&] { return failed || closed || !queue.empty(); });
+				if (failed || queue.empty())
+					return;
+				current = std::move(queue.front());
+				queue.pop_front();
+			}
+			not_full.notify_one();
+
+			try {
+				current();
+			}
+			catch (...) {
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					if (!error)
+						error = std::current_exception();
+					failed = true;
+					for (auto& q : queues)
+						q.clear();
+				}
+				not_full.notify_all();
+				not_empty.notify_all();
+				return;
+			}
+		}
+	}
+
+} // namespace DataBase
@@ -0,0 +1,79 @@
+#ifndef IMPORT_H
+#define IMPORT_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+namespace DataBase {
+
+	// Конвейер потокового импорта: фрагменты тела http-запроса, поступающие по мере чтения из сокета,
+	// собираются в пакеты целых строк (граница пакета - последний перевод строки). Каждый пакет разбирается
+	// один раз в потоке, добавляющем данные (обработчик split), и его строки распределяются по частям данных
+	// (например, по сегменту номера): задача обработки строк части part ставится в очередь потока part.
+	// Задачи одной части выполняются одним потоком в порядке поступления пакетов, поэтому строки одной части
+	// обрабатываются в порядке следования в потоке данных. Очереди ограничены, поэтому при медленной обработке
+	// push() блокируется и чтение тела запроса приостанавливается (обратное давление через окно TCP).
+	class import_pipeline {
+	public:
+		// обработка строк одной части пакета
+		typedef std::function<void()> task;
+
+		// разбор пакета: данные пакета, номер его первой строки во всем потоке данных и задачи частей
+		// (tasks.size() - количество частей; пустая задача - в пакете нет строк этой части). Исключение
+		// разбора (ошибка формата) прекращает прием данных: задачи, заполненные до исключения, выполняются,
+		// а исключение передается из finish().
+		typedef std::function<void(std::string&& batch, unsigned long first_line, std::vector<task>& tasks)> split_handler;
+
+		import_pipeline(unsigned int num_threads, split_handler split,
+			size_t batch_size = 1 << 20, size_t queue_capacity = 0);
+		~import_pipeline();
+
+		import_pipeline(const import_pipeline&) = delete;
+		import_pipeline& operator=(const import_pipeline&) = delete;
+
+		// добавление фрагмента данных; false - обработка прервана ошибкой разбора или одного из потоков
+		bool push(const char* data, size_t size);
+
+		// обработка оставшихся данных и ожидание потоков; исключение первой ошибки разбора или обработки
+		void finish();
+
+		// количество принятых байт
+		unsigned long long bytes() const { return received; }
+
+	private:
+		split_handler split;
+		size_t batch_size;
+		size_t queue_capacity;
+
+		// очереди задач потоков
+		std::mutex mutex;
+		std::condition_variable not_full;
+		std::condition_variable not_empty;
+		std::vector<std::deque<task> > queues;
+		bool closed;
+		bool failed;
+		std::exception_ptr error;
+
+		bool input_closed;              // ошибка разбора: данные больше не принимаются
+		std::string pending;            // данные после последнего перевода строки
+		unsigned long next_line;        // номер первой строки pending
+		unsigned long long received;
+
+		std::vector<std::thread> workers;
+
+		// разбор пакета и постановка задач в очереди потоков с ожиданием свободного места
+		bool enqueue(std::string&& data);
+
+		void run(unsigned int part);
+		void stop();
+	};
+
+} // namespace DataBase
+
+#endif // IMPORT_H
@@ -0,0 +1,302 @@
+#include <algorithm>
+
+#include "name_index.h"
+
+namespace DataBase {
+
+	const size_t posting_table::number_of_shards;
+	const size_t posting_table::max_changes;
+
+	namespace {
+		// FNV-1a по байтам строки
+		uint64_t hash_bytes(uint64_t hash, boost::string_view s)
+		{
+			for (char c : s) {
+				hash ^= (unsigned char)c;
+				hash *= 1099511628211ULL;
+			}
+			return hash;
+		}
+
+		// перемешивание битов хэша (финализатор MurmurHash3): младшие биты ключа выбирают сегмент таблицы
+		uint64_t mix(uint64_t hash)
+		{
+			hash ^= hash >> 33;
+			hash *= 0xFF51AFD7ED558CCDULL;
+			hash ^= hash >> 33;
+			hash *= 0xC4CEB9FE1A85EC53ULL;
+			hash ^= hash >> 33;
+			return hash;
+		}
+
+		const uint64_t hash_seed = 14695981039346656037ULL;
+
+		// запись упорядоченных номеров ids разностями соседних номеров в формате LEB128
+		void encode_list(std::string& buffer, const std::vector<uint64_t>& ids)
+		{
+			uint64_t previous = 0;
+			for (uint64_t id : ids) {
+				uint64_t delta = id - previous;
+				previous = id;
+				while (delta >= 0x80) {
+					buffer.push_back((char)((delta & 0x7F) | 0x80));
+					delta >>= 7;
+				}
+				buffer.push_back((char)delta);
+			}
+		}
+
+		// чтение списка [begin, end), записанного encode_list, в конец ids
+		void decode_list(const char* begin, const char* end, std::vector<uint64_t>& ids)
+		{
+			uint64_t id = 0;
+			while (begin != end) {
+				uint64_t delta = 0;
+				int shift = 0;
+				unsigned char byte;
+				do {
+					byte = (unsigned char)*begin++;
+					delta |= (uint64_t)(byte & 0x7F) << shift;
+					shift += 7;
+				} while (byte & 0x80);
+				id += delta;
+				ids.push_back(id);
+			}
+		}
+
+		// Слияние упорядоченного списка ids с изменениями changes (номер, +1 или -1) в result: номер входит в результат,
+		// если сумма его присутствия в списке и изменений положительна. Остаток суммы (отличный от нуля, пока
+		// одновременные изменения номера из разных потоков учтены не все) возвращается в residual.
+		void merge_changes(const std::vector<uint64_t>& ids, std::vector<std::pair<uint64_t, int> >& changes,
+			std::vector<uint64_t>& result, std::vector<std::pair<uint64_t, int> >* residual)
+		{
+			std::sort(changes.begin(), changes.end());
+			result.clear();
+			size_t i = 0, j = 0;
+			while (i < ids.size() || j < changes.size()) {
+				uint64_t id = (j == changes.size() || (i < ids.size() && ids[i] <= changes[j].first)) ? ids[i] : changes[j].first;
+				int count = 0;
+				if (i < ids.size() && ids[i] == id) {
+					count = 1;
+					++i;
+				}
+				for (; j < changes.size() && changes[j].first == id; ++j)
+					count += changes[j].second;
+				int present = (count >= 1) ? 1 : 0;
+				if (present)
+					result.push_back(id);
+				if (residual && count != present)
+					residual->emplace_back(id, count - present);
+			}
+		}
+	}
+
+	uint64_t last_name_key(boost::string_view last_name)
+	{
+		return mix(hash_bytes(hash_seed, last_name));
+	}
+
+	uint64_t full_name_key(boost::string_view last_name, boost::string_view first_name, boost::string_view patronymic)
+	{
+		// части имени разделяются символом, который не встречается в именах
+		uint64_t hash = hash_bytes(hash_seed, last_name);
+		hash = hash_bytes(hash, "\n");
+		hash = hash_bytes(hash, first_name);
+		hash = hash_bytes(hash, "\n");
+		return mix(hash_bytes(hash, patronymic));
+	}
+
+	posting_table::posting_table() : shards(new shard[number_of_shards])
+	{
+		for (size_t i = 0; i < number_of_shards; ++i)
+			shards[i].offsets.push_back(0);
+	}
+
+	void posting_table::change(uint64_t key, uint64_t id, int delta)
+	{
+		shard& s = shards[shard_of(key)];
+		std::lock_guard<std::mutex> lock(s.mutex);
+		s.changes.push_back(pending_change{ key, id, delta });
+		if (s.changes.size() >= std::max(max_changes, s.ids / 8))
+			compact(s);
+	}
+
+	std::vector<uint64_t> posting_table::find(uint64_t key) const
+	{
+		const shard& s = shards[shard_of(key)];
+		std::lock_guard<std::mutex> lock(s.mutex);
+
+		std::vector<uint64_t> ids;
+		auto it = std::lower_bound(s.keys.begin(), s.keys.end(), key);
+		if (it != s.keys.end() && *it == key) {
+			size_t i = it - s.keys.begin();
+			decode_list(s.postings.data() + s.offsets[i], s.postings.data() + s.offsets[i + 1], ids);
+		}
+
+		// накопленные изменения списка учитываются поверх сжатого списка
+		std::vector<std::pair<uint64_t, int> > changes;
+		for (auto& c : s.changes)
+			if (c.key == key)
+				changes.emplace_back(c.id, c.delta);
+		if (changes.empty())
+			return ids;
+
+		std::vector<uint64_t> result;
+		merge_changes(ids, changes, result, nullptr);
+		return result;
+	}
+
+	// Перенос изменений: списки без изменений копируются в новый буфер целиком, списки с изменениями
+	// распаковываются, объединяются с изменениями и записываются заново.
+	void posting_table::compact(shard& s)
+	{
+		std::sort(s.changes.begin(), s.changes.end(), [](const pending_change& a, const pending_change& b) {
+			return a.key < b.key;
+		});
+
+		std::vector<uint64_t> keys;
+		std::vector<uint32_t> offsets;
+		std::string postings;
+		std::vector<pending_change> changes;
+		size_t count = s.ids;
+		keys.reserve(s.keys.size() + s.changes.size());
+		offsets.reserve(s.keys.size() + s.changes.size() + 1);
+		postings.reserve(s.postings.size() + s.changes.size() * 4);
+		offsets.push_back(0);
+
+		std::vector<uint64_t> ids, result;
+		std::vector<std::pair<uint64_t, int> > delta, residual;
+		size_t i = 0, j = 0;
+		while (i < s.keys.size() || j < s.changes.size()) {
+			if (j == s.changes.size() || (i < s.keys.size() && s.keys[i] < s.changes[j].key)) {
+				keys.push_back(s.keys[i]);
+				postings.append(s.postings, s.offsets[i], s.offsets[i + 1] - s.offsets[i]);
+				offsets.push_back((uint32_t)postings.size());
+				++i;
+				continue;
+			}
+
+			const uint64_t key = s.changes[j].key;
+			ids.clear();
+			if (i < s.keys.size() && s.keys[i] == key) {
+				decode_list(s.postings.data() + s.offsets[i], s.postings.data() + s.offsets[i + 1], ids);
+				++i;
+			}
+			delta.clear();
+			for (; j < s.changes.size() && s.changes[j].key == key; ++j)
+				delta.emplace_back(s.changes[j].id, s.changes[j].delta);
+
+			residual.clear();
+			merge_changes(ids, delta, result, &residual);
+			count = count - ids.size() + result.size();
+			for (auto& r : residual)
+				changes.push_back(pending_change{ key, r.first, r.second });
+			if (!result.empty()) {
+				keys.push_back(key);
+				encode_list(postings, result);
+				offsets.push_back((uint32_t)postings.size());
+			}
+		}
+
+		s.keys.swap(keys);
+		s.offsets.swap(offsets);
+		s.postings.swap(postings);
+		s.ids = count;
+		s.changes.swap(changes);
+	}
+
+	void posting_table::build_shard(size_t shard_index, std::vector<std::pair<uint64_t, uint64_t> >& entries)
+	{
+		std::sort(entries.begin(), entries.end());
+		entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+		std::vector<uint64_t> keys;
+		std::vector<uint32_t> offsets(1, 0);
+		std::string postings;
+		std::vector<uint64_t> ids;
+		for (size_t i = 0; i < entries.size(); ) {
+			const uint64_t key = entries[i].first;
+			ids.clear();
+			for (; i < entries.size() && entries[i].first == key; ++i)
+				ids.push_back(entries[i].second);
+			keys.push_back(key);
+			encode_list(postings, ids);
+			offsets.push_back((uint32_t)postings.size());
+		}
+		keys.shrink_to_fit();
+		offsets.shrink_to_fit();
+		postings.shrink_to_fit();
+
+		shard& s = shards[shard_index];
+		std::lock_guard<std::mutex> lock(s.mutex);
+		s.keys.swap(keys);
+		s.offsets.swap(offsets);
+		s.postings.swap(postings);
+		s.ids = entries.size();
+		std::vector<pending_change>().swap(s.changes);
+	}
+
+	void posting_table::clear()
+	{
+		for (size_t i = 0; i < number_of_shards; ++i) {
+			shard& s = shards[i];
+			std::lock_guard<std::mutex> lock(s.mutex);
+			std::vector<uint64_t>().swap(s.keys);
+			std::vector<uint32_t>(1, 0).swap(s.offsets);
+			std::string().swap(s.postings);
+			s.ids = 0;
+			std::vector<pending_change>().swap(s.changes);
+		}
+	}
+
+	size_t posting_table::number_of_keys() const
+	{
+		size_t count = 0;
+		for (size_t i = 0; i < number_of_shards; ++i) {
+			std::lock_guard<std::mutex> lock(shards[i].mutex);
+			count += shards[i].keys.size();
+		}
+		return count;
+	}
+
+	size_t posting_table::memory() const
+	{
+		size_t bytes = 0;
+		for (size_t i = 0; i < number_of_shards; ++i) {
+			const shard& s = shards[i];
+			std::lock_guard<std::mutex> lock(s.mutex);
+			bytes += s.keys.capacity() * sizeof(uint64_t) + s.offsets.capacity() * sizeof(uint32_t)
+				+ s.postings.capacity() + s.changes.capacity() * sizeof(pending_change);
+		}
+		return bytes;
+	}
+
+	void name_index::add(boost::string_view last_name, boost::string_view first_name, boost::string_view patronymic, uint64_t id)
+	{
+		by_last_name.change(last_name_key(last_name), id, 1);
+		by_full_name.change(full_name_key(last_name, first_name, patronymic), id, 1);
+	}
+
+	void name_index::remove(boost::string_view last_name, boost::string_view first_name, boost::string_view patronymic, uint64_t id)
+	{
+		by_last_name.change(last_name_key(last_name), id, -1);
+		by_full_name.change(full_name_key(last_name, first_name, patronymic), id, -1);
+	}
+
+	std::vector<uint64_t> name_index::find(boost::string_view last_name) const
+	{
+		return by_last_name.find(last_name_key(last_name));
+	}
+
+	std::vector<uint64_t> name_index::find(boost::string_view last_name, boost::string_view first_name, boost::string_view patronymic) const
+	{
+		return by_full_name.find(full_name_key(last_name, first_name, patronymic));
+	}
+
+	void name_index::clear()
+	{
+		by_last_name.clear();
+		by_full_name.clear();
+	}
+
+} // namespace DataBase
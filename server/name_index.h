@@ -0,0 +1,193 @@
+﻿#ifndef NAME_INDEX_H
+#define NAME_INDEX_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+#include <boost/utility/string_view.hpp>
+
+namespace DataBase {
+
+	// Ключи индекса имен - 64-разрядные хэши фамилии и полного имени (фамилия, имя, отчество); строки имен
+	// в индексе не хранятся. Совпадение хэшей различных имен возможно, поэтому записи, найденные по индексу,
+	// сверяются с искомым именем.
+	uint64_t last_name_key(boost::string_view last_name);
+	uint64_t full_name_key(boost::string_view last_name, boost::string_view first_name, boost::string_view patronymic);
+
+	// Таблица списков номеров (posting lists) по ключам. Таблица разделена на сегменты по значению ключа,
+	// каждый сегмент защищен своим мьютексом. Сегмент хранит упорядоченный массив ключей и буфер сжатых списков:
+	// номера списка упорядочены по возрастанию и записаны разностями соседних номеров в формате LEB128
+	// (для номеров одного сегмента базы данных - 1-3 байта на номер). Изменения (+1 - добавление номера,
+	// -1 - удаление) накапливаются в сегменте и переносятся в списки перезаписью буфера, когда их количество
+	// достигает max_changes или 1/8 количества номеров сегмента (большее из значений): перезапись пропорциональна
+	// размеру сегмента, поэтому затраты на одно изменение не растут с размером таблицы. При поиске изменения
+	// учитываются поверх списка. Номер принадлежит списку, если сумма его
+	// изменений (с учетом присутствия в списке) положительна, поэтому результат не зависит от порядка
+	// одновременных изменений одного номера из разных потоков.
+	class posting_table {
+	public:
+		static const size_t number_of_shards = 256;
+
+		// наименьшее количество накапливаемых изменений сегмента
+		static const size_t max_changes = 256;
+
+		posting_table();
+
+		posting_table(const posting_table&) = delete;
+		posting_table& operator=(const posting_table&) = delete;
+
+		static size_t shard_of(uint64_t key) { return (size_t)(key % number_of_shards); }
+
+		// добавление (delta = 1) или удаление (delta = -1) номера id из списка ключа key
+		void change(uint64_t key, uint64_t id, int delta);
+
+		// номера списка ключа key по возрастанию
+		std::vector<uint64_t> find(uint64_t key) const;
+
+		// построение сегмента shard из пар (ключ, номер) entries (порядок произвольный; entries упорядочивается);
+		// накопленные изменения сегмента отбрасываются
+		void build_shard(size_t shard, std::vector<std::pair<uint64_t, uint64_t> >& entries);
+
+		void clear();
+
+		// количество ключей и размер памяти сегментов в байтах
+		size_t number_of_keys() const;
+		size_t memory() const;
+
+	private:
+		struct pending_change {
+			uint64_t key;
+			uint64_t id;
+			int delta;
+		};
+
+		struct shard {
+			mutable std::mutex mutex;
+			std::vector<uint64_t> keys;        // ключи по возрастанию
+			std::vector<uint32_t> offsets;     // начало списка ключа keys[i] в postings; offsets[keys.size()] - конец буфера
+			std::string postings;              // сжатые списки
+			size_t ids = 0;                    // количество номеров в списках
+			std::vector<pending_change> changes;
+		};
+		std::unique_ptr<shard[]> shards;
+
+		// перенос накопленных изменений в списки сегмента (под блокировкой сегмента)
+		static void compact(shard& s);
+	};
+
+	// Индекс имен: списки номеров по фамилии и по полному имени. Номер записи - 64-разрядное число,
+	// назначаемое базой данных (data::NameIndexId). Методы потокобезопасны.
+	class name_index {
+	public:
+		void add(boost::string_view last_name, boost::string_view first_name, boost::string_view patronymic, uint64_t id);
+		void remove(boost::string_view last_name, boost::string_view first_name, boost::string_view patronymic, uint64_t id);
+
+		// номера записей по фамилии и по полному имени (по возрастанию)
+		std::vector<uint64_t> find(boost::string_view last_name) const;
+		std::vector<uint64_t> find(boost::string_view last_name, boost::string_view first_name, boost::string_view patronymic) const;
+
+		void clear();
+
+		// количество различных фамилий и полных имен и размер памяти индекса в байтах
+		size_t number_of_last_names() const { return by_last_name.number_of_keys(); }
+		size_t number_of_full_names() const { return by_full_name.number_of_keys(); }
+		size_t memory() const { return by_last_name.memory() + by_full_name.memory(); }
+
+		// пары (ключ, номер) по сегментам таблиц
+		typedef std::vector<std::vector<std::pair<uint64_t, uint64_t> > > shard_entries;
+
+		// приемник записей одного потока построения индекса: ключи записи вычисляются в этом потоке
+		class collector {
+		public:
+			void operator()(boost::string_view last_name, boost::string_view first_name, boost::string_view patronymic, uint64_t id)
+			{
+				uint64_t key = last_name_key(last_name);
+				last[posting_table::shard_of(key)].emplace_back(key, id);
+				key = full_name_key(last_name, first_name, patronymic);
+				full[posting_table::shard_of(key)].emplace_back(key, id);
+			}
+
+		private:
+			friend class name_index;
+			collector(shard_entries& l, shard_entries& f) : last(l), full(f) {}
+			shard_entries& last;
+			shard_entries& full;
+		};
+
+		// Построение индекса заново в num_threads потоках. records(part, emit) вызывается в потоке part
+		// для part из [0, num_threads) и передает emit(фамилия, имя, отчество, номер) (emit - collector&)
+		// записи своей части базы данных. Потоки вычисляют ключи своих записей и распределяют пары (ключ, номер)
+		// по сегментам таблиц, затем каждый поток строит свою часть сегментов таблиц.
+		template<typename Records>
+		void build(unsigned int num_threads, Records records);
+
+	private:
+		posting_table by_last_name;
+		posting_table by_full_name;
+
+		// выполнение f(part) для part из [0, num_threads): part = 0 - в вызывающем потоке
+		template<typename Function>
+		static void run_parallel(unsigned int num_threads, Function f);
+	};
+
+	template<typename Records>
+	void name_index::build(unsigned int num_threads, Records records)
+	{
+		if (num_threads == 0)
+			num_threads = 1;
+		typedef std::vector<std::pair<uint64_t, uint64_t> > entries;
+		const size_t shards = posting_table::number_of_shards;
+
+		// пары (ключ, номер) каждого потока по сегментам таблиц
+		std::vector<shard_entries> last(num_threads, shard_entries(shards));
+		std::vector<shard_entries> full(num_threads, shard_entries(shards));
+		run_parallel(num_threads, [&](unsigned int part) {
+			collector emit(last[part], full[part]);
+			records(part, emit);
+		});
+
+		// поток part строит сегменты part, part + num_threads, ...; пары переносятся из массивов потоков по мере построения
+		run_parallel(num_threads, [&](unsigned int part) {
+			entries merged;
+			for (size_t s = part; s < shards; s += num_threads) {
+				for (int table = 0; table < 2; ++table) {
+					std::vector<shard_entries>& source = (table == 0) ? last : full;
+					merged.clear();
+					for (unsigned int t = 0; t < num_threads; ++t) {
+						merged.insert(merged.end(), source[t][s].begin(), source[t][s].end());
+						entries().swap(source[t][s]);
+					}
+					((table == 0) ? by_last_name : by_full_name).build_shard(s, merged);
+				}
+			}
+		});
+	}
+
+	template<typename Function>
+	void name_index::run_parallel(unsigned int num_threads, Function f)
+	{
+		// Массив будущих результатов используется для фиксации исключений.
+		std::vector<std::future<void> > futures(num_threads - 1);
+		for (unsigned int i = 1; i < num_threads; ++i)
+			futures[i - 1] = std::async(std::launch::async, [&f, i]() { f(i); });
+		try {
+			f(0);
+		}
+		catch (...) {
+			for (auto& future : futures)
+				future.wait();
+			throw;
+		}
+		for (auto& future : futures)
+			future.get();
+	}
+
+} // namespace DataBase
+
+#endif // NAME_INDEX_H
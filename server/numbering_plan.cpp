@@ -0,0 +1,184 @@
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+
+#include "numbering_plan.h"
+#include "error.h"
+
+namespace DataBase {
+
+	const size_t numbering_plan::min_digits;
+	const size_t numbering_plan::max_digits;
+
+	namespace {
+		const uint64_t powers_of_10[] = {
+			1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+			1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+			100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL
+		};
+
+		// Таблица по умолчанию: каждая первая цифра кода страны (зоны E.164) покрывает все коды, начинающиеся с нее;
+		// отдельные префиксы выделены для крупнейших стран, чтобы их номера распределялись по большему числу сегментов.
+		const numbering_prefix default_prefixes[] = {
+			{ "1", 1024 }, { "2", 64 }, { "3", 64 }, { "4", 64 }, { "5", 64 }, { "6", 64 }, { "7", 1024 }, { "8", 64 }, { "9", 64 },
+			{ "20", 128 }, { "33", 256 }, { "34", 256 }, { "39", 256 }, { "44", 256 }, { "49", 256 }, { "55", 256 },
+			{ "52", 128 }, { "62", 128 }, { "81", 256 }, { "82", 128 }, { "86", 512 }, { "90", 128 }, { "91", 512 },
+			{ "234", 128 }, { "880", 128 }
+		};
+	}
+
+	numbering_plan::numbering_plan() :
+		table(std::begin(default_prefixes), std::end(default_prefixes)), total_buckets(0)
+	{
+		build();
+	}
+
+	numbering_plan::numbering_plan(const std::vector<numbering_prefix>& prefixes) :
+		table(prefixes), total_buckets(0)
+	{
+		build();
+	}
+
+	void numbering_plan::build()
+	{
+		trie.assign(1, node());
+		std::memset(&trie[0], 0, sizeof(node));
+		trie[0].prefix = -1;
+		first_bucket.clear();
+
+		for (size_t i = 0; i < table.size(); ++i) {
+			const std::string& prefix = table[i].prefix;
+			if (prefix.empty() || prefix.size() > max_digits || prefix[0] == '0' || table[i].buckets == 0)
+				throw std::invalid_argument("Numbering plan: invalid prefix '" + prefix + "'.");
+
+			unsigned int n = 0;
+			for (char c : prefix) {
+				if (c < '0' || c > '9')
+					throw std::invalid_argument("Numbering plan: invalid prefix '" + prefix + "'.");
+				unsigned int& child = trie[n].child[c - '0'];
+				if (!child) {
+					node leaf;
+					std::memset(&leaf, 0, sizeof(leaf));
+					leaf.prefix = -1;
+					child = (unsigned int)trie.size();
+					trie.push_back(leaf);
+				}
+				n = trie[n].child[c - '0'];
+			}
+			if (trie[n].prefix >= 0)
+				throw std::invalid_argument("Numbering plan: duplicate prefix '" + prefix + "'.");
+			trie[n].prefix = (int)i;
+
+			first_bucket.push_back(total_buckets);
+			total_buckets += table[i].buckets;
+		}
+	}
+
+	numbering_plan numbering_plan::load(const std::string& file_name)
+	{
+		std::ifstream in(file_name);
+		if (!in)
+			throw FileOpenError(file_name);
+
+		std::vector<numbering_prefix> prefixes;
+		std::string line;
+		unsigned long line_number = 0;
+		while (std::getline(in, line)) {
+			++line_number;
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			if (line.empty() || line[0] == '#')
+				continue;
+			std::string::size_type comma = line.find(',');
+			try {
+				if (comma == std::string::npos)
+					throw std::invalid_argument("no comma");
+				numbering_prefix entry = { line.substr(0, comma), (unsigned int)std::stoul(line.substr(comma + 1)) };
+				prefixes.push_back(entry);
+			}
+			catch (std::logic_error&) {
+				throw FileCorruptError(file_name, "строка " + std::to_string(line_number) + ", ожидается <префикс>,<количество сегментов>");
+			}
+		}
+
+		try {
+			return numbering_plan(prefixes);
+		}
+		catch (std::invalid_argument& e) {
+			throw FileCorruptError(file_name, e.what());
+		}
+	}
+
+	bool numbering_plan::encode(const char* digits, size_t length, unsigned int& bucket, uint64_t& key) const
+	{
+		if (length < min_digits || length > max_digits || digits[0] == '0')
+			return false;
+
+		// проверка цифр, значение номера и самый длинный префикс таблицы
+		uint64_t value = 0;
+		unsigned int n = 0;
+		int prefix = -1;
+		size_t prefix_length = 0;
+		for (size_t i = 0; i < length; ++i) {
+			unsigned int d = (unsigned char)digits[i] - '0';
+			if (d > 9)
+				return false;
+			value = value * 10 + d;
+			if (n || i == 0) {
+				n = trie[n].child[d];
+				if (n && trie[n].prefix >= 0) {
+					prefix = trie[n].prefix;
+					prefix_length = i + 1;
+				}
+			}
+		}
+		if (prefix < 0)
+			return false;
+
+		uint64_t rest = value % powers_of_10[length - prefix_length];
+		bucket = first_bucket[prefix] + (unsigned int)(rest % table[prefix].buckets);
+		key = powers_of_10[length] + value;
+		return true;
+	}
+
+	uint64_t numbering_plan::digits_value(uint64_t key)
+	{
+		size_t length = max_digits;
+		while (length > min_digits && key < powers_of_10[length])
+			--length;
+		return key - powers_of_10[length];
+	}
+
+	char* numbering_plan::decode(uint64_t key, char* buffer)
+	{
+		size_t length = max_digits;
+		while (length > min_digits && key < powers_of_10[length])
+			--length;
+		uint64_t value = key - powers_of_10[length];
+
+		buffer[0] = '+';
+		for (size_t i = length; i > 0; --i) {
+			buffer[i] = (char)('0' + value % 10);
+			value /= 10;
+		}
+		return buffer + 1 + length;
+	}
+
+	bool numbering_plan::valid(unsigned int bucket, uint64_t key) const
+	{
+		if (key < powers_of_10[min_digits] || key >= 2 * powers_of_10[max_digits])
+			return false;
+		size_t length = max_digits;
+		while (length > min_digits && key < powers_of_10[length])
+			--length;
+		if (key >= 2 * powers_of_10[length])
+			return false;
+
+		char digits[max_digits + 1];
+		char* end = decode(key, digits);
+		unsigned int expected;
+		uint64_t encoded;
+		return encode(digits + 1, end - digits - 1, expected, encoded) && expected == bucket && encoded == key;
+	}
+
+} // namespace DataBase
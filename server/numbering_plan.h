@@ -0,0 +1,77 @@
+#ifndef NUMBERING_PLAN_H
+#define NUMBERING_PLAN_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace DataBase {
+
+	// Нумерационный план международных номеров E.164: 8-15 цифр, первая цифра (код страны) не равна 0.
+	// Международный номер хранится в той же двухуровневой структуре, что и номера "8" + 10 цифр:
+	//   ключ    = 10^<количество цифр> + <значение цифр> - компактное целое (меньше 2 * 10^15), однозначно
+	//             задающее номер вместе с его длиной;
+	//   сегмент = первый сегмент префикса + <значение цифр после префикса> % <количество сегментов префикса>,
+	// где префикс (код страны или код страны и зоны) - самый длинный префикс номера из таблицы плана.
+	// Сегменты плана нумеруются от 0 и в базе данных следуют за сегментами номеров "8" + 10 цифр.
+	// Преобразования не выделяют память.
+	struct numbering_prefix {
+		std::string prefix;             // цифры префикса
+		unsigned int buckets;           // количество сегментов префикса
+	};
+
+	class numbering_plan {
+	public:
+		// количество цифр международного номера
+		static const size_t min_digits = 8;
+		static const size_t max_digits = 15;
+
+		// план по умолчанию: все коды стран, для самых крупных - больше сегментов
+		numbering_plan();
+
+		// план из таблицы префиксов; префиксы из цифр, не длиннее max_digits, без повторов
+		explicit numbering_plan(const std::vector<numbering_prefix>& prefixes);
+
+		// Чтение плана из файла: строки "<префикс>,<количество сегментов>"; пустые строки и строки,
+		// начинающиеся с '#', пропускаются. Ошибки сообщаются исключениями FileOpenError и FileCorruptError.
+		static numbering_plan load(const std::string& file_name);
+
+		// общее количество сегментов плана
+		unsigned int number_of_buckets() const { return total_buckets; }
+
+		const std::vector<numbering_prefix>& prefixes() const { return table; }
+
+		// Преобразование цифр номера [digits, digits + length) в сегмент плана и ключ.
+		// Возвращает false для недопустимого номера или номера без префикса в таблице.
+		bool encode(const char* digits, size_t length, unsigned int& bucket, uint64_t& key) const;
+
+		// Запись номера "+<цифры>" по ключу в buffer (не более max_digits + 1 символов, без завершающего нуля).
+		// Возвращает указатель на символ, следующий за номером.
+		static char* decode(uint64_t key, char* buffer);
+
+		// значение цифр номера по ключу (для колоночной выгрузки)
+		static uint64_t digits_value(uint64_t key);
+
+		// проверка, что ключ задает допустимый номер, который план помещает в сегмент bucket
+		bool valid(unsigned int bucket, uint64_t key) const;
+
+	private:
+		std::vector<numbering_prefix> table;
+		std::vector<unsigned int> first_bucket;   // первый сегмент каждого префикса таблицы
+
+		// Префиксное дерево по цифрам: узел - индексы дочерних узлов для цифр 0..9 (0 - нет узла)
+		// и номер префикса таблицы, заканчивающегося в узле (-1 - нет).
+		struct node {
+			unsigned int child[10];
+			int prefix;
+		};
+		std::vector<node> trie;
+
+		unsigned int total_buckets;
+
+		void build();
+	};
+
+} // namespace DataBase
+
+#endif // NUMBERING_PLAN_H
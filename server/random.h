@@ -0,0 +1,163 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+namespace DataBase {
+
+	// Генератор псевдослучайных чисел xoshiro256++ (D. Blackman, S. Vigna): 256 бит состояния,
+	// период 2^256 - 1, несколько тактов на 64-разрядное число. Удовлетворяет требованиям
+	// UniformRandomBitGenerator, поэтому может использоваться и со стандартными распределениями.
+	class xoshiro256pp {
+	public:
+		typedef uint64_t result_type;
+
+		// состояние заполняется генератором splitmix64 из seed, как рекомендуют авторы xoshiro
+		explicit xoshiro256pp(uint64_t seed)
+		{
+			for (int i = 0; i < 4; ++i)
+				s[i] = splitmix64(seed);
+		}
+
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return UINT64_MAX; }
+
+		result_type operator()()
+		{
+			const uint64_t result = rotl(s[0] + s[3], 23) + s[0];
+			const uint64_t t = s[1] << 17;
+			s[2] ^= s[0];
+			s[3] ^= s[1];
+			s[1] ^= s[2];
+			s[0] ^= s[3];
+			s[2] ^= t;
+			s[3] = rotl(s[3], 45);
+			return result;
+		}
+
+		// Равномерное целое число из [0, range) без деления в основном случае (D. Lemire,
+		// "Fast Random Integer Generation in an Interval"): старшие 32 бита произведения.
+		uint32_t bounded(uint32_t range)
+		{
+			uint64_t m = (uint64_t)(uint32_t)((*this)() >> 32) * range;
+			uint32_t low = (uint32_t)m;
+			if (low < range) {
+				const uint32_t threshold = (uint32_t)(0 - range) % range;
+				while (low < threshold) {
+					m = (uint64_t)(uint32_t)((*this)() >> 32) * range;
+					low = (uint32_t)m;
+				}
+			}
+			return (uint32_t)(m >> 32);
+		}
+
+		// шаг генератора splitmix64 (используется и для получения независимых начальных значений)
+		static uint64_t splitmix64(uint64_t& state)
+		{
+			uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			return z ^ (z >> 31);
+		}
+
+	private:
+		uint64_t s[4];
+
+		static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+	};
+
+	// Выбор count различных чисел из [0, n) алгоритмом Флойда (count вызовов генератора, без повторных попыток).
+	// Выбранные числа отмечаются в битовом массиве из n бит, который переиспользуется между вызовами
+	// и после выбора снова очищается; результат возвращается в values по возрастанию.
+	class unique_sampler {
+	public:
+		explicit unique_sampler(uint32_t n) : n(n), bits((n + 63) / 64, 0) {}
+
+		template<typename Generator>
+		void sample(Generator& generator, uint32_t count, std::vector<uint32_t>& values)
+		{
+			values.clear();
+			if (count > n)
+				count = n;
+			for (uint32_t j = n - count; j < n; ++j) {
+				uint32_t t = generator.bounded(j + 1);
+				if (bits[t >> 6] & (uint64_t(1) << (t & 63)))
+					t = j;   // j еще не выбрано: все выбранные ранее числа меньше j
+				bits[t >> 6] |= uint64_t(1) << (t & 63);
+				values.push_back(t);
+			}
+			for (uint32_t v : values)
+				bits[v >> 6] = 0;
+			std::sort(values.begin(), values.end());
+		}
+
+	private:
+		uint32_t n;
+		std::vector<uint64_t> bits;
+	};
+
+	// Таблица псевдонимов (A. J. Walker, алгоритм построения M. D. Vose) для выбора индекса из [0, n)
+	// с заданными весами за O(1): одно 64-разрядное случайное число выбирает ячейку (старшие 32 бита)
+	// и сравнивается с ее порогом (младшие 32 бита); при неудаче возвращается псевдоним ячейки.
+	class alias_table {
+	public:
+		alias_table() {}
+
+		// weights - неотрицательные веса, сумма которых больше нуля
+		explicit alias_table(const std::vector<double>& weights) : cells(weights.size())
+		{
+			const size_t n = weights.size();
+			double sum = 0;
+			for (double w : weights)
+				sum += w;
+
+			// вероятности, умноженные на n: ячейки делятся на недостаточные (< 1) и избыточные (>= 1)
+			std::vector<double> scaled(n);
+			std::vector<uint32_t> small, large;
+			for (size_t i = 0; i < n; ++i) {
+				scaled[i] = weights[i] * n / sum;
+				(scaled[i] < 1.0 ? small : large).push_back((uint32_t)i);
+			}
+
+			// недостаточная ячейка дополняется избыточной, остаток которой снова распределяется
+			while (!small.empty() && !large.empty()) {
+				uint32_t s = small.back(), l = large.back();
+				small.pop_back();
+				cells[s].threshold = (uint32_t)(scaled[s] * 4294967296.0);
+				cells[s].alias = l;
+				scaled[l] -= 1.0 - scaled[s];
+				if (scaled[l] < 1.0) {
+					large.pop_back();
+					small.push_back(l);
+				}
+			}
+
+			// оставшиеся ячейки (в том числе из-за погрешности округления) выбираются всегда
+			for (uint32_t i : large) cells[i].alias = i;
+			for (uint32_t i : small) cells[i].alias = i;
+		}
+
+		size_t size() const { return cells.size(); }
+
+		template<typename Generator>
+		uint32_t operator()(Generator& generator) const
+		{
+			const uint64_t r = generator();
+			const uint32_t i = (uint32_t)(((r >> 32) * cells.size()) >> 32);
+			return ((uint32_t)r < cells[i].threshold) ? i : cells[i].alias;
+		}
+
+	private:
+		struct cell {
+			uint32_t threshold = 0;   // вероятность выбора самой ячейки, умноженная на 2^32
+			uint32_t alias = 0;
+		};
+		std::vector<cell> cells;
+	};
+
+} // namespace DataBase
+
+#endif // RANDOM_H
@@ -3,7 +3,7 @@
 namespace DataBase {
 
     record::record(std::string&& LastName, std::string&& FirstName, std::string&& Patronymic) :
-        last_name(LastName), first_name(FirstName), patronymic(Patronymic)
+        last_name(std::move(LastName)), first_name(std::move(FirstName)), patronymic(std::move(Patronymic))
     {
     }
     record::record() :
@@ -16,6 +16,9 @@ namespace DataBase {
 		record(std::string&&, std::string&&, std::string&&);
 		record();
 		record(const record&) = delete;
+		record(record&&) = default;
+		record& operator=(const record&) = default;
+		record& operator=(record&&) = default;
 		bool operator==(const record&) const;
 		bool operator!=(const record&) const;
 		const std::string& get_last_name() const;
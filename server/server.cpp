@@ -11,12 +11,19 @@
 #include <thread>
 #include <future>
 #include <memory>
+#include <map>
+#include <vector>
+#include <cstring>
+#include <algorithm>
 
 #include "../lib/httplib.h"
 #include "../lib/timer.h"
 #include "data.h"
 #include "hash.h"
 #include "record.h"
+#include "wal.h"
+#include "import.h"
+#include "generator.h"
 
 
 // вспомогательный класс для увеличения счетчика активных потоков в конструкторе при 
@@ -35,7 +42,122 @@ public:
 };
 
 
-int main()
+
+// значение параметра запроса без копирования (пустая строка, если параметр не задан); действительно, пока существует запрос
+boost::string_view param_view(const httplib::Request& req, const char* name)
+{
+	auto it = req.params.find(name);
+	return (it == req.params.end()) ? boost::string_view() : boost::string_view(it->second);
+}
+
+// Проверка числа потоков из параметра NumOfThreads: при нуле потоков операции не выполняются и не завершаются.
+// Отрицательное значение, прочитанное в беззнаковую переменную, передается как отрицательное int.
+void check_num_threads(int num_threads)
+{
+	if (num_threads < 1)
+		throw std::invalid_argument("The number of threads must be at least 1.");
+}
+
+// проверка имени абонента: запятые и переводы строк нарушили бы формат файлов /save
+void check_name(const std::string& value, const std::string& field)
+{
+	if (value.find_first_of(",\r\n") != std::string::npos)
+		throw std::invalid_argument("The " + field + " must not contain commas or line breaks.");
+}
+
+// распределения генерируемых данных из параметров запроса /generate и /generate_file:
+// ActiveRatio - доля активных абонентов, NameZipf и PrefixZipf - показатели закона Ципфа частот имен
+// и заполненности сегментов, PrefixDensity - файл плотностей префиксов (строки "<префикс>,<плотность>")
+DataBase::generation_profile generation_profile_params(const httplib::Request& req)
+{
+	DataBase::generation_profile profile;
+	if (req.has_param("ActiveRatio"))
+		profile.active_ratio = std::stod(req.get_param_value("ActiveRatio"));
+	if (req.has_param("NameZipf"))
+		profile.name_zipf = std::stod(req.get_param_value("NameZipf"));
+	if (req.has_param("PrefixZipf"))
+		profile.prefix_zipf = std::stod(req.get_param_value("PrefixZipf"));
+	if (req.has_param("PrefixDensity"))
+		profile.prefix_densities = DataBase::generation_profile::load_prefix_densities(req.get_param_value("PrefixDensity"));
+	return profile;
+}
+
+
+// Состояние запроса /range между фрагментами ответа: следующая запись диапазона, количество переданных записей
+// и суммарное время обхода. Фрагмент содержит не более records_per_chunk записей (около 1 Мб) в формате файлов /save.
+struct range_query {
+	DataBase::number_index from, to;
+	DataBase::activity_filter filter = DataBase::activity_filter::all;
+	bool finished = false;
+	unsigned long count = 0;
+	double time = 0;
+
+	static const size_t records_per_chunk = 16384;
+
+	// формирование следующего фрагмента в chunk (блокировка базы данных захватывается на время формирования)
+	void next(DataBase::data<std::string, DataBase::record>& db, std::string& chunk)
+	{
+		Timer t;
+		char number[DataBase::DefaultHash<std::string>::max_number_length];
+		chunk.clear();
+		finished = db.FindRange(from, to, filter, records_per_chunk,
+			[&](int bucket, DataBase::number_key key, bool activity, const DataBase::record& rec) {
+				chunk.append(number, db.Hasher.unhash(bucket, key, number));
+				chunk += ", ";
+				chunk += rec.get_last_name();
+				chunk += ", ";
+				chunk += rec.get_first_name();
+				chunk += ", ";
+				chunk += rec.get_patronymic();
+				chunk += activity ? ", 1\n" : ", 0\n";
+				++count;
+			});
+		time += t.elapsed();
+	}
+};
+
+
+// вывод размеров индекса имен после генерации и загрузки базы данных (при ленивой загрузке
+// записи блоков добавляются в индекс по мере загрузки блоков, и размеры не выводятся)
+void print_name_index(const DataBase::data<std::string, DataBase::record>& db)
+{
+	if (db.Get_name_index_enabled() && db.Get_number_of_lazy_blocks() == 0)
+		std::cout << "Name index: " << db.Get_name_index_last_names() << " last names, " << db.Get_name_index_full_names()
+			<< " full names, memory " << db.Get_name_index_memory() << " bytes." << std::endl;
+}
+
+// разбор параметров командной строки вида --name=value
+std::map<std::string, std::string> parse_options(int argc, char* argv[])
+{
+	std::map<std::string, std::string> options;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 2, "--") != 0)
+			continue;
+		std::string::size_type pos = arg.find('=');
+		if (pos == std::string::npos)
+			options[arg.substr(2)] = "1";
+		else
+			options[arg.substr(2, pos - 2)] = arg.substr(pos + 1);
+	}
+	return options;
+}
+
+// значение параметра командной строки либо значение по умолчанию
+std::string get_option(const std::map<std::string, std::string>& options, const std::string& name, const std::string& default_value)
+{
+	auto it = options.find(name);
+	return (it == options.end()) ? default_value : it->second;
+}
+
+// Параметры запуска сервера:
+//   --wal=<файл>                  - файл журнала упреждающей записи (по умолчанию wal.log);
+//   --wal-mode=sync|async|none|off - режим долговечности журнала (по умолчанию sync; off - журнал не ведется);
+//   --wal-interval=<мс>            - период сброса журнала на диск в режиме async;
+//   --numbering-plan=<файл>        - таблица префиксов международных номеров (по умолчанию встроенная, см. numbering_plan.h);
+//   --name-index=on|off            - ведение индекса имен для /find_by_name (по умолчанию on); при ленивой загрузке
+//                                    снимка /find_by_name дожидается загрузки всех блоков.
+int main(int argc, char* argv[])
 {
 
 #ifdef _WIN32    
@@ -60,23 +182,96 @@ int main()
 	std::atomic<unsigned int> current_count_threads(0);
 	std::string print_time;
 
+	std::map<std::string, std::string> options = parse_options(argc, argv);
+	std::string wal_file = get_option(options, "wal", "wal.log");
+	std::string wal_mode = get_option(options, "wal-mode", "sync");
+	int wal_interval = std::stoi(get_option(options, "wal-interval", "10"));
+	std::string io_backend = get_option(options, "io", "stream");
+	std::string startup_load = get_option(options, "startup-load", "eager");
+	unsigned int save_retention = std::stoul(get_option(options, "save-retention", "1"));
+	std::string numbering_plan_file = get_option(options, "numbering-plan", "");
+	std::string name_index = get_option(options, "name-index", "on");
+	if (startup_load != "eager" && startup_load != "lazy") {
+		std::cout << "Unknown startup load mode '" + startup_load + "'. Use eager or lazy." << std::endl;
+		return 1;
+	}
+	if (name_index != "on" && name_index != "off") {
+		std::cout << "Unknown name index mode '" + name_index + "'. Use on or off." << std::endl;
+		return 1;
+	}
+
+	DataBase::numbering_plan plan;
+	if (!numbering_plan_file.empty()) {
+		try {
+			plan = DataBase::numbering_plan::load(numbering_plan_file);
+		}
+		catch (std::runtime_error& e) {
+			std::cout << "Numbering plan error: " << e.what() << std::endl;
+			return 1;
+		}
+	}
+
 	try {
 
-		DataBase::data<std::string, DataBase::record > db(4, 6);
+		// журнал создается до базы данных и уничтожается после нее
+		std::unique_ptr<DataBase::write_ahead_log> wal;
+		if (wal_mode != "off")
+			wal.reset(new DataBase::write_ahead_log(wal_file, DataBase::parse_durability_mode(wal_mode), wal_interval));
+
+		DataBase::data<std::string, DataBase::record > db(4, 6, plan);
+		db.SetIOBackend(DataBase::parse_io_backend(io_backend));
+		db.SetSaveRetention(save_retention);
+		db.SetNameIndex(name_index == "on");
 		
 		auto init_time = t.elapsed();
 		std::cout << "Database initialize time: " + std::to_string(init_time) + " mc." << std::endl;
 		std::cout << "-----------------------------------------" << std::endl;
 
+		// восстановление базы данных: снимок последней контрольной точки и записи журнала
+		if (wal) {
+			t.reset();
+			try {
+				unsigned long count = db.Recover(*wal, startup_load == "lazy");
+				std::cout << "WAL recovery (" + wal_file + ", mode " + wal_mode + "): " + std::to_string(count) + " log records replayed. "
+					+ "Count of records: " + std::to_string(db.Get_number_of_records()) + ". Duration: " + std::to_string(t.elapsed()) + " mc." << std::endl;
+				if (wal->Get_number_of_skipped())
+					std::cout << "Malformed log records skipped: " + std::to_string(wal->Get_number_of_skipped()) + "." << std::endl;
+				if (db.Get_loaded_generation())
+					std::cout << "The checkpoint snapshot is incomplete, the previous snapshot (generation "
+						+ std::to_string(db.Get_loaded_generation()) + ") was loaded." << std::endl;
+				if (db.Get_number_of_lazy_blocks())
+					std::cout << "Snapshot blocks are loaded on demand, not loaded yet: " + std::to_string(db.Get_number_of_lazy_blocks()) + "." << std::endl;
+				print_name_index(db);
+			}
+			catch (std::runtime_error& e) {
+				std::cout << "WAL recovery error: " << e.what() << std::endl;
+				return 1;
+			}
+			std::cout << "-----------------------------------------" << std::endl;
+		}
+
+		// словари имен для /generate и /generate_file загружаются один раз при запуске;
+		// при ошибке сервер продолжает работу, а чтение файлов повторяется при запросе генерации
+		DataBase::name_lists_cache names;
+		t.reset();
+		try {
+			names.get();
+			std::cout << "Name dictionaries loaded. Duration: " + std::to_string(t.elapsed()) + " mc." << std::endl;
+		}
+		catch (std::runtime_error& e) {
+			std::cout << "Name dictionaries are not loaded: " << e.what() << std::endl;
+		}
+		std::cout << "-----------------------------------------" << std::endl;
+
 		// приветствие клиента
-		svr.Get("/hi", [&](const httplib::Request& req, httplib::Response& res) {
+		svr.Get("/hi", [&](const httplib::Request& /*req*/, httplib::Response& res) {
 			res.set_content("Hello!", "text/plain");
 			std::cout << "Command 'hi' received." << std::endl;
 			std::cout << "-----------------------------------------" << std::endl;
 			});
 
 		// запрос генерации базы данных
-		svr.Post("/generate", [&db, &current_count_threads, &MaxThreads](const httplib::Request& req, httplib::Response& res) {
+		svr.Post("/generate", [&db, &names, &current_count_threads, &MaxThreads](const httplib::Request& req, httplib::Response& res) {
 			std::cout << "Command 'generate' received." << std::endl;
 			Timer t;
 
@@ -91,6 +286,9 @@ int main()
 			if (req.has_param("NumOfRecords")) {
 				NumOfRecords = std::stoi(req.get_param_value("NumOfRecords"));
 			}
+
+			// начальное значение генерации: при одинаковом Seed база данных воспроизводится при любом числе потоков
+			uint64_t Seed = req.has_param("Seed") ? std::stoull(req.get_param_value("Seed")) : DataBase::random_seed();
 		
 
 			std::string answer, time;
@@ -99,18 +297,92 @@ int main()
 
 				// при превышении максимального числа потоков, обрабатывающих запросы к базе данных,
 				// генерируется исключение и запрос не обрабатывается
+				check_num_threads(NumOfThreads);
 				if (current_count_threads + NumOfThreads > MaxThreads)
 					throw DataBase::MaxThreadError("Thread limit exceeded in 'generate' request.");
 			
 				increment_number_threads inc(NumOfThreads, current_count_threads);
 
-				auto count = db.Generate(NumOfRecords, NumOfThreads);		
+				auto count = db.Generate(NumOfRecords, NumOfThreads, *names.get(), 1000, Seed, generation_profile_params(req));
 
 				time   = std::to_string(t.elapsed());
 				answer = "DataBase generated successfully. Count of records: " + std::to_string(count.first) 
 					   + ". Count of bytes: " + std::to_string(count.second)  
+					   + ". Seed: " + std::to_string(Seed)
 					   + ". Duration of the generate operation (on the server): " + time + " mc.";
 					   
+				std::cout << answer << std::endl;
+				print_name_index(db);
+
+				// сохранение результатов в http-заголовках и передача их клиенту
+				res.set_header("ANSWER", answer);
+				res.set_header("TIME", time);
+			}
+			catch (std::runtime_error& e) {
+				std::cout << e.what() <<  std::endl;
+				res.set_header("ERROR", e.what());
+			}
+			catch (std::bad_alloc&) {
+				std::cout << "Memory allocation error." << std::endl;
+				res.set_header("ERROR", "Memory allocation error.");
+			}
+			catch (std::invalid_argument& e) {
+				std::cout << e.what() << std::endl;
+				res.set_header("ERROR", e.what());
+			}
+			catch (...) {
+				res.set_header("ERROR", "Unknown error.");
+				std::cout << "Unknown error." << std::endl;
+			}
+			std::cout << "-----------------------------------------" << std::endl;
+		});
+
+		// Запрос генерации базы данных непосредственно в файл FileName без размещения в памяти (generator.h):
+		// Format=csv (по умолчанию, загружается /load) или snapshot (блочный снимок, Compression - сжатие блоков),
+		// Seed - начальное значение генерации (при одинаковом Seed файл не зависит от NumOfThreads);
+		// распределения данных задаются, как у /generate (generation_profile_params).
+		// База данных в памяти не изменяется и не блокируется.
+		svr.Post("/generate_file", [&names, &current_count_threads, &MaxThreads](const httplib::Request& req, httplib::Response& res) {
+			std::cout << "Command 'generate_file' received." << std::endl;
+			Timer t;
+
+			unsigned int NumOfThreads = 1;
+			unsigned long long NumOfRecords = 4;
+			std::string format = "csv", compression = "zlib", file_name;
+
+			std::string answer, time;
+			t.reset();
+			try {
+				if (req.has_param("NumOfThreads"))
+					NumOfThreads = std::stoi(req.get_param_value("NumOfThreads"));
+				if (req.has_param("NumOfRecords"))
+					NumOfRecords = std::stoull(req.get_param_value("NumOfRecords"));
+				if (req.has_param("Format"))
+					format = req.get_param_value("Format");
+				if (req.has_param("Compression"))
+					compression = req.get_param_value("Compression");
+				uint64_t Seed = req.has_param("Seed") ? std::stoull(req.get_param_value("Seed")) : DataBase::random_seed();
+				DataBase::generated_file_format file_format = DataBase::parse_generated_file_format(format);
+				file_name = req.has_param("FileName") ? req.get_param_value("FileName")
+					: (file_format == DataBase::generated_file_format::csv) ? "generated.csv" : "generated.snap";
+
+				// при превышении максимального числа потоков, обрабатывающих запросы к базе данных,
+				// генерируется исключение и запрос не обрабатывается
+				check_num_threads(NumOfThreads);
+				if (current_count_threads + NumOfThreads > MaxThreads)
+					throw DataBase::MaxThreadError("Thread limit exceeded in 'generate_file' request.");
+
+				increment_number_threads inc(NumOfThreads, current_count_threads);
+
+				DataBase::generated_file_stats stats = DataBase::generate_file(file_name, file_format, NumOfRecords, NumOfThreads,
+					*names.get(), Seed, generation_profile_params(req), DataBase::parse_block_compression(compression));
+
+				time   = std::to_string(t.elapsed());
+				answer = "File " + file_name + " generated successfully. Count of records: " + std::to_string(stats.records)
+					   + ". Count of bytes: " + std::to_string(stats.bytes)
+					   + ". Seed: " + std::to_string(Seed)
+					   + ". Duration of the generate_file operation (on the server): " + time + " mc.";
+
 				std::cout << answer << std::endl;
 
 				// сохранение результатов в http-заголовках и передача их клиенту
@@ -121,7 +393,7 @@ int main()
 				std::cout << e.what() <<  std::endl;
 				res.set_header("ERROR", e.what());
 			}
-			catch (std::bad_alloc) {
+			catch (std::bad_alloc&) {
 				std::cout << "Memory allocation error." << std::endl;
 				res.set_header("ERROR", "Memory allocation error.");
 			}
@@ -155,12 +427,26 @@ int main()
 				file_name = req.get_param_value("FileName");
 			}
 
+			// режим сохранения: full - полный снимок в файлы csv, incremental - перезапись измененных сегментов в каталоге FileName,
+			// snapshot - снимок в блочном двоичном формате в файле FileName, columnar - колоночная выгрузка в каталог FileName,
+			// fork - полный снимок в файлы csv, записываемый дочерним процессом без остановки операций записи
+			std::string mode = "full";
+			if (req.has_param("Mode")) {
+				mode = req.get_param_value("Mode");
+			}
+
+			// сжатие блоков снимка в режиме snapshot: zlib или none
+			std::string compression = "zlib";
+			if (req.has_param("Compression")) {
+				compression = req.get_param_value("Compression");
+			}
 
 			std::string answer, time;
 			t.reset();
 			try {
 				// при превышении максимального числа потоков, обрабатывающих запросы к базе данных,
 				// генерируется исключение и запрос не обрабатывается
+				check_num_threads(NumOfThreads);
 				if (current_count_threads + NumOfThreads > MaxThreads)
 					throw DataBase::MaxThreadError("Thread limit exceeded in 'save' request.");
 
@@ -168,12 +454,49 @@ int main()
 				increment_number_threads inc(NumOfThreads, current_count_threads);
 
 				// выполнение запроса
-				auto count = db.Save(NumOfThreads, file_name);
+				if (mode == "incremental") {
+					auto count = db.SaveIncremental(NumOfThreads, file_name.empty() ? "snapshot" : file_name);
 
-				// формирование ответа клиенту
-				time = std::to_string(t.elapsed());
-				answer = "DataBase saved successfully. Count of saved records: " + std::to_string(count)
-					+ ". Duration of the save operation (on the server): " + time + " mc.";
+					time = std::to_string(t.elapsed());
+					answer = "DataBase checkpoint saved successfully. Count of rewritten buckets: " + std::to_string(count.first)
+						+ ". Count of saved records: " + std::to_string(count.second)
+						+ ". Duration of the save operation (on the server): " + time + " mc.";
+				}
+				else if (mode == "snapshot") {
+					auto count = db.SaveSnapshot(NumOfThreads, file_name.empty() ? "data.snap" : file_name,
+						DataBase::parse_block_compression(compression));
+
+					time = std::to_string(t.elapsed());
+					answer = "DataBase snapshot saved successfully. Count of saved records: " + std::to_string(count)
+						+ ". Duration of the save operation (on the server): " + time + " mc.";
+				}
+				else if (mode == "columnar") {
+					auto count = db.SaveColumnar(NumOfThreads, file_name.empty() ? "columns" : file_name);
+
+					time = std::to_string(t.elapsed());
+					answer = "DataBase columnar export saved successfully. Count of exported records: " + std::to_string(count)
+						+ ". Duration of the save operation (on the server): " + time + " mc.";
+				}
+				else if (mode == "fork") {
+					auto stats = db.SaveForked(NumOfThreads, file_name.empty() ? "data.csv" : file_name);
+
+					time = std::to_string(t.elapsed());
+					answer = "DataBase saved successfully by the child process. Count of saved records: " + std::to_string(stats.records)
+						+ ". Duration of fork: " + std::to_string(stats.fork_time) + " mc"
+						+ ". Duration of the child process: " + std::to_string(stats.child_time) + " mc"
+						+ ". Copy-on-write growth of the server memory: " + std::to_string(stats.cow_bytes / 1024) + " KB"
+						+ ". Duration of the save operation (on the server): " + time + " mc.";
+				}
+				else if (mode == "full") {
+					auto count = db.Save(NumOfThreads, file_name);
+
+					// формирование ответа клиенту
+					time = std::to_string(t.elapsed());
+					answer = "DataBase saved successfully. Count of saved records: " + std::to_string(count)
+						+ ". Duration of the save operation (on the server): " + time + " mc.";
+				}
+				else
+					throw std::invalid_argument("Unknown save mode '" + mode + "'.");
 				std::cout << answer << std::endl;
 
 				// сохранение результатов в http-заголовках и передача их клиенту
@@ -184,7 +507,7 @@ int main()
 				std::cout << e.what() << std::endl;
 				res.set_header("ERROR", e.what());
 			}
-			catch (std::bad_alloc) {
+			catch (std::bad_alloc&) {
 				std::cout << "Memory allocation error." << std::endl;
 				res.set_header("ERROR", "Memory allocation error.");
 			}
@@ -217,22 +540,46 @@ int main()
 				file_name = req.get_param_value("FileName");
 			}
 
+			// режим загрузки: full - файлы csv, incremental - каталог инкрементальных контрольных точек FileName,
+			// snapshot - файл блочного формата FileName, lazy - ленивая загрузка файла блочного формата
+			std::string mode = "full";
+			if (req.has_param("Mode")) {
+				mode = req.get_param_value("Mode");
+			}
+			if ((mode == "snapshot" || mode == "lazy") && !req.has_param("FileName"))
+				file_name = "data.snap";
+
 			std::string answer, time;
 			t.reset();
 			try {
 				// при превышении максимального числа потоков, обрабатывающих запросы к базе данных,
 				// генерируется исключение и запрос не обрабатывается
+				check_num_threads(NumOfThreads);
 				if (current_count_threads + NumOfThreads > MaxThreads)
 					throw DataBase::MaxThreadError("Thread limit exceeded in 'load' request.");
 
 				increment_number_threads inc(NumOfThreads, current_count_threads);
 
-				unsigned long count = db.Load(NumOfThreads, file_name);
+				unsigned long count;
+				if (mode == "incremental")
+					count = db.LoadIncremental(NumOfThreads, file_name);
+				else if (mode == "snapshot")
+					count = db.LoadSnapshot(NumOfThreads, file_name);
+				else if (mode == "lazy")
+					count = db.LoadLazy(file_name);
+				else if (mode == "full")
+					count = db.Load(NumOfThreads, file_name);
+				else
+					throw std::invalid_argument("Unknown load mode '" + mode + "'.");
 
 				time = std::to_string(t.elapsed());
 				answer = "DataBase loaded successfully. Count of load records: " + std::to_string(count)
 					+ ". Duration of the load operation (on the server): " + time + " mc.";
+				if (mode == "full" && db.Get_loaded_generation())
+					answer += " The snapshot is incomplete, the previous snapshot (generation "
+						+ std::to_string(db.Get_loaded_generation()) + ") was loaded.";
 				std::cout << answer << std::endl;
+				print_name_index(db);
 
 				// сохранение результатов в http-заголовках и передача их клиенту
 				res.set_header("ANSWER", answer);
@@ -242,7 +589,104 @@ int main()
 				std::cout << e.what() << std::endl;
 				res.set_header("ERROR", e.what());
 			}
-			catch (std::bad_alloc) {
+			catch (std::bad_alloc&) {
+				std::cout << "Memory allocation error." << std::endl;
+				res.set_header("ERROR", "Memory allocation error.");
+			}
+			catch (std::invalid_argument& e) {
+				std::cout << e.what() << std::endl;
+				res.set_header("ERROR", e.what());
+			}
+			catch (...) {
+				res.set_header("ERROR", "Unknown error.");
+				std::cout << "Unknown error." << std::endl;
+			}
+			std::cout << "-----------------------------------------" << std::endl;
+		});
+
+		// Потоковый импорт записей: тело запроса - строки формата csv (как в файлах /save), параметры - в строке запроса.
+		// Тело разбирается по мере поступления и добавляется в базу данных в NumOfThreads потоках; существующие записи заменяются.
+		// Номера распределены между потоками по сегменту, поэтому записи одного номера добавляются в порядке строк (последняя строка заменяет предыдущие).
+		svr.Post("/import", [&db, &current_count_threads, &MaxThreads](const httplib::Request& req, httplib::Response& res,
+			const httplib::ContentReader& content_reader) {
+			std::cout << "Command 'import' received." << std::endl;
+			Timer t;
+
+			unsigned int NumOfThreads = 1;
+			// получение из запроса числа потоков
+			if (req.has_param("NumOfThreads")) {
+				NumOfThreads = std::stoi(req.get_param_value("NumOfThreads"));
+			}
+
+			std::string answer, time;
+			t.reset();
+			try {
+				// при превышении максимального числа потоков, обрабатывающих запросы к базе данных,
+				// генерируется исключение и запрос не обрабатывается
+				check_num_threads(NumOfThreads);
+				if (current_count_threads + NumOfThreads > MaxThreads)
+					throw DataBase::MaxThreadError("Thread limit exceeded in 'import' request.");
+
+				increment_number_threads inc(NumOfThreads, current_count_threads);
+
+				std::atomic<unsigned long> added(0), replaced(0);
+				// пакет разбирается один раз в потоке чтения тела запроса, строки каждой части добавляются своим потоком
+				DataBase::import_pipeline pipeline(NumOfThreads, [&](std::string&& text, unsigned long first_line,
+					std::vector<DataBase::import_pipeline::task>& tasks) {
+					std::shared_ptr<const std::string> batch = std::make_shared<const std::string>(std::move(text));
+					std::vector<std::vector<DataBase::import_row> > parts(tasks.size());
+					std::exception_ptr error;
+					try {
+						db.SplitImportRows(batch->data(), batch->size(), "<import>", first_line, parts);
+					}
+					catch (...) {
+						error = std::current_exception(); // строки до ошибки формата добавляются
+					}
+
+					for (size_t part = 0; part < parts.size(); ++part) {
+						if (parts[part].empty())
+							continue;
+						// задача владеет данными пакета, на которые ссылаются поля строк
+						std::shared_ptr<const std::vector<DataBase::import_row> > rows =
+							std::make_shared<const std::vector<DataBase::import_row> >(std::move(parts[part]));
+						tasks[part] = [&db, &added, &replaced, batch, rows] {
+							auto count = db.ImportRows(*rows);
+							added += count.first;
+							replaced += count.second;
+						};
+					}
+					if (error)
+						std::rethrow_exception(error);
+				});
+
+				bool received = content_reader([&](const char* data, size_t data_length) {
+					return pipeline.push(data, data_length);
+				});
+				pipeline.finish(); // ошибка обработки пакета передается исключением
+				if (!received)
+					throw std::runtime_error("Import interrupted: the request body was not received completely. Count of imported records: "
+						+ std::to_string(added + replaced) + ".");
+
+				// формирование ответа клиенту
+				double elapsed = t.elapsed();
+				time = std::to_string(elapsed);
+				unsigned long rows = added + replaced;
+				answer = "DataBase import completed successfully. Count of new records: " + std::to_string(added.load())
+					+ ". Count of replaced records: " + std::to_string(replaced.load())
+					+ ". Received: " + std::to_string(pipeline.bytes()) + " bytes"
+					+ ". Rate: " + std::to_string(elapsed > 0 ? (unsigned long)(rows / (elapsed / 1000.0)) : rows) + " rows/s"
+					+ ". Duration of the import operation (on the server): " + time + " mc.";
+				std::cout << answer << std::endl;
+
+				// сохранение результатов в http-заголовках и передача их клиенту
+				res.set_header("ANSWER", answer);
+				res.set_header("TIME", time);
+			}
+			catch (std::runtime_error& e) {
+				std::cout << e.what() << std::endl;
+				res.set_header("ERROR", e.what());
+			}
+			catch (std::bad_alloc&) {
 				std::cout << "Memory allocation error." << std::endl;
 				res.set_header("ERROR", "Memory allocation error.");
 			}
@@ -276,6 +720,7 @@ int main()
 			
 				// при превышении максимального числа потоков, обрабатывающих запросы к базе данных,
 				// генерируется исключение и запрос не обрабатывается
+				check_num_threads(NumOfThreads);
 				if (current_count_threads + 1 > MaxThreads)
 					throw DataBase::MaxThreadError("Thread limit exceeded in 'clear' request.");
 
@@ -295,7 +740,7 @@ int main()
 				std::cout << e.what() << std::endl;
 				res.set_header("ERROR", e.what());
 			}
-			catch (std::bad_alloc) {
+			catch (std::bad_alloc&) {
 				std::cout << "Memory allocation error." << std::endl;
 				res.set_header("ERROR", "Memory allocation error.");
 			}
@@ -315,9 +760,12 @@ int main()
 			std::cout << "Command 'add' received." << std::endl;
 			Timer t;
 
-			std::string last_name(""), first_name(""), patronymic(""), number("");
+			std::string last_name(""), first_name(""), patronymic("");
 			bool activity = false;
 
+			// номер телефона добавляемого абонента указывает на параметр запроса без копирования
+			boost::string_view number = param_view(req, "NUMBER");
+
 			// получение из запроса имени добавляемого абонента
 			if (req.has_param("FIRST_NAME")) {
 				first_name = req.get_param_value("FIRST_NAME");
@@ -333,11 +781,6 @@ int main()
 				patronymic = req.get_param_value("PATRONYMIC");
 			}
 
-			// получение из запроса номера телефона добавляемого абонента
-			if (req.has_param("NUMBER")) {
-				number = req.get_param_value("NUMBER");
-			}
-
 			// получение из запроса признака активности добавляемого абонента
 			if (req.has_param("ACTIVITY")) {
 				activity = std::stoi(req.get_param_value("ACTIVITY"));
@@ -354,6 +797,10 @@ int main()
 
 				increment_number_threads inc(1, current_count_threads);
 
+				check_name(last_name, "last name");
+				check_name(first_name, "first name");
+				check_name(patronymic, "patronymic");
+
 				// создание записи из принятых параметров и добавление ее в базу данных
 				//DataBase::record rec(last_name, first_name, patronymic);
 				DataBase::record rec(std::move(last_name), std::move(first_name), std::move(patronymic));
@@ -364,9 +811,9 @@ int main()
 
 				std::string str;
 				if (success)
-					str = "New record added successfully: " + number + ", " + rec.get_last_name() + ", " + rec.get_first_name() + ", " + rec.get_patronymic() + ". ";
+					str = "New record added successfully: " + number.to_string() + ", " + rec.get_last_name() + ", " + rec.get_first_name() + ", " + rec.get_patronymic() + ". ";
 				else
-					str = "Record replaced successfully: " + number + ", " + rec.get_last_name() + ", " + rec.get_first_name() + ", " + rec.get_patronymic() + ". ";
+					str = "Record replaced successfully: " + number.to_string() + ", " + rec.get_last_name() + ", " + rec.get_first_name() + ", " + rec.get_patronymic() + ". ";
 
 				answer = str + " Duration of the 'add' operation (on the server): " + time + " mc.";
 				std::cout << answer << std::endl;
@@ -379,7 +826,7 @@ int main()
 				std::cout << e.what() << std::endl;
 				res.set_header("ERROR", e.what());
 			}
-			catch (std::bad_alloc) {
+			catch (std::bad_alloc&) {
 				std::cout << "Memory allocation error." << std::endl;
 				res.set_header("ERROR", "Memory allocation error.");
 			}
@@ -399,12 +846,8 @@ int main()
 		
 			std::cout << "Command 'delete' received." << std::endl;
 			Timer t;
-			std::string number("");
-
-			// получение из запроса номера телефона добавляемого абонента
-			if (req.has_param("NUMBER")) {
-				number = req.get_param_value("NUMBER");
-			}
+			// номер телефона удаляемого абонента указывает на параметр запроса без копирования
+			boost::string_view number = param_view(req, "NUMBER");
 
 			std::string answer, time;
 			t.reset();
@@ -423,7 +866,7 @@ int main()
 
 				std::string str;
 				if (success)
-					str = "Record with number " + number + " deleted successfully.";
+					str = "Record with number " + number.to_string() + " deleted successfully.";
 				else
 					str = "The record was not in the database.";
 
@@ -438,7 +881,7 @@ int main()
 				std::cout << e.what() << std::endl;
 				res.set_header("ERROR", e.what());
 			}
-			catch (std::bad_alloc) {
+			catch (std::bad_alloc&) {
 				std::cout << "Memory allocation error." << std::endl;
 				res.set_header("ERROR", "Memory allocation error.");
 			}
@@ -457,12 +900,8 @@ int main()
 		svr.Post("/find", [&db, &current_count_threads, &MaxThreads](const httplib::Request& req, httplib::Response& res) {
 			std::cout << "Command 'find' received." << std::endl;
 			Timer t;
-			std::string number;
-
-			// получение из запроса клиента числа потоков
-			if (req.has_param("NUMBER")) {
-				number = req.get_param_value("NUMBER");
-			}
+			// номер телефона искомого абонента указывает на параметр запроса без копирования
+			boost::string_view number = param_view(req, "NUMBER");
 
 			std::string answer, time;
 			bool activity = false;
@@ -483,11 +922,11 @@ int main()
 
 				if (success) {
 					answer = "Record found successfully. The subscriber " + rec.get_last_name() + " " + rec.get_first_name() + " "
-						+ rec.get_patronymic() + " has a number " + number + " and it is an " + (activity? "active":"inactive") + " subscriber."
+						+ rec.get_patronymic() + " has a number " + number.to_string() + " and it is an " + (activity? "active":"inactive") + " subscriber."
 						+ " Duration of the 'find' operation (on the server): " + time + " mc.";
 				}
 				else
-					answer = "Record not found. The subscriber with number " + number + " is not in the phone base." 
+					answer = "Record not found. The subscriber with number " + number.to_string() + " is not in the phone base." 
 					+ " Duration of the 'find' operation (on the server): " + time + " mc.";
 
 				// сохранение результатов в http-заголовках и передача клиенту
@@ -516,14 +955,333 @@ int main()
 			std::cout << "-----------------------------------------" << std::endl;
 			});
 
+		// Пакетный поиск: тело запроса - номера телефонов, разделенные переводами строк (а также пробелами, запятыми
+		// или точками с запятой). Ответ - строки в порядке номеров запроса: "<номер>, <фамилия>, <имя>, <отчество>, <1|0>"
+		// для найденных абонентов (как в файлах /save), "<номер>, not found" и "<номер>, invalid number".
+		// Поиск выполняется под одной блокировкой базы данных (data::FindBatch), строки ответа передаются
+		// фрагментами около 1 Мб в кодировке chunked.
+		svr.Post("/find_batch", [&db, &current_count_threads, &MaxThreads](const httplib::Request& req, httplib::Response& res) {
+			std::cout << "Command 'find_batch' received." << std::endl;
+			Timer t;
+
+			std::string answer, time;
+			t.reset();
+			try {
+				// при превышении максимального числа потоков, обрабатывающих запросы к базе данных,
+				// генерируется исключение и запрос не обрабатывается
+				if (current_count_threads + 1 > MaxThreads)
+					throw DataBase::MaxThreadError("Thread limit exceeded in 'find_batch' request.");
+
+				increment_number_threads inc(1, current_count_threads);
+
+				// номера указывают на тело запроса без копирования
+				std::vector<boost::string_view> numbers;
+				const char* const separators = "\r\n\t ,;";
+				std::string::size_type begin = req.body.find_first_not_of(separators);
+				while (begin != std::string::npos) {
+					std::string::size_type end = req.body.find_first_of(separators, begin);
+					if (end == std::string::npos)
+						end = req.body.size();
+					numbers.push_back(boost::string_view(req.body.data() + begin, end - begin));
+					begin = req.body.find_first_not_of(separators, end);
+				}
+				if (numbers.empty())
+					throw std::invalid_argument("The request body contains no numbers.");
+
+				// Строки ответа формируются в порядке обработки в одном буфере; для каждого номера запоминается
+				// положение его строки, и при передаче строки следуют в порядке номеров запроса.
+				struct batch_result {
+					std::string lines;
+					std::vector<std::pair<size_t, size_t> > positions;
+				};
+				std::shared_ptr<batch_result> result = std::make_shared<batch_result>();
+				result->positions.resize(numbers.size());
+				result->lines.reserve(numbers.size() * 64);
+				unsigned long found = 0, not_found = 0, invalid = 0;
+
+				db.FindBatch(numbers.data(), numbers.size(),
+					[&](size_t i, DataBase::find_status status, bool activity, const DataBase::record* rec) {
+						std::string& lines = result->lines;
+						size_t offset = lines.size();
+						lines.append(numbers[i].data(), numbers[i].size());
+						if (status == DataBase::find_status::found) {
+							lines += ", ";
+							lines += rec->get_last_name();
+							lines += ", ";
+							lines += rec->get_first_name();
+							lines += ", ";
+							lines += rec->get_patronymic();
+							lines += activity ? ", 1\n" : ", 0\n";
+							++found;
+						}
+						else if (status == DataBase::find_status::not_found) {
+							lines += ", not found\n";
+							++not_found;
+						}
+						else {
+							lines += ", invalid number\n";
+							++invalid;
+						}
+						result->positions[i] = std::make_pair(offset, lines.size() - offset);
+					});
+
+				time   = std::to_string(t.elapsed());
+				answer = "Batch lookup completed. Count of numbers: " + std::to_string(numbers.size())
+					   + ". Found: " + std::to_string(found) + ". Not found: " + std::to_string(not_found)
+					   + ". Invalid: " + std::to_string(invalid)
+					   + ". Duration of the 'find_batch' operation (on the server): " + time + " mc.";
+				std::cout << answer << std::endl;
+
+				res.set_header("ANSWER", answer);
+				res.set_header("TIME", time);
+
+				// передача строк в порядке номеров запроса
+				std::shared_ptr<size_t> next = std::make_shared<size_t>(0);
+				res.set_chunked_content_provider("text/plain", [result, next](size_t, httplib::DataSink& sink) {
+					const size_t chunk_size = 1 << 20;
+					std::string chunk;
+					chunk.reserve(chunk_size + 256);
+					size_t& i = *next;
+					for (; i < result->positions.size() && chunk.size() < chunk_size; ++i)
+						chunk.append(result->lines, result->positions[i].first, result->positions[i].second);
+					if (!sink.is_writable())
+						return false;
+					if (!chunk.empty())
+						sink.write(chunk.data(), chunk.size());
+					if (i == result->positions.size())
+						sink.done();
+					return true;
+				});
+			}
+			catch (std::runtime_error& e) {
+				std::cout << e.what() << std::endl;
+				res.set_header("ERROR", e.what());
+			}
+			catch (std::bad_alloc&) {
+				std::cout << "Memory allocation error." << std::endl;
+				res.set_header("ERROR", "Memory allocation error.");
+			}
+			catch (std::invalid_argument& e) {
+				std::cout << e.what() << std::endl;
+				res.set_header("ERROR", e.what());
+			}
+			catch (...) {
+				res.set_header("ERROR", "Unknown error.");
+				std::cout << "Unknown error." << std::endl;
+			}
+
+			std::cout << "-----------------------------------------" << std::endl;
+			});
+
+		// Запрос записей диапазона номеров: From и To - границы диапазона (включительно) в формате 89993332211
+		// или Prefix - начальные цифры номеров диапазона (Prefix=8555 - номера 85550000000-85559999999);
+		// Activity=1|0 - только активные или только неактивные абоненты. Записи передаются по возрастанию номеров
+		// в формате файлов /save фрагментами в кодировке chunked. Первый фрагмент формируется до передачи заголовков,
+		// поэтому ошибки сообщаются в заголовке ERROR; блокировка базы данных захватывается на время формирования
+		// каждого фрагмента (data::FindRange), и между фрагментами операции записи не приостанавливаются.
+		svr.Get("/range", [&db, &current_count_threads, &MaxThreads](const httplib::Request& req, httplib::Response& res) {
+			std::cout << "Command 'range' received." << std::endl;
+			Timer t;
+
+			std::string answer, time;
+			t.reset();
+			try {
+				// при превышении максимального числа потоков, обрабатывающих запросы к базе данных,
+				// генерируется исключение и запрос не обрабатывается
+				if (current_count_threads + 1 > MaxThreads)
+					throw DataBase::MaxThreadError("Thread limit exceeded in 'range' request.");
+
+				increment_number_threads inc(1, current_count_threads);
+
+				std::string from, to;
+				if (req.has_param("Prefix")) {
+					const size_t length = DataBase::DefaultHash<std::string>::number_length;
+					std::string prefix = req.get_param_value("Prefix");
+					if (prefix.empty() || prefix.size() > length)
+						throw std::invalid_argument("The prefix must contain from 1 to 11 first digits of a number '89993332211'.");
+					from = prefix + std::string(length - prefix.size(), '0');
+					to   = prefix + std::string(length - prefix.size(), '9');
+				}
+				else {
+					from = req.get_param_value("From");
+					to   = req.get_param_value("To");
+				}
+
+				std::shared_ptr<range_query> query = std::make_shared<range_query>();
+				query->from = db.Hasher.hash(from);
+				query->to   = db.Hasher.hash(to);
+				// международные номера не упорядочены по сегментам, поэтому не могут быть границами диапазона
+				if (query->from.first >= db.Hasher.number_of_domestic_buckets() || query->to.first >= db.Hasher.number_of_domestic_buckets())
+					throw std::invalid_argument("The range bounds must be set in the format '89993332211'.");
+				if (query->to < query->from)
+					throw std::invalid_argument("The beginning of the range must not exceed its end.");
+
+				if (req.has_param("Activity")) {
+					std::string activity = req.get_param_value("Activity");
+					if (activity != "1" && activity != "0")
+						throw std::invalid_argument("The activity must be set to 1 or 0.");
+					query->filter = (activity == "1") ? DataBase::activity_filter::active : DataBase::activity_filter::inactive;
+				}
+
+				std::shared_ptr<std::string> chunk = std::make_shared<std::string>();
+				query->next(db, *chunk);
+
+				time = std::to_string(t.elapsed());
+				if (query->finished)
+					answer = "Range lookup completed. Count of records: " + std::to_string(query->count)
+						   + ". Duration of the 'range' operation (on the server): " + time + " mc.";
+				else
+					answer = "Range lookup started. Records are transferred in chunks of " + std::to_string(range_query::records_per_chunk)
+						   + ". Duration of the first chunk (on the server): " + time + " mc.";
+				std::cout << answer << std::endl;
+
+				res.set_header("ANSWER", answer);
+				res.set_header("TIME", time);
+
+				res.set_chunked_content_provider("text/plain",
+					[&db, &current_count_threads, &MaxThreads, query, chunk](size_t, httplib::DataSink& sink) {
+						try {
+							if (chunk->empty() && !query->finished) {
+								if (current_count_threads + 1 > MaxThreads)
+									throw DataBase::MaxThreadError("Thread limit exceeded in 'range' request.");
+								increment_number_threads inc(1, current_count_threads);
+								query->next(db, *chunk);
+							}
+							if (!sink.is_writable())
+								return false;
+							if (!chunk->empty())
+								sink.write(chunk->data(), chunk->size());
+							chunk->clear();
+							if (query->finished) {
+								sink.done();
+								if (query->count > range_query::records_per_chunk)
+									std::cout << "Range lookup completed. Count of records: " + std::to_string(query->count)
+										+ ". Duration of the 'range' operation (on the server): " + std::to_string(query->time) + " mc." << std::endl;
+							}
+						}
+						catch (std::exception& e) {
+							// передача прерывается: клиент получает неполный ответ в кодировке chunked
+							std::cout << e.what() << std::endl;
+							std::cout << "-----------------------------------------" << std::endl;
+							return false;
+						}
+						return true;
+					});
+			}
+			catch (std::runtime_error& e) {
+				std::cout << e.what() << std::endl;
+				res.set_header("ERROR", e.what());
+			}
+			catch (std::bad_alloc&) {
+				std::cout << "Memory allocation error." << std::endl;
+				res.set_header("ERROR", "Memory allocation error.");
+			}
+			catch (std::invalid_argument& e) {
+				std::cout << e.what() << std::endl;
+				res.set_header("ERROR", e.what());
+			}
+			catch (...) {
+				res.set_header("ERROR", "Unknown error.");
+				std::cout << "Unknown error." << std::endl;
+			}
+
+			std::cout << "-----------------------------------------" << std::endl;
+			});
+
+		// Поиск абонентов по имени: LAST_NAME - фамилия (обязательно), FIRST_NAME и PATRONYMIC - имя и отчество.
+		// Поиск выполняется по индексу имен (data::FindByName); ответ - записи найденных абонентов в формате файлов /save
+		// (номера "8" + 10 цифр по возрастанию, затем международные), передаваемые фрагментами около 1 Мб в кодировке chunked.
+		svr.Post("/find_by_name", [&db, &current_count_threads, &MaxThreads](const httplib::Request& req, httplib::Response& res) {
+			std::cout << "Command 'find_by_name' received." << std::endl;
+			Timer t;
+			boost::string_view last_name  = param_view(req, "LAST_NAME");
+			boost::string_view first_name = param_view(req, "FIRST_NAME");
+			boost::string_view patronymic = param_view(req, "PATRONYMIC");
+
+			std::string answer, time;
+			t.reset();
+			try {
+				// при превышении максимального числа потоков, обрабатывающих запросы к базе данных,
+				// генерируется исключение и запрос не обрабатывается
+				if (current_count_threads + 1 > MaxThreads)
+					throw DataBase::MaxThreadError("Thread limit exceeded in 'find_by_name' request.");
+
+				increment_number_threads inc(1, current_count_threads);
+
+				std::shared_ptr<std::string> lines = std::make_shared<std::string>();
+				char number[DataBase::DefaultHash<std::string>::max_number_length];
+				unsigned long count = db.FindByName(last_name, first_name, patronymic,
+					[&](int bucket, DataBase::number_key key, bool activity, const DataBase::record& rec) {
+						lines->append(number, db.Hasher.unhash(bucket, key, number));
+						*lines += ", ";
+						*lines += rec.get_last_name();
+						*lines += ", ";
+						*lines += rec.get_first_name();
+						*lines += ", ";
+						*lines += rec.get_patronymic();
+						*lines += activity ? ", 1\n" : ", 0\n";
+					});
+
+				time = std::to_string(t.elapsed());
+				std::string name = last_name.to_string();
+				if (!first_name.empty())
+					name += " " + first_name.to_string();
+				if (!patronymic.empty())
+					name += " " + patronymic.to_string();
+				if (count)
+					answer = "Records found successfully. Count of subscribers named " + name + ": " + std::to_string(count)
+						   + ". Duration of the 'find_by_name' operation (on the server): " + time + " mc.";
+				else
+					answer = "Records not found. There are no subscribers named " + name + " in the phone base."
+						   + " Duration of the 'find_by_name' operation (on the server): " + time + " mc.";
+				std::cout << answer << std::endl;
+
+				res.set_header("ANSWER", answer);
+				res.set_header("TIME", time);
+
+				std::shared_ptr<size_t> offset = std::make_shared<size_t>(0);
+				res.set_chunked_content_provider("text/plain", [lines, offset](size_t, httplib::DataSink& sink) {
+					const size_t chunk_size = 1 << 20;
+					size_t size = std::min(chunk_size, lines->size() - *offset);
+					if (!sink.is_writable())
+						return false;
+					if (size)
+						sink.write(lines->data() + *offset, size);
+					*offset += size;
+					if (*offset == lines->size())
+						sink.done();
+					return true;
+				});
+			}
+			catch (std::runtime_error& e) {
+				std::cout << e.what() << std::endl;
+				res.set_header("ERROR", e.what());
+			}
+			catch (std::bad_alloc&) {
+				std::cout << "Memory allocation error." << std::endl;
+				res.set_header("ERROR", "Memory allocation error.");
+			}
+			catch (std::invalid_argument& e) {
+				std::cout << e.what() << std::endl;
+				res.set_header("ERROR", e.what());
+			}
+			catch (...) {
+				res.set_header("ERROR", "Unknown error.");
+				std::cout << "Unknown error." << std::endl;
+			}
+
+			std::cout << "-----------------------------------------" << std::endl;
+			});
+
 		// запрос чтения базы данных
 		svr.Get("/print", [&db, &current_count_threads, &MaxThreads, &print_time](const httplib::Request& req, httplib::Response& res) {
 
 			std::cout << "Command 'print' received." << std::endl;
 
-			res.set_content_provider(
+			// размер ответа заранее неизвестен: фрагменты передаются в кодировке chunked, по которой клиент определяет конец ответа
+			res.set_chunked_content_provider(
 				"text/plain", // Content type
-				[&](size_t offset, httplib::DataSink& sink) {
+				[&](size_t /*offset*/, httplib::DataSink& sink) {
 
 					Timer t;
 					std::string answer, time;
@@ -550,6 +1308,7 @@ int main()
 
 						// при превышении максимального числа потоков, обрабатывающих запросы к базе данных,
 						// генерируется исключение и запрос не обрабатывается
+						check_num_threads(num_threads);
 						if (current_count_threads + num_threads > MaxThreads)
 							throw DataBase::MaxThreadError("Thread limit exceeded in 'print' request.");
 
@@ -559,6 +1318,7 @@ int main()
 
 						// захват блокировки внешним кодом для вывода записей базы данных в выходной поток
 						boost::shared_lock<boost::shared_mutex> lock(db.GetLock());
+						db.MaterializeAll();
 
 						// начальные указатели устанавливаются на массив либо с активными абонентами
 						// либо с неактивными абонентами.
@@ -574,25 +1334,40 @@ int main()
 							error = true;
 
 						// определение количества сегментов базы данных, выводимых данным потоком
-						unsigned int block_size = static_cast<unsigned int>(pow(10, db.Get_first_length()) / num_threads);
+						unsigned int block_size = db.Get_number_of_buckets() / num_threads;
 
 						unsigned int block_begin = block_size * curent_thread;
-						unsigned int block_end = block_begin + block_size;
-
-						std::string number, buffer;
+						// последнему потоку достаются и оставшиеся сегменты
+						unsigned int block_end = (curent_thread == num_threads - 1) ? db.Get_number_of_buckets() : block_begin + block_size;
+
+						// Строки накапливаются в buffer и передаются клиенту фрагментами около 64 Кб;
+						// номер телефона записывается в buffer без промежуточных строк.
+						const size_t chunk_size = 1 << 16;
+						std::string buffer;
+						buffer.reserve(chunk_size + 1024);
+						char number[DataBase::DefaultHash<std::string>::max_number_length];
 						// в цикле по указателю перебираются все активные, либо все неактивные абоненты
 						while (ptr_begin != ptr_end) {
 							if (ptr_begin.GetActiv() == activity) {
 								if (ptr_begin.GetBucket() >= block_begin && ptr_begin.GetBucket() < block_end) {
-									number = db.Hasher.unhash(ptr_begin.GetBucket(), ptr_begin->first);
-									buffer = number + ", " +
-										ptr_begin->second.get_last_name() + ", " + ptr_begin->second.get_first_name() + ", " +
-										ptr_begin->second.get_patronymic() + "\n";
-									sink.write(buffer.c_str(), buffer.size());
+									buffer.append(number, db.Hasher.unhash(ptr_begin.GetBucket(), ptr_begin->first, number));
+									buffer += ", ";
+									buffer += ptr_begin->second.get_last_name();
+									buffer += ", ";
+									buffer += ptr_begin->second.get_first_name();
+									buffer += ", ";
+									buffer += ptr_begin->second.get_patronymic();
+									buffer += "\n";
+									if (buffer.size() >= chunk_size) {
+										sink.write(buffer.data(), buffer.size());
+										buffer.clear();
+									}
 								}
 							}
 							++ptr_begin;
 						}
+						if (!buffer.empty())
+							sink.write(buffer.data(), buffer.size());
 						sink.done();
 
 						print_time = std::to_string(t.elapsed());
@@ -607,7 +1382,7 @@ int main()
 						std::cout << e.what() << std::endl;
 						res.set_header("ERROR", e.what());
 					}
-					catch (std::bad_alloc) {
+					catch (std::bad_alloc&) {
 						std::cout << "Memory allocation error." << std::endl;
 						res.set_header("ERROR", "Memory allocation error.");
 					}
@@ -625,19 +1400,155 @@ int main()
 			});
 
 		// вспомогательный запрос времени чтения базы данных
-		svr.Get("/print_time", [&db, &current_count_threads, &MaxThreads, &print_time](const httplib::Request& req, httplib::Response& res) {
+		svr.Get("/print_time", [&db, &current_count_threads, &MaxThreads, &print_time](const httplib::Request& /*req*/, httplib::Response& res) {
 
 			res.set_content_provider(
 				"text/plain", // Content type
-				[&](size_t offset, httplib::DataSink& sink) {
+				[&](size_t /*offset*/, httplib::DataSink& sink) {
 						sink.write(print_time.c_str(), print_time.size());
 						sink.done();
 						return true;
 				});
 		});
 
+		// Запрос выгрузки согласованного снимка базы данных в блочном формате (snapshot.h) для резервного копирования
+		// и заполнения реплики; ответ можно сохранить в файл и загрузить запросом /load с Mode=snapshot.
+		// Если база данных не изменялась после последнего сохранения или загрузки снимка, передается его файл
+		// (заголовок SOURCE: file), иначе снимок формируется в NumOfThreads потоках во временный файл, который
+		// передается после освобождения базы данных (SOURCE: memory).
+		// Параметр Source=memory запрещает передачу файла, Compression - сжатие блоков формируемого снимка.
+		svr.Get("/export", [&db, &current_count_threads, &MaxThreads](const httplib::Request& req, httplib::Response& res) {
+
+			std::cout << "Command 'export' received." << std::endl;
+
+			unsigned int NumOfThreads = 1;
+			if (req.has_param("NumOfThreads")) {
+				NumOfThreads = std::stoi(req.get_param_value("NumOfThreads"));
+			}
+
+			std::string compression = "zlib";
+			if (req.has_param("Compression")) {
+				compression = req.get_param_value("Compression");
+			}
+
+			std::string source = "auto";
+			if (req.has_param("Source")) {
+				source = req.get_param_value("Source");
+			}
+
+			// заголовки ответа передаются до его содержимого, поэтому ошибки сообщаются до начала передачи
+			try {
+				check_num_threads(NumOfThreads);
+				if (source != "auto" && source != "memory")
+					throw std::invalid_argument("Unknown export source '" + source + "'.");
+				DataBase::block_compression block_compression = DataBase::parse_block_compression(compression);
+
+				std::string file_name = (source == "auto") ? db.RecentSnapshot() : std::string();
+				if (!file_name.empty()) {
+					uint64_t size = boost::filesystem::file_size(file_name);
+					res.set_header("SOURCE", "file");
+					res.set_content_provider(
+						size, "application/octet-stream",
+						[file_name, size](size_t offset, size_t length, httplib::DataSink& sink) {
+							Timer t;
+							try {
+								DataBase::stream_snapshot_file(file_name, offset, length, [&](const char* data, size_t n) {
+									if (!sink.is_writable())
+										throw std::runtime_error("Export: the connection is closed by the client.");
+									sink.write(data, n);
+								});
+							}
+							catch (std::exception& e) {
+								std::cout << e.what() << std::endl;
+								std::cout << "-----------------------------------------" << std::endl;
+								return false;
+							}
+							std::cout << "Snapshot file " + file_name + " exported successfully. Size: " + std::to_string(size)
+								+ " bytes. Duration of the export operation (on the server): " + std::to_string(t.elapsed()) + " mc." << std::endl;
+							std::cout << "-----------------------------------------" << std::endl;
+							return true;
+						});
+					return;
+				}
+
+				if (db.Get_number_of_records() == 0)
+					throw DataBase::SequenceError("The database is not in memory.");
+
+				if (current_count_threads + NumOfThreads > MaxThreads)
+					throw DataBase::MaxThreadError("Thread limit exceeded in 'export' request.");
+
+				// Снимок формируется во временный файл, и операции записи приостанавливаются только на время его
+				// формирования, а не передачи медленному клиенту. Файл удаляется вместе с последней копией temp -
+				// после передачи ответа или при ошибке.
+				std::shared_ptr<const std::string> temp(
+					new std::string((boost::filesystem::current_path() / boost::filesystem::unique_path(".export-%%%%-%%%%-%%%%.snap")).string()),
+					[](const std::string* name) {
+						boost::system::error_code ec;
+						boost::filesystem::remove(*name, ec);
+						delete name;
+					});
+				Timer t;
+				unsigned long count;
+				{
+					increment_number_threads inc(NumOfThreads, current_count_threads);
+					std::ofstream out(*temp, std::ios::binary);
+					if (!out)
+						throw DataBase::FileOpenError(*temp);
+					count = db.ExportSnapshot(out, NumOfThreads, block_compression);
+					out.close();
+					if (!out)
+						throw DataBase::FileWriteError(*temp);
+				}
+				uint64_t size = boost::filesystem::file_size(*temp);
+				std::cout << "DataBase snapshot built for export. Count of records: " + std::to_string(count) + ". Size: " + std::to_string(size)
+					+ " bytes. Duration (on the server): " + std::to_string(t.elapsed()) + " mc." << std::endl;
+
+				res.set_header("SOURCE", "memory");
+				res.set_content_provider(
+					size, "application/octet-stream",
+					[temp, size, count](size_t offset, size_t length, httplib::DataSink& sink) {
+						Timer t;
+						try {
+							DataBase::stream_snapshot_file(*temp, offset, length, [&](const char* data, size_t n) {
+								if (!sink.is_writable())
+									throw std::runtime_error("Export: the connection is closed by the client.");
+								sink.write(data, n);
+							});
+						}
+						catch (std::exception& e) {
+							// передача прерывается: снимок без завершающей записи не будет загружен
+							std::cout << e.what() << std::endl;
+							std::cout << "-----------------------------------------" << std::endl;
+							return false;
+						}
+						std::cout << "DataBase exported successfully. Count of exported records: " + std::to_string(count)
+							+ ". Duration of the transfer (on the server): " + std::to_string(t.elapsed()) + " mc." << std::endl;
+						std::cout << "-----------------------------------------" << std::endl;
+						return true;
+					});
+				return;
+			}
+			catch (std::runtime_error& e) {
+				std::cout << e.what() << std::endl;
+				res.set_header("ERROR", e.what());
+			}
+			catch (std::bad_alloc&) {
+				std::cout << "Memory allocation error." << std::endl;
+				res.set_header("ERROR", "Memory allocation error.");
+			}
+			catch (std::invalid_argument& e) {
+				std::cout << e.what() << std::endl;
+				res.set_header("ERROR", e.what());
+			}
+			catch (...) {
+				res.set_header("ERROR", "Unknown error.");
+				std::cout << "Unknown error." << std::endl;
+			}
+			std::cout << "-----------------------------------------" << std::endl;
+		});
+
 		// запрос остановки сервера
-		svr.Get("/stop", [&](const httplib::Request& req, httplib::Response& res) {
+		svr.Get("/stop", [&](const httplib::Request& /*req*/, httplib::Response& res) {
 			std::cout << "Command 'stop' receive." << std::endl;
 			Timer t;
 			std::string answer, time;
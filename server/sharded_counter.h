@@ -0,0 +1,82 @@
+#ifndef SHARDED_COUNTER_H
+#define SHARDED_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+namespace DataBase {
+
+	// номер ячейки счетчиков для текущего потока: потоки получают номера по очереди при первом обращении
+	// (переменная потока инициализируется константой, поэтому обращение к ней не требует проверки инициализации)
+	inline size_t current_counter_shard()
+	{
+		static std::atomic<size_t> next_shard(0);
+		thread_local size_t shard = (size_t)-1;
+		if (shard == (size_t)-1)
+			shard = next_shard++;
+		return shard;
+	}
+
+	// Счетчик, распределенный по ячейкам: каждый поток изменяет свою ячейку, значение счетчика - сумма ячеек.
+	// Ячейки отстоят друг от друга на 128 байт, поэтому при любом выравнивании объекта находятся в разных
+	// строках кэша (и в разных парах строк, которые процессор загружает вместе), и одновременные изменения
+	// из разных потоков не передают строку кэша между ядрами. Изменения атомарны, значение читается без блокировки;
+	// ячейки изменяются для беззнаковых T по модулю 2^n, поэтому уменьшение в одной ячейке и увеличение
+	// в другой дают верное значение. Если потоков больше, чем ячеек, потоки делят ячейки.
+	template<typename T>
+	class sharded_counter {
+	public:
+		static const size_t number_of_shards = 32;
+
+		sharded_counter(T value = 0) { store(value); }
+
+		sharded_counter(const sharded_counter&) = delete;
+		sharded_counter& operator=(const sharded_counter&) = delete;
+
+		sharded_counter& operator=(T value)
+		{
+			store(value);
+			return *this;
+		}
+
+		void operator+=(T delta) { cell().fetch_add(delta, std::memory_order_relaxed); }
+		void operator-=(T delta) { cell().fetch_sub(delta, std::memory_order_relaxed); }
+		void operator++() { cell().fetch_add(1, std::memory_order_relaxed); }
+		void operator--() { cell().fetch_sub(1, std::memory_order_relaxed); }
+
+		// Сумма ячеек. Ячейки читаются не одновременно, поэтому при одновременных изменениях результат -
+		// значение счетчика в один из моментов чтения лишь для неубывающего счетчика; после завершения
+		// изменяющих потоков (join, блокировка) значение точное. Чтение может застать уменьшение в одной ячейке
+		// без соответствующего ему увеличения в другой, поэтому ячейки суммируются как числа со знаком,
+		// и отрицательная сумма заменяется нулем (а не переходит через 0 в значения, близкие к 2^n).
+		T load() const
+		{
+			typedef typename std::make_signed<T>::type signed_type;
+			signed_type sum = 0;
+			for (size_t i = 0; i < number_of_shards; ++i)
+				sum += (signed_type)shards[i].value.load(std::memory_order_relaxed);
+			return (sum < 0) ? 0 : (T)sum;
+		}
+
+		// установка значения; одновременные изменения из других потоков не допускаются
+		void store(T value)
+		{
+			shards[0].value.store(value, std::memory_order_relaxed);
+			for (size_t i = 1; i < number_of_shards; ++i)
+				shards[i].value.store(0, std::memory_order_relaxed);
+		}
+
+	private:
+		struct shard {
+			std::atomic<T> value;
+			char padding[128 - sizeof(std::atomic<T>)];
+		};
+		shard shards[number_of_shards];
+
+		std::atomic<T>& cell() { return shards[current_counter_shard() % number_of_shards].value; }
+	};
+
+} // namespace DataBase
+
+#endif // SHARDED_COUNTER_H
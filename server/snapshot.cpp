@@ -0,0 +1,421 @@
+#include <stdexcept>
+#include <cstring>
+#include <future>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <algorithm>
+
+#include <zlib.h>
+
+#include "snapshot.h"
+#include "crc32c.h"
+#include "error.h"
+#include "file_utils.h"
+
+namespace DataBase {
+
+	namespace {
+		const char     snapshot_magic[4] = { 'P', 'H', 'D', 'B' };
+		const char     footer_magic[4]   = { 'P', 'H', 'D', 'E' };
+
+		void append_string(std::string& buffer, boost::string_view s)
+		{
+			if (s.size() > 0xFFFF)
+				throw std::invalid_argument("Snapshot: the name is too long: " + s.substr(0, 32).to_string() + "...");
+			uint16_t size = (uint16_t)s.size();
+			buffer.append(reinterpret_cast<const char*>(&size), sizeof(size));
+			buffer.append(s.data(), s.size());
+		}
+
+		bool read_string(const char*& ptr, const char* end, std::string& s)
+		{
+			uint16_t size;
+			if (end - ptr < (ptrdiff_t)sizeof(size))
+				return false;
+			std::memcpy(&size, ptr, sizeof(size));
+			ptr += sizeof(size);
+			if (end - ptr < size)
+				return false;
+			s.assign(ptr, size);
+			ptr += size;
+			return true;
+		}
+	}
+
+	block_compression parse_block_compression(const std::string& compression)
+	{
+		if (compression == "none") return block_compression::none;
+		if (compression == "zlib") return block_compression::zlib;
+		throw std::invalid_argument("Snapshot: unknown compression '" + compression + "'. Use none or zlib.");
+	}
+
+	void append_row(std::string& buffer, uint32_t bucket, uint64_t suffix, bool activity,
+		boost::string_view last_name, boost::string_view first_name, boost::string_view patronymic)
+	{
+		buffer.append(reinterpret_cast<const char*>(&bucket), sizeof(bucket));
+		// вторая часть номера - LEB128: по 7 бит, младшие первыми, старший бит байта - признак продолжения
+		while (suffix >= 0x80) {
+			buffer.push_back((char)((suffix & 0x7F) | 0x80));
+			suffix >>= 7;
+		}
+		buffer.push_back((char)suffix);
+		buffer.push_back(activity ? 1 : 0);
+		append_string(buffer, last_name);
+		append_string(buffer, first_name);
+		append_string(buffer, patronymic);
+	}
+
+	bool row_reader::next(uint32_t& bucket, uint64_t& suffix, bool& activity,
+		std::string& last_name, std::string& first_name, std::string& patronymic)
+	{
+		if (ptr == end)
+			return false;
+		if (end - ptr < (ptrdiff_t)(sizeof(uint32_t) + 2))
+			throw std::runtime_error("Snapshot: truncated record.");
+
+		std::memcpy(&bucket, ptr, sizeof(bucket)); ptr += sizeof(bucket);
+		if (version < 3) {
+			uint32_t value;
+			if (end - ptr < (ptrdiff_t)(sizeof(value) + 1))
+				throw std::runtime_error("Snapshot: truncated record.");
+			std::memcpy(&value, ptr, sizeof(value)); ptr += sizeof(value);
+			suffix = value;
+		}
+		else {
+			suffix = 0;
+			for (unsigned int shift = 0; ; shift += 7) {
+				if (ptr == end || shift > 63)
+					throw std::runtime_error("Snapshot: truncated record.");
+				unsigned char byte = (unsigned char)*ptr++;
+				suffix |= (uint64_t)(byte & 0x7F) << shift;
+				if (!(byte & 0x80))
+					break;
+			}
+		}
+		if (ptr == end)
+			throw std::runtime_error("Snapshot: truncated record.");
+		activity = (*ptr++ != 0);
+		if (!read_string(ptr, end, last_name) || !read_string(ptr, end, first_name) || !read_string(ptr, end, patronymic))
+			throw std::runtime_error("Snapshot: truncated record.");
+		return true;
+	}
+
+	std::string encode_block(const std::string& raw, block_compression compression, block_header& header, int level)
+	{
+		header.raw_size = (uint32_t)raw.size();
+
+		if (compression == block_compression::zlib && !raw.empty()) {
+			uLongf size = compressBound((uLong)raw.size());
+			std::string stored(size, '\0');
+			if (compress2(reinterpret_cast<Bytef*>(&stored[0]), &size,
+				reinterpret_cast<const Bytef*>(raw.data()), (uLong)raw.size(), level) != Z_OK)
+				throw std::runtime_error("Snapshot: zlib compression error.");
+
+			// несжимаемые данные хранятся как есть
+			if (size < raw.size()) {
+				stored.resize(size);
+				header.stored_size = (uint32_t)size;
+				header.compression = (uint32_t)block_compression::zlib;
+				header.checksum = block_checksum(header, stored.data());
+				return stored;
+			}
+		}
+
+		header.stored_size = (uint32_t)raw.size();
+		header.compression = (uint32_t)block_compression::none;
+		header.checksum = block_checksum(header, raw.data());
+		return raw;
+	}
+
+	uint32_t block_checksum(const block_header& header, const char* stored)
+	{
+		uint32_t crc = crc32c(&header, offsetof(block_header, checksum));
+		return crc32c(stored, header.stored_size, crc);
+	}
+
+	void verify_and_decode_block(const std::string& file_name, size_t number, uint64_t offset,
+		const block_header& header, const char* stored, std::string& raw)
+	{
+		std::string place = "блок " + std::to_string(number) + " (смещение " + std::to_string(offset) + ")";
+		if (block_checksum(header, stored) != header.checksum)
+			throw FileCorruptError(file_name, place + ", контрольная сумма не совпадает");
+		try {
+			decode_block(header, stored, raw);
+		}
+		catch (std::runtime_error& e) {
+			throw FileCorruptError(file_name, place + ", " + e.what());
+		}
+	}
+
+	void decode_block(const block_header& header, const char* stored, std::string& raw)
+	{
+		if (header.compression == (uint32_t)block_compression::none) {
+			if (header.stored_size != header.raw_size)
+				throw std::runtime_error("Snapshot: invalid block size.");
+			raw.assign(stored, header.stored_size);
+			return;
+		}
+		if (header.compression != (uint32_t)block_compression::zlib)
+			throw std::runtime_error("Snapshot: unknown block compression.");
+
+		raw.resize(header.raw_size);
+		uLongf size = header.raw_size;
+		if (uncompress(reinterpret_cast<Bytef*>(&raw[0]), &size,
+			reinterpret_cast<const Bytef*>(stored), header.stored_size) != Z_OK || size != header.raw_size)
+			throw std::runtime_error("Snapshot: zlib decompression error.");
+	}
+
+	snapshot_writer::snapshot_writer(const std::string& name, int number_of_first_digits, int number_of_second_digits) :
+		file_name(name), temporary_name(name + ".tmp"), file(temporary_name, std::ios::binary | std::ios::trunc),
+		out(&file), written(0), blocks(0), records(0)
+	{
+		if (!file)
+			throw FileOpenError(temporary_name);
+		write_header(number_of_first_digits, number_of_second_digits);
+	}
+
+	snapshot_writer::snapshot_writer(std::ostream& stream, const std::string& name, int number_of_first_digits, int number_of_second_digits) :
+		file_name(name), out(&stream), written(0), blocks(0), records(0)
+	{
+		write_header(number_of_first_digits, number_of_second_digits);
+	}
+
+	snapshot_writer::~snapshot_writer()
+	{
+		if (file.is_open()) {
+			file.close();
+			std::remove(temporary_name.c_str());
+		}
+	}
+
+	void snapshot_writer::write_header(int number_of_first_digits, int number_of_second_digits)
+	{
+		snapshot_header header;
+		std::memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+		header.version = snapshot_version;
+		header.number_of_first_digits  = number_of_first_digits;
+		header.number_of_second_digits = number_of_second_digits;
+		out->write(reinterpret_cast<const char*>(&header), sizeof(header));
+		written += sizeof(header);
+	}
+
+	void snapshot_writer::write_block(const block_header& header, const std::string& stored)
+	{
+		out->write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out->write(stored.data(), stored.size());
+		if (!*out)
+			throw FileWriteError(file_name);
+		written += sizeof(header) + stored.size();
+		++blocks;
+		records += header.records;
+	}
+
+	void snapshot_writer::close()
+	{
+		snapshot_footer footer;
+		std::memcpy(footer.magic, footer_magic, sizeof(footer.magic));
+		footer.number_of_blocks = blocks;
+		footer.records = records;
+		footer.checksum = crc32c(&footer, offsetof(snapshot_footer, checksum));
+		footer.reserved = 0;
+		out->write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+		written += sizeof(footer);
+
+		if (temporary_name.empty()) {
+			out->flush();
+			if (!*out)
+				throw FileWriteError(file_name);
+			return;
+		}
+
+		file.close();
+		if (!file) {
+			std::remove(temporary_name.c_str());
+			throw FileWriteError(temporary_name);
+		}
+		sync_file(temporary_name);
+		rename_file(temporary_name, file_name);
+	}
+
+	uint64_t stream_snapshot_file(const std::string& file_name, uint64_t offset, uint64_t length,
+		const std::function<void(const char*, size_t)>& write, size_t chunk)
+	{
+		boost::interprocess::file_mapping file;
+		boost::interprocess::mapped_region region;
+		try {
+			file = boost::interprocess::file_mapping(file_name.c_str(), boost::interprocess::read_only);
+			region = boost::interprocess::mapped_region(file, boost::interprocess::read_only);
+		}
+		catch (boost::interprocess::interprocess_exception&) {
+			throw FileOpenError(file_name);
+		}
+		region.advise(boost::interprocess::mapped_region::advice_sequential);
+
+		const char* data = static_cast<const char*>(region.get_address());
+		uint64_t size = region.get_size();
+		uint64_t end = (offset < size) ? offset + std::min(length, size - offset) : offset;
+		for (uint64_t position = offset; position < end; position += chunk)
+			write(data + position, (size_t)std::min<uint64_t>(chunk, end - position));
+		return end - offset;
+	}
+
+	snapshot_header read_snapshot_header(const std::string& file_name)
+	{
+		std::ifstream in(file_name, std::ios::binary);
+		if (!in)
+			throw FileOpenError(file_name);
+
+		snapshot_header header;
+		if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+			|| std::memcmp(header.magic, snapshot_magic, sizeof(header.magic)) != 0 || header.version < snapshot_min_version || header.version > snapshot_version)
+			throw FileReadError(file_name);
+		return header;
+	}
+
+	bool is_snapshot_file(const std::string& file_name)
+	{
+		std::ifstream in(file_name, std::ios::binary);
+		char magic[sizeof(snapshot_magic)];
+		return in.read(magic, sizeof(magic)) && std::memcmp(magic, snapshot_magic, sizeof(magic)) == 0;
+	}
+
+	snapshot_header read_snapshot_index(const std::string& file_name, std::vector<block_location>& blocks)
+	{
+		snapshot_header header = read_snapshot_header(file_name);
+
+		std::ifstream in(file_name, std::ios::binary | std::ios::ate);
+		if (!in)
+			throw FileOpenError(file_name);
+		uint64_t file_size = (uint64_t)in.tellg();
+
+		// завершающая запись отсутствует, если сохранение снимка было прервано
+		snapshot_footer footer;
+		if (file_size < sizeof(header) + sizeof(footer)
+			|| !in.seekg(file_size - sizeof(footer)) || !in.read(reinterpret_cast<char*>(&footer), sizeof(footer))
+			|| std::memcmp(footer.magic, footer_magic, sizeof(footer.magic)) != 0
+			|| footer.checksum != crc32c(&footer, offsetof(snapshot_footer, checksum)))
+			throw FileCorruptError(file_name, "отсутствует завершающая запись, файл обрезан");
+		uint64_t data_end = file_size - sizeof(footer);
+
+		in.seekg(sizeof(header));
+		blocks.clear();
+		uint64_t offset = sizeof(header);
+		uint64_t records = 0;
+		while (offset < data_end) {
+			std::string place = "блок " + std::to_string(blocks.size()) + " (смещение " + std::to_string(offset) + ")";
+			block_location block;
+			if (offset + sizeof(block.header) > data_end || !in.read(reinterpret_cast<char*>(&block.header), sizeof(block.header)))
+				throw FileCorruptError(file_name, place + ", заголовок блока обрезан");
+			block.offset = offset + sizeof(block.header);
+
+			// данные блока должны полностью находиться в файле
+			if (block.offset + block.header.stored_size > data_end || block.header.first_bucket > block.header.end_bucket)
+				throw FileCorruptError(file_name, place + ", недопустимый заголовок блока");
+
+			blocks.push_back(block);
+			records += block.header.records;
+			offset = block.offset + block.header.stored_size;
+			in.seekg(offset);
+		}
+
+		if (blocks.size() != footer.number_of_blocks || records != footer.records)
+			throw FileCorruptError(file_name, "количество блоков (" + std::to_string(blocks.size()) + ") или записей ("
+				+ std::to_string(records) + ") не совпадает с завершающей записью ("
+				+ std::to_string(footer.number_of_blocks) + ", " + std::to_string(footer.records) + ")");
+		return header;
+	}
+
+	void write_blocks_parallel(snapshot_writer& writer, size_t number_of_blocks, unsigned int num_threads,
+		const std::function<void(size_t, block_header&, std::string&)>& build)
+	{
+		// заголовок блока записывается формирующим потоком до того, как блок становится готовым к записи
+		std::vector<block_header> headers(number_of_blocks);
+		write_chunks_parallel(number_of_blocks, std::max(num_threads, 1u),
+			[&](size_t i, std::string& stored) { build(i, headers[i], stored); },
+			[&](size_t i, const std::string& stored) { writer.write_block(headers[i], stored); });
+	}
+
+	snapshot_header read_blocks_parallel(const std::string& file_name, unsigned int num_threads,
+		const std::function<void(const block_header&, const std::string&)>& consume)
+	{
+		std::vector<block_location> blocks;
+		snapshot_header header = read_snapshot_index(file_name, blocks);
+
+		std::atomic<size_t> next(0);
+		auto worker = [&]() {
+			try {
+				std::ifstream in(file_name, std::ios::binary);
+				if (!in)
+					throw FileOpenError(file_name);
+
+				std::string stored, raw;
+				size_t i;
+				while ((i = next++) < blocks.size()) {
+					const block_location& block = blocks[i];
+					stored.resize(block.header.stored_size);
+					in.seekg(block.offset);
+					if (!in.read(&stored[0], stored.size()))
+						throw FileReadError(file_name);
+
+					// проверка контрольной суммы выполняется тем же потоком, что и распаковка блока
+					verify_and_decode_block(file_name, i, block.offset, block.header, stored.data(), raw);
+					consume(block.header, raw);
+				}
+			}
+			catch (...) {
+				next = blocks.size(); // остальные потоки прекращают чтение
+				throw;
+			}
+		};
+
+		std::vector<std::future<void> > futures(num_threads - 1);
+		for (unsigned int i = 0; i < num_threads - 1; ++i)
+			futures[i] = std::async(std::launch::async, worker);
+
+		std::exception_ptr error;
+		try {
+			worker();
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+		for (auto& f : futures) {
+			try {
+				f.get();
+			}
+			catch (...) {
+				if (!error)
+					error = std::current_exception();
+			}
+		}
+		if (error)
+			std::rethrow_exception(error);
+
+		return header;
+	}
+
+	snapshot_mapping::snapshot_mapping(const std::string& name) : file_name(name)
+	{
+		file_header = read_snapshot_index(file_name, index);
+		try {
+			file = boost::interprocess::file_mapping(file_name.c_str(), boost::interprocess::read_only);
+			region = boost::interprocess::mapped_region(file, boost::interprocess::read_only);
+		}
+		catch (boost::interprocess::interprocess_exception&) {
+			throw FileOpenError(file_name);
+		}
+		// файл мог измениться после чтения положения блоков
+		for (auto& block : index)
+			if (block.offset + block.header.stored_size > region.get_size())
+				throw FileReadError(file_name);
+	}
+
+	void snapshot_mapping::read_block(size_t i, std::string& raw) const
+	{
+		const block_location& block = index[i];
+		verify_and_decode_block(file_name, i, block.offset, block.header,
+			static_cast<const char*>(region.get_address()) + block.offset, raw);
+	}
+
+} // namespace DataBase
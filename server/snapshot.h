@@ -0,0 +1,203 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <functional>
+#include <cstdint>
+
+#include <boost/utility/string_view.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace DataBase {
+
+	// Блочный двоичный формат снимка базы данных.
+	// Файл состоит из заголовка и последовательности независимых блоков. Каждый блок содержит
+	// записи непрерывного диапазона сегментов базы данных [first_bucket, end_bucket) и может быть
+	// сжат zlib независимо от остальных, поэтому блоки сжимаются и распаковываются параллельно.
+	// Все числа хранятся в порядке байтов little-endian.
+	//
+	//   snapshot_header
+	//   block_header, данные блока (stored_size байт)
+	//   ...
+	//   snapshot_footer
+	//
+	// Заголовок и данные каждого блока защищены контрольной суммой CRC32C, которая проверяется
+	// потоком, распаковывающим блок, поэтому проверка выполняется параллельно с загрузкой.
+	// Завершающая запись snapshot_footer содержит количество блоков и записей: ее отсутствие
+	// означает, что файл обрезан (например, при переполнении диска во время сохранения).
+	//
+	// Запись в несжатых данных блока:
+	//   uint32 индекс сегмента, вторая часть номера (LEB128, до 64 бит), uint8 признак активности,
+	//   uint16 длина + байты фамилии, uint16 длина + байты имени, uint16 длина + байты отчества.
+	// В версии 2 вторая часть номера хранилась как uint32; такие снимки по-прежнему загружаются.
+
+	// версия записываемого формата и самая ранняя читаемая версия
+	const uint32_t snapshot_version     = 3;
+	const uint32_t snapshot_min_version = 2;
+
+	// способ сжатия данных блока
+	enum class block_compression : uint32_t { none = 0, zlib = 1 };
+
+	// преобразование строкового представления ("none", "zlib") в block_compression
+	block_compression parse_block_compression(const std::string& compression);
+
+	struct snapshot_header {
+		char     magic[4];              // "PHDB"
+		uint32_t version;               // версия формата
+		uint32_t number_of_first_digits;
+		uint32_t number_of_second_digits;
+	};
+
+	struct block_header {
+		uint32_t first_bucket;          // первый сегмент блока
+		uint32_t end_bucket;            // сегмент, следующий за последним сегментом блока
+		uint32_t records;               // количество записей в блоке
+		uint32_t raw_size;              // размер несжатых данных
+		uint32_t stored_size;           // размер данных в файле
+		uint32_t compression;           // block_compression
+		uint32_t checksum;              // CRC32C предыдущих полей заголовка и данных блока
+	};
+
+	struct snapshot_footer {
+		char     magic[4];              // "PHDE"
+		uint32_t number_of_blocks;
+		uint64_t records;               // общее количество записей
+		uint32_t checksum;              // CRC32C предыдущих полей
+		uint32_t reserved;
+	};
+
+	// положение блока в файле снимка
+	struct block_location {
+		block_header header;
+		uint64_t offset;                // смещение данных блока от начала файла
+	};
+
+	// добавление записи в несжатые данные блока
+	void append_row(std::string& buffer, uint32_t bucket, uint64_t suffix, bool activity,
+		boost::string_view last_name, boost::string_view first_name, boost::string_view patronymic);
+
+	// последовательное чтение записей из несжатых данных блока
+	class row_reader {
+	public:
+		// version - версия формата снимка, из которого прочитан блок
+		row_reader(const char* data, size_t size, uint32_t version = snapshot_version) : ptr(data), end(data + size), version(version) {}
+
+		// чтение очередной записи; возвращает false по окончании данных
+		bool next(uint32_t& bucket, uint64_t& suffix, bool& activity,
+			std::string& last_name, std::string& first_name, std::string& patronymic);
+
+	private:
+		const char* ptr;
+		const char* end;
+		uint32_t version;
+	};
+
+	// Сжатие несжатых данных блока raw (level - уровень сжатия zlib, по умолчанию самый быстрый). Заполняет поля raw_size, stored_size,
+	// compression и checksum заголовка (поля first_bucket, end_bucket и records должны быть уже заполнены)
+	// и возвращает данные блока в том виде, в котором они записываются в файл.
+	std::string encode_block(const std::string& raw, block_compression compression, block_header& header, int level = 1);
+
+	// восстановление несжатых данных блока из данных stored, прочитанных из файла
+	void decode_block(const block_header& header, const char* stored, std::string& raw);
+
+	// контрольная сумма заголовка и данных блока
+	uint32_t block_checksum(const block_header& header, const char* stored);
+
+	// Проверка контрольной суммы и распаковка блока с номером number, расположенного по смещению offset
+	// файла file_name. Повреждение сообщается исключением FileCorruptError с указанием номера блока.
+	void verify_and_decode_block(const std::string& file_name, size_t number, uint64_t offset,
+		const block_header& header, const char* stored, std::string& raw);
+
+	// последовательная запись файла снимка
+	class snapshot_writer {
+	public:
+		// Снимок записывается во временный файл file_name.tmp, который заменяет file_name при закрытии,
+		// поэтому файл file_name, отображенный в память другими операциями, не изменяется во время записи.
+		snapshot_writer(const std::string& file_name, int number_of_first_digits, int number_of_second_digits);
+
+		// запись снимка в поток out (например, в ответ на http-запрос); name используется в сообщениях об ошибках
+		snapshot_writer(std::ostream& out, const std::string& name, int number_of_first_digits, int number_of_second_digits);
+
+		// удаление временного файла, если снимок не был закрыт
+		~snapshot_writer();
+
+		snapshot_writer(const snapshot_writer&) = delete;
+		snapshot_writer& operator=(const snapshot_writer&) = delete;
+
+		void write_block(const block_header& header, const std::string& stored);
+
+		// запись завершающей записи snapshot_footer, закрытие файла с проверкой ошибок записи, сброс на диск и переименование
+		void close();
+
+		uint64_t bytes_written() const { return written; }
+
+	private:
+		std::string file_name;
+		std::string temporary_name;     // пустая строка при записи во внешний поток
+		std::ofstream file;
+		std::ostream* out;              // file или внешний поток
+		uint64_t written;
+		uint32_t blocks;
+		uint64_t records;
+
+		void write_header(int number_of_first_digits, int number_of_second_digits);
+	};
+
+	// Передача length байт файла снимка, начиная со смещения offset, в write фрагментами по chunk байт.
+	// Файл отображается в память, и фрагменты передаются непосредственно из страничного кэша без чтения
+	// в промежуточный буфер. Возвращает количество переданных байт.
+	uint64_t stream_snapshot_file(const std::string& file_name, uint64_t offset, uint64_t length,
+		const std::function<void(const char*, size_t)>& write, size_t chunk = 1 << 20);
+
+	// чтение и проверка заголовка снимка
+	snapshot_header read_snapshot_header(const std::string& file_name);
+
+	// проверка, является ли файл снимком в блочном формате
+	bool is_snapshot_file(const std::string& file_name);
+
+	// Чтение заголовка снимка и положения всех его блоков. Проверяется наличие завершающей записи
+	// и совпадение количества блоков и записей с указанными в ней; нарушения сообщаются исключением FileCorruptError.
+	snapshot_header read_snapshot_index(const std::string& file_name, std::vector<block_location>& blocks);
+
+	// Параллельное формирование блоков и их запись в порядке номеров.
+	// build(i, header, stored) вызывается в num_threads потоках для каждого блока i из [0, number_of_blocks);
+	// вызывающий поток записывает готовые блоки в файл. Количество сформированных, но еще не записанных
+	// блоков ограничено, поэтому объем занимаемой памяти не зависит от размера снимка.
+	void write_blocks_parallel(snapshot_writer& writer, size_t number_of_blocks, unsigned int num_threads,
+		const std::function<void(size_t, block_header&, std::string&)>& build);
+
+	// Параллельное чтение снимка: каждый из num_threads потоков читает, проверяет и распаковывает свои блоки
+	// и передает несжатые данные в consume(header, raw). Возвращает заголовок снимка.
+	snapshot_header read_blocks_parallel(const std::string& file_name, unsigned int num_threads,
+		const std::function<void(const block_header&, const std::string&)>& consume);
+
+	// Файл снимка, отображенный в память, для загрузки блоков по требованию.
+	// При создании читается только заголовок и положение блоков; данные блока
+	// считываются операционной системой с диска при первом обращении к нему.
+	class snapshot_mapping {
+	public:
+		explicit snapshot_mapping(const std::string& file_name);
+
+		snapshot_mapping(const snapshot_mapping&) = delete;
+		snapshot_mapping& operator=(const snapshot_mapping&) = delete;
+
+		const snapshot_header& header() const { return file_header; }
+		const std::vector<block_location>& blocks() const { return index; }
+
+		// распаковка блока с номером i в raw; безопасна при одновременном вызове из нескольких потоков
+		void read_block(size_t i, std::string& raw) const;
+
+	private:
+		std::string file_name;
+		snapshot_header file_header;
+		std::vector<block_location> index;
+		boost::interprocess::file_mapping file;
+		boost::interprocess::mapped_region region;
+	};
+
+} // namespace DataBase
+
+#endif // SNAPSHOT_H
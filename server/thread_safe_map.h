@@ -3,6 +3,8 @@
 
 #include <map>
 #include <mutex>
+#include <string>
+#include <ostream>
 #include <boost/thread.hpp>
 
 namespace DataBase {
@@ -43,6 +45,9 @@ namespace DataBase {
 		const_iterator begin() const;
 		const_iterator end() const;
 
+		// итератор первого элемента с ключом не меньше key (поиск по дереву; синхронизация, как для begin())
+		const_iterator lower_bound(key_type const& key) const;
+
 		// Класс итератора должен иметь доступ к защищенным 
 		// членам класса thread_safe_map. 
 		friend class map_iterator<Key, T>;
@@ -62,21 +67,42 @@ namespace DataBase {
 
 		// Метод добавления элементов в ассоциативный массив. В случае наличия элемента в 
 		// массиве происходт обновление элемента, при этом размер старого элемента возвращается
-		// в переменной old_size.
-		bool add_or_update(key_type const& key, mapped_type const& value, unsigned int& old_size);
+		// в переменной old_size, а при old_value != nullptr старый элемент перемещается в *old_value.
+		bool add_or_update(key_type const& key, mapped_type const& value, unsigned int& old_size, mapped_type* old_value = nullptr);
 
 		// Метод добавления элементов в массив без проверки на наличие в массиве, соответсвующего ключу.
 		void add(key_type const& key, mapped_type const& value);
 
-		// Вывод элемента массива в поток
-		unsigned long print(std::ostream& stream, int first_number, bool activ, int number_of_first_digits, int number_of_second_digits);
+		// Добавление элементов, созданных вызовом make(*it) для it из [first, last) в виде пары (ключ, значение),
+		// с возрастающими ключами (как правило, большими всех ключей массива): блокировка захватывается один раз,
+		// а элементы вставляются в конец дерева без поиска. Возвращает суммарный размер добавленных элементов.
+		template<typename Iterator, typename Make>
+		unsigned long long append_sorted(Iterator first, Iterator last, Make make);
+
+		// Поиск элементов с возрастающими ключами key_of(*it) для it из [first, last) за одну блокировку на чтение:
+		// для каждого элемента вызывается visit(*it, value), где value - указатель на найденное значение или nullptr.
+		// Указатель действителен только внутри visit.
+		template<typename Iterator, typename KeyOf, typename Visit>
+		void find_sorted(Iterator first, Iterator last, KeyOf key_of, Visit visit) const;
+
+		// Вывод элементов массива в поток строками "<ключ>, <фамилия>, <имя>, <отчество>, <activ>"; текст ключа
+		// дописывает в строку вывода format_key(key, line) (например, номер телефона по ключу сегмента).
+		template<typename FormatKey>
+		unsigned long print(std::ostream& stream, bool activ, FormatKey format_key);
 
 		// Метод удаляет элемент с ключом key, если таковой существует. В случае успешного удаления элемента возвращает true.
-		bool erase(key_type const& key, unsigned int& old_size);
+		// При old_value != nullptr удаляемый элемент перемещается в *old_value.
+		bool erase(key_type const& key, unsigned int& old_size, mapped_type* old_value = nullptr);
 
 		// Метод удаления всех элементов массива. 
 		void clear();
 
+		// Проверка наличия элемента с ключом key.
+		bool contains(key_type const& key) const { boost::shared_lock<boost::shared_mutex> lock(mutex); return data.count(key) != 0; }
+
+		// Количество элементов массива.
+		size_type size() const { boost::shared_lock<boost::shared_mutex> lock(mutex); return data.size(); }
+
 		// Проверка на наличие элементов в массиве.
 		bool empty() const { boost::shared_lock<boost::shared_mutex> lock(mutex); return data.empty(); }
 
@@ -88,11 +114,10 @@ namespace DataBase {
 		// доступ к массиву под защитой мьютекса
 		mutable boost::shared_mutex mutex;
 
-		// вспомогательная функция для поиска элемента
+		// вспомогательная функция для поиска элемента (по дереву std::map, без просмотра всех элементов)
 		typename std::map<key_type, mapped_type>::iterator find(Key const& key)
 		{
-			return std::find_if(data.begin(), data.end(),
-				[&](value_type const& item) {return item.first == key; });
+			return data.find(key);
 		}
 
 	};
@@ -21,7 +21,7 @@ namespace DataBase {
 	// Добавление элемента в ассоциативный массив под защитой std::lock_guard<>.
 	// в случае его наличия в массиве - обновление значения.
 	template<typename Key, typename T>
-	bool thread_safe_map<Key, T>::add_or_update(key_type const& key, mapped_type const& value, unsigned int& old_size)
+	bool thread_safe_map<Key, T>::add_or_update(key_type const& key, mapped_type const& value, unsigned int& old_size, mapped_type* old_value)
 	{
 		std::lock_guard<boost::shared_mutex> lock(mutex);
 
@@ -38,6 +38,8 @@ namespace DataBase {
 		{
 			// вычисление размера старого элемента
 			old_size = (unsigned int)(found_entry->second).last_name_size() + (unsigned int)(found_entry->second).first_name_size() + (unsigned int)(found_entry->second).patronymic_size();
+			if (old_value)
+				*old_value = std::move(found_entry->second);
 			
 			// замена старого элемента на новый
 			found_entry->second = value; // предположительно при наличии действительного итератора так будет быстрее, чем через operator[]
@@ -53,21 +55,52 @@ namespace DataBase {
 		data[key] = value;		   // помещение новых данных в ассоциативный массив
 	}
 
+	// добавление элементов с возрастающими ключами под защитой std::lock_guard<>
+	template<typename Key, typename T>
+	template<typename Iterator, typename Make>
+	unsigned long long thread_safe_map<Key, T>::append_sorted(Iterator first, Iterator last, Make make)
+	{
+		std::lock_guard<boost::shared_mutex> lock(mutex);
+		unsigned long long size = 0;
+		for (; first != last; ++first) {
+			auto it = data.emplace_hint(data.end(), make(*first));
+			size += it->second.size();
+		}
+		return size;
+	}
+
+	// Поиск группы элементов под одной блокировкой boost::shared_lock<>. Ключи возрастают, поэтому пути поиска
+	// соседних ключей в дереве совпадают в начале и находятся в кэше после поиска предыдущего ключа.
+	template<typename Key, typename T>
+	template<typename Iterator, typename KeyOf, typename Visit>
+	void thread_safe_map<Key, T>::find_sorted(Iterator first, Iterator last, KeyOf key_of, Visit visit) const
+	{
+		if (first == last)
+			return;
+		boost::shared_lock<boost::shared_mutex> lock(mutex);
+		for (; first != last; ++first) {
+			auto found_entry = data.find(key_of(*first));
+			visit(*first, (found_entry == data.end()) ? (const T*)nullptr : &found_entry->second);
+		}
+	}
+
 	// удаление элемента из ассоциативного массива под защитой std::lock_guard<>
 	template<typename Key, typename T>
-	bool thread_safe_map<Key, T>::erase(key_type const& key, unsigned int& old_size)
+	bool thread_safe_map<Key, T>::erase(key_type const& key, unsigned int& old_size, mapped_type* old_value)
 	{
 		// монопольный захват мьютекса на запись
 		std::lock_guard<boost::shared_mutex> lock(mutex);
 
 		// получение итератора на удаляемый элемент
-		typename std::map<key_type, mapped_type>::const_iterator found_entry = find(key);
+		typename std::map<key_type, mapped_type>::iterator found_entry = find(key);
 
 		// если существует элемент, соответствующий заданному ключу, то осуществляется операция его удаления из массива
 		if (found_entry != data.end())
 		{
 			// возврат размера удаляемого элемента
 			old_size = (unsigned int)(found_entry->second).last_name_size() + (unsigned int)(found_entry->second).first_name_size() + (unsigned int)(found_entry->second).patronymic_size();
+			if (old_value)
+				*old_value = std::move(found_entry->second);
 			
 			// непосредсвенное удаление элемента
 			data.erase(found_entry);
@@ -89,34 +122,34 @@ namespace DataBase {
 
 	// вывод элементов ассоциативного массива в поток
 	template<typename Key, typename T>
-	unsigned long thread_safe_map<Key, T>::print(std::ostream& stream, int first_number, bool activ, int number_of_first_digits, int number_of_second_digits) {
+	template<typename FormatKey>
+	unsigned long thread_safe_map<Key, T>::print(std::ostream& stream, bool activ, FormatKey format_key) {
 		
 		boost::shared_lock<boost::shared_mutex> lock(mutex);
 		
 		unsigned long count = 0; // счетчик выведенных в поток элементов
 		auto it = data.begin();  // установка итератора на начало массива
 		
-		std::string s_first, s_second; // вспомогательные буферы для строкового представления первой и второй половины телефонного номера
-		
+		// Строка формируется в буфере line, который используется повторно, поэтому после первых записей
+		// вывод не выделяет память.
+		std::string line;
+		const char* activity = (activ) ? ", 1\n" : ", 0\n";
+
 		// цикл по всем элементам в массиве
 		while (it != data.end()) {
-			
-			// первая и вторая половина телефонного номера	
-			s_first  = std::to_string(first_number);
-			s_second = std::to_string(it->first);
-		
-			// дополнение строк нулями до требуемого размера телефонного номера
-			std::string add_first(number_of_first_digits - s_first.size(), '0');
-			std::string add_second(number_of_second_digits - s_second.size(), '0');
+			line.clear();
+			format_key(it->first, line);
+			line += ", ";
+			line += it->second.get_last_name();
+			line += ", ";
+			line += it->second.get_first_name();
+			line += ", ";
+			line += it->second.get_patronymic();
+			line += activity;
 
 			// результаты тестирования вывода в поток https://stackoverflow.com/questions/1924530/mixing-cout-and-printf-for-faster-output
-			stream << "8" + add_first + s_first
-				+ add_second + s_second + ", "		   // запись в поток номера телефона
-				+ it->second.get_last_name() + ", "    // запись в поток фамилии
-				+ it->second.get_first_name() + ", "   // запись в поток имени
-				+ it->second.get_patronymic() + ", "   // запись в поток отчества
-				+ ((activ) ? "1" : "0") + "\n";		   // запись в поток признака активности
-			
+			stream.write(line.data(), line.size());
+
 			++it;
 			++count;
 		}
@@ -147,6 +180,14 @@ namespace DataBase {
 		return (map_iterator<Key, T>(data.cend(), this));
 	}
 
+	// метод, устанавливающий итератор на первый элемент с ключом не меньше key
+	template <typename Key, typename T>
+	typename thread_safe_map<Key, T>::const_iterator
+		thread_safe_map<Key, T>::lower_bound(key_type const& key) const
+	{
+		return (map_iterator<Key, T>(data.lower_bound(key), this));
+	}
+
 	// ----------------------------------------------------------------- //
 	// Итераторные методы: создание, сравнение, разименование итераторов //
 
@@ -0,0 +1,298 @@
+#include <stdexcept>
+#include <fstream>
+#include <vector>
+#include <chrono>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "wal.h"
+#include "file_utils.h"
+#include "error.h"
+
+namespace DataBase {
+
+	namespace {
+
+#ifdef _WIN32
+		int sync_fd(int fd) { return _commit(fd); }
+		int truncate_file(int fd) { return _chsize(fd, 0); }
+		int write_file(int fd, const char* data, size_t size) { return _write(fd, data, (unsigned int)size); }
+		int close_file(int fd) { return _close(fd); }
+		int open_file(const std::string& name) { return _open(name.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE); }
+#else
+		int sync_fd(int fd) { return ::fdatasync(fd); }
+		int truncate_file(int fd) { return ::ftruncate(fd, 0); }
+		ssize_t write_file(int fd, const char* data, size_t size) { return ::write(fd, data, size); }
+		int close_file(int fd) { return ::close(fd); }
+		int open_file(const std::string& name) { return ::open(name.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644); }
+#endif
+
+		// запись всего буфера в файл с повторением при частичной записи
+		void write_all(int fd, const std::string& data, const std::string& file_name)
+		{
+			size_t done = 0;
+			while (done < data.size()) {
+				auto n = write_file(fd, data.data() + done, data.size() - done);
+				if (n <= 0)
+					throw FileWriteError(file_name);
+				done += n;
+			}
+		}
+
+		// добавление поля к строке журнала с экранированием разделителей
+		void append_field(std::string& line, boost::string_view field)
+		{
+			for (char c : field) {
+				switch (c) {
+				case ',':  line += "\\,";  break;
+				case '\\': line += "\\\\"; break;
+				case '\n': line += "\\n";  break;
+				case '\r': line += "\\r";  break;
+				default:   line += c;
+				}
+			}
+		}
+
+		// разбиение строки журнала на поля, разделенные запятыми, с восстановлением экранированных символов
+		// (обратная косая черта перед другим символом или в конце строки сохраняется как есть)
+		std::vector<std::string> split_line(const std::string& line)
+		{
+			std::vector<std::string> fields(1);
+			for (std::string::size_type i = 0; i < line.size(); ++i) {
+				char c = line[i];
+				if (c == ',') {
+					fields.emplace_back();
+					continue;
+				}
+				if (c == '\\' && i + 1 < line.size()) {
+					switch (line[i + 1]) {
+					case ',':
+					case '\\': c = line[++i]; break;
+					case 'n':  c = '\n'; ++i;   break;
+					case 'r':  c = '\r'; ++i;   break;
+					}
+				}
+				fields.back() += c;
+			}
+			return fields;
+		}
+	}
+
+	durability_mode parse_durability_mode(const std::string& mode)
+	{
+		if (mode == "none")  return durability_mode::none;
+		if (mode == "async") return durability_mode::async;
+		if (mode == "sync")  return durability_mode::sync;
+		throw std::invalid_argument("WAL: unknown durability mode '" + mode + "'. Use none, async or sync.");
+	}
+
+	write_ahead_log::write_ahead_log(const std::string& name, durability_mode mode, int interval) :
+		file_name(name), durability(mode), flush_interval(interval), fd(-1),
+		next_lsn(1), written_lsn(0), durable_lsn(0), in_flight(false), stop(false), failed(false),
+		count_of_entries(0), count_of_syncs(0), count_of_bytes(0), count_of_skipped(0)
+	{
+		fd = open_file(file_name);
+		if (fd < 0)
+			throw FileOpenError(file_name);
+
+		log_thread = std::thread(&write_ahead_log::run, this);
+	}
+
+	write_ahead_log::~write_ahead_log()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		cond_work.notify_one();
+		if (log_thread.joinable())
+			log_thread.join();
+		close_file(fd);
+	}
+
+	unsigned long long write_ahead_log::append_add(boost::string_view number, bool activity,
+		const std::string& last_name, const std::string& first_name, const std::string& patronymic)
+	{
+		std::string line;
+		line.reserve(number.size() + last_name.size() + first_name.size() + patronymic.size() + 8);
+		line += "A,";
+		append_field(line, number);
+		line += ",";
+		append_field(line, last_name);
+		line += ",";
+		append_field(line, first_name);
+		line += ",";
+		append_field(line, patronymic);
+		line += activity ? ",1\n" : ",0\n";
+		return append(line);
+	}
+
+	unsigned long long write_ahead_log::append_delete(boost::string_view number)
+	{
+		std::string line("D,");
+		append_field(line, number);
+		line += "\n";
+		return append(line);
+	}
+
+	unsigned long long write_ahead_log::append(const std::string& line)
+	{
+		unsigned long long lsn;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (failed)
+				throw FileWriteError(file_name);
+			buffer += line;
+			lsn = next_lsn++;
+		}
+		// в режиме async поток журнала просыпается по таймеру и не будится на каждую запись
+		if (durability != durability_mode::async)
+			cond_work.notify_one();
+		++count_of_entries;
+		return lsn;
+	}
+
+	void write_ahead_log::wait(unsigned long long lsn)
+	{
+		if (durability != durability_mode::sync)
+			return;
+
+		std::unique_lock<std::mutex> lock(mutex);
+		cond_done.wait(lock, [&] { return durable_lsn >= lsn || failed; });
+		if (durable_lsn < lsn)
+			throw FileWriteError(file_name);
+	}
+
+	void write_ahead_log::run()
+	{
+		std::string batch;
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			if (durability == durability_mode::async)
+				cond_work.wait_for(lock, std::chrono::milliseconds(flush_interval), [&] { return stop; });
+			else
+				cond_work.wait(lock, [&] { return stop || !buffer.empty(); });
+
+			if (buffer.empty()) {
+				if (stop)
+					break;
+				continue;
+			}
+
+			// забираем накопленную группу записей целиком; новые записи попадают в следующую группу
+			batch.swap(buffer);
+			unsigned long long batch_lsn = next_lsn - 1;
+			in_flight = true;
+			lock.unlock();
+
+			bool success = true;
+			try {
+				write_all(fd, batch, file_name);
+				if (durability != durability_mode::none) {
+					if (sync_fd(fd) != 0)
+						throw FileWriteError(file_name);
+					++count_of_syncs;
+				}
+				count_of_bytes += batch.size();
+			}
+			catch (FileError&) {
+				success = false;
+			}
+			batch.clear();
+
+			lock.lock();
+			in_flight = false;
+			if (success)
+				written_lsn = durable_lsn = batch_lsn;
+			else
+				failed = true; // журнал далее не принимает записи, ожидающие запросы получают исключение
+			cond_done.notify_all();
+			if (failed)
+				break;
+		}
+	}
+
+	void write_ahead_log::checkpoint(const std::string& snapshot, unsigned int num_threads)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		// все записи, отраженные в снимке, должны быть переданы в файл до его усечения
+		cond_work.notify_one();
+		cond_done.wait(lock, [&] { return (buffer.empty() && !in_flight) || stop || failed; });
+		if (failed)
+			throw FileWriteError(file_name);
+
+		replace_file(file_name + ".checkpoint", snapshot.empty() ? std::string() : snapshot + "," + std::to_string(num_threads) + "\n");
+
+		if (truncate_file(fd) != 0)
+			throw FileWriteError(file_name);
+		sync_fd(fd);
+	}
+
+	bool write_ahead_log::read_checkpoint(std::string& snapshot, unsigned int& num_threads) const
+	{
+		std::ifstream in(file_name + ".checkpoint");
+		std::string line;
+		if (!in || !std::getline(in, line) || line.empty())
+			return false;
+
+		std::string::size_type pos = line.find_last_of(',');
+		if (pos == std::string::npos)
+			throw FileReadError(file_name + ".checkpoint");
+
+		snapshot = line.substr(0, pos);
+		num_threads = std::stoi(line.substr(pos + 1));
+		return true;
+	}
+
+	unsigned long write_ahead_log::replay(const std::function<void(const wal_entry&)>& apply)
+	{
+		std::ifstream in(file_name, std::ios::binary);
+		if (!in)
+			return 0;
+
+		unsigned long count = 0;
+		std::string line;
+		wal_entry entry;
+		while (std::getline(in, line)) {
+			// последняя строка без символа перевода строки записана не полностью - отбрасываем ее
+			if (in.eof())
+				break;
+
+			std::vector<std::string> fields = split_line(line);
+			if (fields[0] == "A" && fields.size() == 6) {
+				entry.op = 'A';
+				entry.number     = fields[1];
+				entry.last_name  = fields[2];
+				entry.first_name = fields[3];
+				entry.patronymic = fields[4];
+				entry.activity   = (fields[5] == "1");
+			}
+			else if (fields[0] == "D" && fields.size() == 2) {
+				entry.op = 'D';
+				entry.number = fields[1];
+			}
+			else {
+				++count_of_skipped;
+				continue;
+			}
+
+			try {
+				apply(entry);
+			}
+			catch (std::invalid_argument&) {
+				++count_of_skipped;
+				continue;
+			}
+			++count;
+		}
+		return count;
+	}
+
+} // namespace DataBase
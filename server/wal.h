@@ -0,0 +1,118 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+#include <boost/utility/string_view.hpp>
+
+namespace DataBase {
+
+	// Режим долговечности журнала упреждающей записи:
+	// - none  - журнал пишется в буфер операционной системы, fsync не вызывается;
+	// - async - журнал сбрасывается на диск группами, запрос не ожидает завершения fsync;
+	// - sync  - запрос ожидает завершения fsync группы, в которую попала его запись (group commit).
+	enum class durability_mode { none, async, sync };
+
+	// преобразование строкового представления режима ("none", "async", "sync") в durability_mode
+	durability_mode parse_durability_mode(const std::string& mode);
+
+	// запись журнала: операция добавления ('A') или удаления ('D') абонента
+	struct wal_entry {
+		char op;
+		std::string number;
+		std::string last_name;
+		std::string first_name;
+		std::string patronymic;
+		bool activity;
+	};
+
+	// Журнал упреждающей записи (write-ahead log) для операций /add и /delete.
+	// Записи добавляются в буфер в памяти, выделенный поток журнала забирает накопленный
+	// буфер целиком, записывает его в файл и вызывает fdatasync один раз на всю группу.
+	// Пока поток журнала выполняет fsync, новые записи накапливаются в следующей группе,
+	// поэтому стоимость fsync делится между всеми одновременными запросами.
+	// Формат журнала текстовый, одна операция в строке:
+	//   A,89993332211,Фамилия,Имя,Отчество,1
+	//   D,89993332211
+	// Запятые, переводы строк и обратная косая черта в полях экранируются обратной косой чертой
+	// ("\,", "\n", "\r", "\\"). Незавершенная последняя строка (сбой во время записи) при восстановлении
+	// отбрасывается, поврежденные строки пропускаются.
+	class write_ahead_log
+	{
+	public:
+		// file_name - имя файла журнала; flush_interval - максимальная задержка сброса группы в режиме async (мс).
+		write_ahead_log(const std::string& file_name, durability_mode mode = durability_mode::sync, int flush_interval = 10);
+		~write_ahead_log();
+
+		write_ahead_log(const write_ahead_log&) = delete;
+		write_ahead_log& operator=(const write_ahead_log&) = delete;
+
+		// добавление записи в журнал; возвращается порядковый номер записи (LSN)
+		unsigned long long append_add(boost::string_view number, bool activity,
+			const std::string& last_name, const std::string& first_name, const std::string& patronymic);
+		unsigned long long append_delete(boost::string_view number);
+
+		// ожидание долговечности записи с номером lsn в соответствии с режимом журнала
+		void wait(unsigned long long lsn);
+
+		// Контрольная точка: все записи журнала отражены в снимке snapshot (сохраненном в num_threads файлах).
+		// Информация о снимке атомарно записывается в файл <file_name>.checkpoint, журнал усекается.
+		// Пустое имя снимка означает пустую базу данных.
+		void checkpoint(const std::string& snapshot, unsigned int num_threads);
+
+		// чтение последней контрольной точки; возвращает false при ее отсутствии
+		bool read_checkpoint(std::string& snapshot, unsigned int& num_threads) const;
+
+		// Последовательное чтение всех завершенных записей журнала; возвращает количество примененных записей.
+		// Строки неизвестного формата и записи, для которых apply генерирует std::invalid_argument (недопустимый
+		// номер), пропускаются и учитываются в Get_number_of_skipped, поэтому одна поврежденная запись
+		// не препятствует восстановлению остальных.
+		unsigned long replay(const std::function<void(const wal_entry&)>& apply);
+
+		durability_mode mode() const { return durability; }
+
+		// статистика журнала
+		unsigned long long Get_number_of_entries() const { return count_of_entries.load(); }
+		unsigned long long Get_number_of_syncs()   const { return count_of_syncs.load(); }
+		unsigned long long Get_number_of_bytes()   const { return count_of_bytes.load(); }
+		unsigned long long Get_number_of_skipped() const { return count_of_skipped.load(); }
+
+	private:
+		std::string file_name;
+		durability_mode durability;
+		int flush_interval;
+		int fd;
+
+		std::mutex mutex;
+		std::condition_variable cond_work;  // появились записи для сброса (или остановка журнала)
+		std::condition_variable cond_done;  // группа записей записана на диск
+
+		std::string buffer;                 // текущая накапливаемая группа записей
+		unsigned long long next_lsn;        // номер следующей добавляемой записи
+		unsigned long long written_lsn;     // номер последней записи, переданной в файл
+		unsigned long long durable_lsn;     // номер последней записи, сброшенной на диск
+		bool in_flight;                     // поток журнала записывает группу
+		bool stop;
+		bool failed;                        // ошибка записи журнала на диск
+
+		std::atomic<unsigned long long> count_of_entries;
+		std::atomic<unsigned long long> count_of_syncs;
+		std::atomic<unsigned long long> count_of_bytes;
+		std::atomic<unsigned long long> count_of_skipped;  // записи, пропущенные при восстановлении
+
+		std::thread log_thread;
+
+		unsigned long long append(const std::string& line);
+
+		// функция потока журнала
+		void run();
+	};
+
+} // namespace DataBase
+
+#endif // WAL_H